@@ -0,0 +1,63 @@
+// ============================================================================
+// Headless benchmark entry point: renders offscreen and prints JSON.
+// ============================================================================
+import std;
+import pngp.vis.rays.headless;
+
+namespace {
+    void print_usage() {
+        std::println(stderr, "usage: rays-bench [dataset.rays] [--frames N] [--warmup N] [--size WxH] [--out report.json] [--no-wait] [--replay input.rin] [--frames-in-flight N]");
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    pngp::vis::rays::headless::BenchInfo info{};
+    std::filesystem::path out_path{};
+
+    const std::vector<std::string_view> args(argv + 1, argv + argc);
+    bool valid = true;
+    for (std::size_t i = 0; i < args.size() && valid; ++i) {
+        const auto value = [&]() -> std::string_view { return i + 1 < args.size() ? args[++i] : std::string_view{}; };
+        const auto parse = [](const std::string_view s, std::uint32_t& v) { return !s.empty() && std::from_chars(s.data(), s.data() + s.size(), v).ec == std::errc{}; };
+
+        if (args[i] == "--frames") {
+            valid = parse(value(), info.frames);
+        } else if (args[i] == "--frames-in-flight") {
+            valid = parse(value(), info.frames_in_flight) && info.frames_in_flight > 0;
+        } else if (args[i] == "--warmup") {
+            valid = parse(value(), info.warmup_frames);
+        } else if (args[i] == "--size") {
+            const auto s = value();
+            const auto x = s.find('x');
+            valid        = x != std::string_view::npos && parse(s.substr(0, x), info.extent.width) && parse(s.substr(x + 1), info.extent.height);
+        } else if (args[i] == "--out") {
+            out_path = value();
+            valid    = !out_path.empty();
+        } else if (args[i] == "--replay") {
+            info.replay = value();
+            valid       = !info.replay.empty();
+        } else if (args[i] == "--no-wait") {
+            info.wait_for_dataset = false;
+        } else if (!args[i].starts_with("--") && info.dataset.empty()) {
+            info.dataset = args[i];
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || info.frames == 0 || info.extent.width == 0 || info.extent.height == 0) {
+        print_usage();
+        return 2;
+    }
+
+    pngp::vis::rays::headless::HeadlessBench bench{info};
+    const auto json = pngp::vis::rays::headless::to_json(bench.run());
+
+    if (out_path.empty()) {
+        std::print("{}", json);
+    } else {
+        std::ofstream out(out_path, std::ios::trunc);
+        out << json;
+        if (!out) return 1;
+    }
+    return 0;
+}
@@ -8,24 +8,45 @@ module pngp.vis.rays;
 // RaysInspector implementation.
 // ============================================================================
 import std;
-import vk.pipeline;
-import vk.memory;
-import vk.geometry;
 import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.scene;
+import pngp.vis.rays.picking;
+import pngp.vis.rays.filter;
+import pngp.vis.rays.profiler;
+import pngp.vis.rays.capture;
+import pngp.vis.rays.replay;
+import pngp.vis.rays.residency;
+import pngp.vis.rays.pacing;
+import pngp.vis.rays.present;
 
 // ============================================================================
-// Translation-unit helpers (input callbacks, grid helpers, pipeline setup).
+// Translation-unit helpers (input callbacks, picking widgets).
 // ============================================================================
 namespace {
-    using pngp::vis::rays::GridSettings;
     using pngp::vis::rays::InputState;
 
+    // Frames rendered after an input or view change so ImGui hover/active
+    // state and the camera settle before the loop idles again.
+    constexpr std::uint32_t settle_frames = 3;
+
+    // =========================================================================
+    // An input event wakes the on-demand loop and starts the latency clock of
+    // the frame that will show it (GLFW delivery time, not OS queue time).
+    // =========================================================================
+    void note_input(InputState& s) {
+        s.activity = true;
+        if (!s.first_event) s.first_event = pngp::vis::rays::pacing::Clock::now();
+    }
+
     // =========================================================================
     // GLFW input callbacks: collect raw input into InputState.
     // =========================================================================
     void glfw_key_cb(GLFWwindow* w, int key, int, int action, int) {
         auto* s = static_cast<InputState*>(glfwGetWindowUserPointer(w));
         if (!s) return;
+        note_input(*s);
         if (key < 0 || key >= static_cast<int>(s->keys.size())) return;
         if (action == GLFW_PRESS) s->keys[static_cast<size_t>(key)] = true;
         if (action == GLFW_RELEASE) s->keys[static_cast<size_t>(key)] = false;
@@ -34,11 +55,13 @@ namespace {
     void glfw_mouse_button_cb(GLFWwindow* w, int button, int action, int) {
         auto* s = static_cast<InputState*>(glfwGetWindowUserPointer(w));
         if (!s) return;
+        note_input(*s);
 
         const bool down = action == GLFW_PRESS;
         if (button == GLFW_MOUSE_BUTTON_LEFT) s->lmb = down;
         if (button == GLFW_MOUSE_BUTTON_MIDDLE) s->mmb = down;
         if (button == GLFW_MOUSE_BUTTON_RIGHT) s->rmb = down;
+        if (button == GLFW_MOUSE_BUTTON_LEFT && down) s->lmb_clicked = true;
 
         if (!down) s->have_last = false;
     }
@@ -46,6 +69,7 @@ namespace {
     void glfw_cursor_pos_cb(GLFWwindow* w, double x, double y) {
         auto* s = static_cast<InputState*>(glfwGetWindowUserPointer(w));
         if (!s) return;
+        note_input(*s);
 
         if (!s->have_last) {
             s->last_x    = x;
@@ -64,118 +88,94 @@ namespace {
     void glfw_scroll_cb(GLFWwindow* w, double, double yoff) {
         auto* s = static_cast<InputState*>(glfwGetWindowUserPointer(w));
         if (!s) return;
+        note_input(*s);
         s->scroll += static_cast<float>(yoff);
     }
 
-    // =========================================================================
-    // Push constants consumed by ground_grid.slang.
-    // =========================================================================
-    struct GridPush {
-        vk::math::mat4 mvp{};
-        vk::math::vec4 grid{};
-        vk::math::vec4 toggles{};
-    };
-
-    // =========================================================================
-    // Single quad for the grid surface; shader draws the lines procedurally.
-    // =========================================================================
-    vk::memory::MeshCPU<vk::geometry::VertexP3C4> build_ground_plane(const float extent) {
-        vk::memory::MeshCPU<vk::geometry::VertexP3C4> mesh{};
-        const float clamped_extent = std::max(0.1f, extent);
-        constexpr vk::math::vec4 color{1.0f, 1.0f, 1.0f, 1.0f};
-
-        mesh.vertices = {
-            {{-clamped_extent, 0.0f, -clamped_extent, 0.0f}, color},
-            {{clamped_extent, 0.0f, -clamped_extent, 0.0f}, color},
-            {{clamped_extent, 0.0f, clamped_extent, 0.0f}, color},
-            {{-clamped_extent, 0.0f, clamped_extent, 0.0f}, color},
-        };
-
-        mesh.indices = {0, 1, 2, 0, 2, 3};
-        return mesh;
-    }
-
-    // =========================================================================
-    // Helper that returns an empty GPU mesh if CPU data is empty.
-    // =========================================================================
-    vk::memory::MeshGPU upload_mesh_safe(const vk::context::VulkanContext& vkctx, const vk::memory::MeshCPU<vk::geometry::VertexP3C4>& mesh) {
-        if (mesh.vertices.empty() || mesh.indices.empty()) return {};
-        return vk::memory::upload_mesh(vkctx.physical_device, vkctx.device, vkctx.command_pool, vkctx.graphics_queue, mesh);
+    // Exposed or damaged window contents need a fresh frame.
+    void glfw_refresh_cb(GLFWwindow* w) {
+        auto* s = static_cast<InputState*>(glfwGetWindowUserPointer(w));
+        if (!s) return;
+        s->activity = true;
     }
 
     // =========================================================================
-    // Load SPIR-V from first available path (build dir or repo root).
+    // Attribute readout for a picked ray.
     // =========================================================================
-    std::vector<std::byte> read_shader_bytes(std::span<const char* const> paths) {
-        std::exception_ptr last_error;
-        for (const char* path : paths) {
-            try {
-                return vk::pipeline::read_file_bytes(path);
-            } catch (...) {
-                last_error = std::current_exception();
-            }
+    void ray_details(const char* label, const pngp::vis::rays::dataset::RayFile& file, const std::optional<pngp::vis::rays::picking::PickHit>& hit) {
+        if (!hit) {
+            ImGui::Text("%s: none", label);
+            return;
         }
-        if (last_error) std::rethrow_exception(last_error);
-        throw std::runtime_error("ground_grid.spv not found");
+        const auto a = pngp::vis::rays::picking::ray_attributes(file, hit->chunk, hit->ray);
+
+        ImGui::PushID(label);
+        ImGui::Text("%s: ray %llu (chunk %u)", label, static_cast<unsigned long long>(a.id), a.chunk);
+        ImGui::Indent();
+        if (a.pixel) ImGui::Text("Source pixel: (%u, %u)", (*a.pixel)[0], (*a.pixel)[1]);
+        else ImGui::TextUnformatted("Source pixel: n/a");
+        if (a.camera_id) ImGui::Text("Camera: %u", *a.camera_id);
+        else ImGui::TextUnformatted("Camera: n/a");
+        ImGui::Text("t: [%.4f, %.4f]", a.t_min, a.t_max);
+        const ImVec4 color{static_cast<float>(a.color & 0xffu) / 255.0f, static_cast<float>((a.color >> 8) & 0xffu) / 255.0f, static_cast<float>((a.color >> 16) & 0xffu) / 255.0f, static_cast<float>((a.color >> 24) & 0xffu) / 255.0f};
+        ImGui::ColorButton("##color", color, ImGuiColorEditFlags_AlphaPreview);
+        ImGui::SameLine();
+        ImGui::Text("Color: 0x%08X", a.color);
+        ImGui::Text("Origin: (%.3f, %.3f, %.3f)", a.origin[0], a.origin[1], a.origin[2]);
+        ImGui::Text("Direction: (%.3f, %.3f, %.3f)", a.direction[0], a.direction[1], a.direction[2]);
+        ImGui::Unindent();
+        ImGui::PopID();
     }
 
     // =========================================================================
-    // Convert UI settings to shader-friendly constants.
+    // Overlay the picked segment on top of the viewport.
     // =========================================================================
-    GridPush make_grid_push(const GridSettings& grid, const vk::math::mat4& mvp) {
-        const float step   = std::max(0.001f, grid.grid_step);
-        const float extent = std::max(0.1f, grid.grid_extent);
-        const float major  = static_cast<float>(std::max(1, grid.major_every));
-
-        GridPush push{};
-        push.mvp     = mvp;
-        push.grid    = {step, step * major, extent, std::max(0.001f, grid.axis_length)};
-        push.toggles = {std::max(0.001f, grid.origin_scale), grid.show_grid ? 1.0f : 0.0f, grid.show_axes ? 1.0f : 0.0f, grid.show_origin ? 1.0f : 0.0f};
-        return push;
-    }
-
-    // =========================================================================
-    // Minimal pipeline for a transparent grid surface with depth testing.
-    // =========================================================================
-    vk::pipeline::GraphicsPipeline create_grid_pipeline(const vk::context::VulkanContext& vkctx, const vk::swapchain::Swapchain& sc) {
-        const auto vin = vk::pipeline::make_vertex_input<vk::geometry::VertexP3C4>();
-        constexpr std::array paths{"shaders/ground_grid.spv", "../shaders/ground_grid.spv"};
-        const auto spv = read_shader_bytes(paths);
-        auto shader    = vk::pipeline::load_shader_module(vkctx.device, spv);
-
-        vk::pipeline::GraphicsPipelineDesc desc{};
-        desc.color_format         = sc.format;
-        desc.depth_format         = sc.depth_format;
-        desc.use_depth            = true;
-        desc.cull                 = vk::CullModeFlagBits::eNone;
-        desc.front_face           = vk::FrontFace::eCounterClockwise;
-        desc.polygon_mode         = vk::PolygonMode::eFill;
-        desc.topology             = vk::PrimitiveTopology::eTriangleList;
-        desc.enable_blend         = true;
-        desc.push_constant_bytes  = sizeof(GridPush);
-        desc.push_constant_stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
-        return vk::pipeline::create_graphics_pipeline(vkctx.device, vin, desc, shader, "vertMain", "fragMain");
+    void highlight_ray(const pngp::vis::rays::dataset::RayFile& file, const pngp::vis::rays::picking::PickHit& hit, const vk::math::mat4& view_proj, const std::array<float, 2> viewport, const ImU32 color) {
+        const auto a  = pngp::vis::rays::picking::ray_attributes(file, hit.chunk, hit.ray);
+        const auto at = [&](const float t) { return std::array{a.origin[0] + a.direction[0] * t, a.origin[1] + a.direction[1] * t, a.origin[2] + a.direction[2] * t}; };
+        const auto p0 = pngp::vis::rays::picking::project_point(view_proj, viewport, at(a.t_min));
+        const auto p1 = pngp::vis::rays::picking::project_point(view_proj, viewport, at(a.t_max));
+        if (!p0 || !p1) return;
+
+        // Multi-viewport ImGui works in desktop coordinates.
+        const ImVec2 base = ImGui::GetMainViewport()->Pos;
+        ImGui::GetForegroundDrawList()->AddLine({base.x + (*p0)[0], base.y + (*p0)[1]}, {base.x + (*p1)[0], base.y + (*p1)[1]}, color, 3.0f);
     }
 } // namespace
 
-// ============================================================================
-// App entry point.
-// ============================================================================
-int main() {
-    pngp::vis::rays::RaysInspector app{{}};
-    app.run();
-    return 0;
-}
-
 // ============================================================================
 // Main loop: poll input, update camera, draw, and present.
 // ============================================================================
 void pngp::vis::rays::RaysInspector::run() {
-    std::uint32_t frame_index = 0;
-    using clock               = std::chrono::steady_clock;
-    auto t_prev               = clock::now();
+    using clock = std::chrono::steady_clock;
+    auto t_prev = clock::now();
     while (!glfwWindowShouldClose(surface.window.get())) {
-        glfwPollEvents();
+        // ====================================================================
+        // On-demand mode: idle in the event queue until something needs a
+        // frame; the frame clock restarts so dt never spans the idle gap.
+        // ====================================================================
+        if (!wait_for_redraw()) {
+            t_prev = clock::now();
+            continue;
+        }
+        frame_profiler->begin_frame();
+
+        // ====================================================================
+        // Frame pacing: wait on the pacer for this slot's previous frame
+        // before polling, so input is sampled as late as the frames in
+        // flight allow.
+        // ====================================================================
+        const std::uint32_t frame_index = pacer->slot(frame_number);
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "pace"};
+            pacer->wait_for_slot(frame_number);
+            swapchain->collect(pacer->completed());
+        }
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "poll events"};
+            glfwPollEvents();
+        }
+        const auto input_time = std::exchange(input.first_event, std::nullopt);
 
         // ====================================================================
         // Frame timing with a small clamp to keep camera stable.
@@ -183,45 +183,68 @@ void pngp::vis::rays::RaysInspector::run() {
         auto t_now = clock::now();
         float dt   = std::chrono::duration<float>(t_now - t_prev).count();
         t_prev     = t_now;
+        // Unclamped interval, logged per frame by replays.
+        const double frame_ms = 1000.0 * dt;
         if (!(dt > 0.0f)) dt = 1.0f / 60.0f;
         dt = std::min(dt, 0.05f);
 
         // ====================================================================
-        // Acquire swapchain image and sync to start a new frame.
+        // Acquire a swapchain image; an out-of-date swapchain (resize,
+        // minimize) is rebuilt and the frame retried. Input stays pending
+        // for the retry.
         // ====================================================================
-        const auto [ok, need_recreate, image_index] = vk::frame::begin_frame(ctx, swapchain, frames, frame_index);
-        if (!ok || need_recreate) {
-            // =================================================================
-            // Swapchain is invalid (resize/minimize). Recreate dependent resources.
-            // =================================================================
-            vk::swapchain::recreate_swapchain(ctx, surface, swapchain);
-            vk::frame::on_swapchain_recreated(ctx, swapchain, frames);
-            vk::imgui::set_min_image_count(imgui, 2);
-            ctx.device.waitIdle();
-            grid_pipeline = create_grid_pipeline(ctx, swapchain);
+        const auto image_index = [&] {
+            profiler::CpuScope scope{frame_profiler.get(), "acquire"};
+            return swapchain->acquire(frame_index);
+        }();
+        if (!image_index) {
+            if (input_time) input.first_event = input_time;
+            recreate_swapchain();
+            redraw.request(1);
             continue;
         }
-        vk::frame::begin_commands(frames, frame_index);
+        const auto t_cpu = clock::now();
+        const auto& cmd  = frame_cmds[frame_index];
+        cmd.reset();
+        cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        frame_profiler->begin_commands(cmd, frame_index);
+
+        // ====================================================================
+        // This slot's last frame is done: free what it retired and reclaim
+        // finished staging space.
+        // ====================================================================
+        scene->begin_frame(frame_index);
+        frame_capture->begin_frame(frame_index);
+
+        // ====================================================================
+        // Start a new ImGui frame and build the UI; it decides whether the
+        // grid geometry needs rebuild.
+        // ====================================================================
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "ui"};
+            vk::imgui::begin_frame();
+            if (imgui_panel()) scene->mark_grid_dirty();
+        }
 
         // ====================================================================
-        // Start a new ImGui frame so UI can collect input state.
+        // A replay applies recorded settings where the panel edits them, so
+        // any grid rebuild lands in the same frame as when recorded.
         // ====================================================================
-        vk::imgui::begin_frame();
+        const replay::InputFrame* replayed = next_replay_frame();
 
         // ====================================================================
-        // Build the UI and decide whether the grid geometry needs rebuild.
+        // Rebuild the grid and pull a bounded number of decoded ray chunks
+        // onto the GPU, flushing the copies ahead of the frame's own submit.
         // ====================================================================
-        const bool rebuild_mesh = imgui_panel();
-        if (rebuild_mesh) {
-            ctx.device.waitIdle();
-            const auto mesh_cpu = build_ground_plane(grid.grid_extent);
-            grid_mesh           = upload_mesh_safe(ctx, mesh_cpu);
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "scene update"};
+            scene->update(frame_index);
         }
 
         // ====================================================================
         // Apply camera mode and prepare input for the controller.
         // ====================================================================
-        cam.set_mode(grid.fly_mode ? vk::camera::Mode::Fly : vk::camera::Mode::Orbit);
+        cam.set_mode(scene->grid_settings().fly_mode ? vk::camera::Mode::Fly : vk::camera::Mode::Orbit);
 
         const ImGuiIO& io      = ImGui::GetIO();
         const bool block_mouse = io.WantCaptureMouse;
@@ -251,12 +274,41 @@ void pngp::vis::rays::RaysInspector::run() {
         ci.down     = !block_kbd && input.keys[GLFW_KEY_Q];
         ci.up       = !block_kbd && input.keys[GLFW_KEY_E];
 
+        // ====================================================================
+        // Turntable sequence: a scripted orbit drag (as in the headless
+        // bench) for as long as the take wants frames.
+        // ====================================================================
+        if (frame_capture->capturing() && turntable_px != 0.0f) {
+            ci.alt      = true;
+            ci.lmb      = true;
+            ci.mouse_dx = turntable_px;
+        }
+
+        // ====================================================================
+        // Replay bypasses live input and the clock (dt was clamped when it
+        // was recorded); recording stores exactly what the camera gets.
+        // ====================================================================
+        if (replayed) {
+            ci = replayed->input;
+            dt = replayed->dt;
+        } else if (input_recorder) {
+            input_recorder->record(dt, ci, scene->grid_settings());
+        }
+
         // ====================================================================
         // Update camera matrices (view/projection) for this frame.
         // ====================================================================
-        cam.update(dt, swapchain.extent.width, swapchain.extent.height, ci);
+        cam.update(dt, swapchain->extent().width, swapchain->extent().height, ci);
         vk::imgui::draw_mini_axis_gizmo(cam.matrices().c2w);
 
+        // ====================================================================
+        // Hover picking against the ray BVH with this frame's camera.
+        // ====================================================================
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "pick"};
+            update_picking(block_mouse);
+        }
+
         // ====================================================================
         // Consume per-frame deltas so callbacks accumulate fresh movement.
         // ====================================================================
@@ -265,29 +317,40 @@ void pngp::vis::rays::RaysInspector::run() {
         input.scroll = 0.0f;
 
         // ====================================================================
-        // Cache per-frame MVP for the grid draw call.
+        // Cache per-frame MVP and eye for the grid draw call.
         // ====================================================================
         grid_mvp = cam.matrices().view_proj;
+        grid_eye = camera_eye(cam.matrices().c2w);
 
         // ====================================================================
-        // Record GPU work for this frame (grid + ImGui).
+        // Record GPU work for this frame (scene + ImGui).
         // ====================================================================
-        record_commands(frame_index, image_index);
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "record"};
+            record_commands(cmd, frame_index, *image_index);
+        }
 
         // ====================================================================
-        // Present the frame; recreate swapchain if presentation fails.
+        // Submit and present; recreate the swapchain if presentation fails.
+        // The pacer times input-carrying frames until their signal.
         // ====================================================================
-        if (vk::frame::end_frame(ctx, swapchain, frames, frame_index, image_index)) {
-            vk::swapchain::recreate_swapchain(ctx, surface, swapchain);
-            vk::frame::on_swapchain_recreated(ctx, swapchain, frames);
-            vk::imgui::set_min_image_count(imgui, 2);
-            ctx.device.waitIdle();
-            grid_pipeline = create_grid_pipeline(ctx, swapchain);
+        {
+            profiler::CpuScope scope{frame_profiler.get(), "submit + present"};
+            const bool presented = submit_frame(cmd, frame_index, *image_index);
+            pacer->submitted(frame_number++, input_time);
+            if (!presented) {
+                recreate_swapchain();
+                redraw.request(1);
+            }
         }
-
-        frame_index = (frame_index + 1) % frames.frames_in_flight;
+        frame_profiler->end_frame();
+        if (replayed) replay_log.push_back({1000.0f * replayed->dt, frame_ms, std::chrono::duration<double, std::milli>(clock::now() - t_cpu).count()});
+        track_redraw();
     }
+    stop_recording();
     ctx.device.waitIdle();
+    frame_capture->shutdown();
+    scene->shutdown();
     vk::imgui::shutdown(imgui);
 }
 
@@ -295,6 +358,8 @@ void pngp::vis::rays::RaysInspector::run() {
 // Constructor: create Vulkan systems and the initial grid resources.
 // ============================================================================
 pngp::vis::rays::RaysInspector::RaysInspector(const RaysInspectorInfo& info) {
+    if (info.render.frames_in_flight == 0 || info.render.frames_in_flight > max_frames_in_flight) throw std::invalid_argument(std::format("frames in flight must be 1..{}, got {}", max_frames_in_flight, info.render.frames_in_flight));
+
     auto [vkctx, surface] = vk::context::setup_vk_context_glfw("Dataset Viewer", "Engine");
 
     ctx           = std::move(vkctx);
@@ -308,10 +373,55 @@ pngp::vis::rays::RaysInspector::RaysInspector(const RaysInspectorInfo& info) {
     glfwSetMouseButtonCallback(this->surface.window.get(), &glfw_mouse_button_cb);
     glfwSetCursorPosCallback(this->surface.window.get(), &glfw_cursor_pos_cb);
     glfwSetScrollCallback(this->surface.window.get(), &glfw_scroll_cb);
+    glfwSetWindowRefreshCallback(this->surface.window.get(), &glfw_refresh_cb);
 
-    swapchain = vk::swapchain::setup_swapchain(ctx, this->surface);
-    frames    = vk::frame::create_frame_system(ctx, swapchain, 2);
-    imgui     = vk::imgui::create(ctx, this->surface.window.get(), swapchain.format, 2, static_cast<std::uint32_t>(swapchain.images.size()), info.render.enable_docking, info.render.enable_viewports);
+    // ========================================================================
+    // Swapchain, pacer and one command buffer per frame in flight. The
+    // graphics queue presents (the swapchain checks it can). vk-core does
+    // not report whether its device enables timeline semaphores, so the
+    // viewer paces on per-slot fences.
+    // ========================================================================
+    const std::uint32_t frames_in_flight = info.render.frames_in_flight;
+    const std::uint32_t queue_family     = upload::graphics_queue_family(ctx.physical_device);
+
+    int fb_width  = 0;
+    int fb_height = 0;
+    glfwGetFramebufferSize(this->surface.window.get(), &fb_width, &fb_height);
+    swapchain = std::make_unique<present::Swapchain>(ctx.physical_device, ctx.device, *this->surface.surface, queue_family, vk::Extent2D{static_cast<std::uint32_t>(fb_width), static_cast<std::uint32_t>(fb_height)},
+                                                     present::SwapchainInfo{.present_mode = info.render.present_mode, .frames_in_flight = frames_in_flight});
+    pacer     = std::make_unique<pacing::FramePacer>(ctx.device, pacing::PacerInfo{.frames_in_flight = frames_in_flight, .sync = pacing::PacerSync::fences});
+
+    command_pool = vk::raii::CommandPool(ctx.device, vk::CommandPoolCreateInfo{
+                                                         .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                                         .queueFamilyIndex = queue_family,
+                                                     });
+    auto cmds    = vk::raii::CommandBuffers(ctx.device, vk::CommandBufferAllocateInfo{
+                                                            .commandPool        = *command_pool,
+                                                            .level              = vk::CommandBufferLevel::ePrimary,
+                                                            .commandBufferCount = frames_in_flight,
+                                                        });
+    for (auto& c : cmds) frame_cmds.push_back(std::move(c));
+
+    // Detached ImGui windows get their own swapchains of at least this size.
+    imgui_min_images = std::max(2u, frames_in_flight);
+    imgui            = vk::imgui::create(ctx, this->surface.window.get(), swapchain->format(), imgui_min_images, swapchain->image_count(), info.render.enable_docking, info.render.enable_viewports);
+
+    // ========================================================================
+    // Scene: async upload path, pipeline library, and the ray dataset. The
+    // grid mesh is uploaded by the first frame (it starts out dirty).
+    // The device comes from vk-core, which does not report optional
+    // features, so indirect ray draws use the portable one-per-call path.
+    // ========================================================================
+    const GpuDevice gpu{&ctx.physical_device, &ctx.device, &ctx.graphics_queue, queue_family};
+    scene = std::make_unique<Scene>(gpu, SceneInfo{frames_in_flight, info.dataset, info.pipeline_cache});
+    scene->set_formats(swapchain->format(), swapchain->depth_format());
+
+    frame_profiler = std::make_unique<profiler::Profiler>(ctx.physical_device, ctx.device, gpu.queue_family, profiler::ProfilerInfo{.frames_in_flight = frames_in_flight});
+    trace_path     = info.trace;
+    frame_capture  = std::make_unique<capture::CaptureRing>(ctx.physical_device, ctx.device, capture::CaptureInfo{.frames_in_flight = frames_in_flight, .directory = info.captures});
+
+    redraw.on_demand      = info.render.on_demand;
+    redraw.idle_timeout_s = std::max(0.001, info.render.idle_timeout_s);
 
     // ========================================================================
     // Camera defaults tuned for a comfortable workspace view.
@@ -321,144 +431,145 @@ pngp::vis::rays::RaysInspector::RaysInspector(const RaysInspectorInfo& info) {
     cam_cfg.znear     = info.render.near_plane;
     cam_cfg.zfar      = info.render.far_plane;
     cam.set_config(cam_cfg);
+    home_camera();
+
+    record_path         = info.input_recording;
+    replay_timings_path = info.replay_timings;
+    if (info.record_at_start) start_recording();
+    if (!info.replay_input.empty()) {
+        start_replay(info.replay_input);
+        close_after_replay = true;
+    }
+}
+
+void pngp::vis::rays::RaysInspector::home_camera() {
     cam.home();
     cam.set_mode(vk::camera::Mode::Orbit);
     {
         auto st           = cam.state();
-        st.orbit.distance = std::max(1.0f, grid.grid_extent * 1.15f);
+        st.orbit.distance = std::max(1.0f, scene->grid_settings().grid_extent * 1.15f);
         cam.set_state(st);
     }
 
-    // ========================================================================
-    // Create grid resources once at startup.
-    // ========================================================================
-    const auto mesh_cpu = build_ground_plane(grid.grid_extent);
-    grid_mesh           = upload_mesh_safe(ctx, mesh_cpu);
-    grid_pipeline       = create_grid_pipeline(ctx, swapchain);
+    if (const auto radius = scene->dataset_radius()) {
+        auto st           = cam.state();
+        st.orbit.distance = std::max(st.orbit.distance, *radius * 2.0f);
+        cam.set_state(st);
+    }
 }
 
 // ============================================================================
-// Record a frame: render grid, then ImGui.
+// Input recording: both directions start from the home view, so a replay
+// retraces the recorded camera path exactly.
 // ============================================================================
-void pngp::vis::rays::RaysInspector::record_commands(std::uint32_t frame_index, std::uint32_t image_index) {
-    auto& cmd = vk::frame::cmd(frames, frame_index);
-
-    // ========================================================================
-    // Transition swapchain color image for rendering.
-    // ========================================================================
-    {
-        const vk::ImageMemoryBarrier2 barrier{
-            .srcStageMask     = vk::PipelineStageFlagBits2::eTopOfPipe,
-            .dstStageMask     = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-            .dstAccessMask    = vk::AccessFlagBits2::eColorAttachmentWrite,
-            .oldLayout        = frames.swapchain_image_layout[image_index],
-            .newLayout        = vk::ImageLayout::eColorAttachmentOptimal,
-            .image            = swapchain.images[image_index],
-            .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
-        };
-
-        const vk::DependencyInfo dep{
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers    = &barrier,
-        };
+void pngp::vis::rays::RaysInspector::start_recording() {
+    input_recorder.emplace();
+    home_camera();
+    input_status.clear();
+}
 
-        cmd.pipelineBarrier2(dep);
-        frames.swapchain_image_layout[image_index] = vk::ImageLayout::eColorAttachmentOptimal;
+void pngp::vis::rays::RaysInspector::stop_recording() {
+    if (!input_recorder) return;
+    try {
+        replay::write_recording(record_path, input_recorder->frames());
+        input_status = std::format("Wrote {} frames to {}", input_recorder->frames().size(), record_path.string());
+    } catch (const std::exception& e) {
+        input_status = e.what();
     }
+    input_recorder.reset();
+}
 
-    // ========================================================================
-    // Transition depth image for depth testing.
-    // ========================================================================
-    {
-        const vk::ImageMemoryBarrier2 barrier{
-            .srcStageMask     = vk::PipelineStageFlagBits2::eTopOfPipe,
-            .dstStageMask     = vk::PipelineStageFlagBits2::eEarlyFragmentTests,
-            .dstAccessMask    = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
-            .oldLayout        = swapchain.depth_layout,
-            .newLayout        = vk::ImageLayout::eDepthStencilAttachmentOptimal,
-            .image            = *swapchain.depth_image,
-            .subresourceRange = {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1},
-        };
+void pngp::vis::rays::RaysInspector::start_replay(const std::filesystem::path& path) {
+    stop_recording();
+    try {
+        replay_frames = replay::read_recording(path);
+        input_status.clear();
+    } catch (const std::exception& e) {
+        replay_frames.clear();
+        input_status = e.what();
+    }
+    replay_cursor = 0;
+    replaying     = false;
+    replay_log.clear();
+    replay_log.reserve(replay_frames.size());
+}
 
-        const vk::DependencyInfo dep{
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers    = &barrier,
-        };
+// ============================================================================
+// Replay waits for streaming to settle, then steps one recorded frame per
+// rendered frame. The call after the last frame writes the timings as CSV.
+// ============================================================================
+const pngp::vis::rays::replay::InputFrame* pngp::vis::rays::RaysInspector::next_replay_frame() {
+    if (replay_frames.empty() || (!replaying && scene->streaming())) return nullptr;
+    replaying = true;
+
+    if (replay_cursor == replay_frames.size()) {
+        if (!replay_timings_path.empty()) {
+            std::ofstream out(replay_timings_path, std::ios::trunc);
+            out << "frame,dt_ms,frame_ms,cpu_ms\n";
+            for (std::size_t i = 0; i < replay_log.size(); ++i) out << std::format("{},{:.4f},{:.4f},{:.4f}\n", i, replay_log[i].dt_ms, replay_log[i].frame_ms, replay_log[i].cpu_ms);
+            input_status = out ? std::format("Replayed {} frames, timings in {}", replay_log.size(), replay_timings_path.string()) : std::format("Could not write {}", replay_timings_path.string());
+        }
+        replay_frames.clear();
+        replaying = false;
+        if (close_after_replay) glfwSetWindowShouldClose(surface.window.get(), GLFW_TRUE);
+        return nullptr;
+    }
 
-        cmd.pipelineBarrier2(dep);
-        swapchain.depth_layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    const replay::InputFrame& f = replay_frames[replay_cursor++];
+    if (f.grid) {
+        const bool rebuild     = f.grid->grid_extent != scene->grid_settings().grid_extent;
+        scene->grid_settings() = *f.grid;
+        if (rebuild) scene->mark_grid_dirty();
     }
+    if (replay_cursor == 1) home_camera();
+    return &f;
+}
+
+// ============================================================================
+// Record a frame: scene pass, then ImGui. A capture copies the image after
+// the scene pass or, with the UI included, after ImGui.
+// ============================================================================
+void pngp::vis::rays::RaysInspector::record_commands(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index, std::uint32_t image_index) {
+    profiler::GpuScope frame_scope{frame_profiler.get(), cmd, "frame"};
 
     // ========================================================================
-    // Clear targets: black background + default depth.
+    // Scene pass (rays + grid, then the OIT resolve of translucent rays)
+    // into the acquired swapchain image.
     // ========================================================================
-    vk::ClearValue clear_color{};
-    clear_color.color = vk::ClearColorValue{std::array{0.f, 0.f, 0.f, 1.0f}};
-
-    vk::ClearValue clear_depth{};
-    clear_depth.depthStencil = vk::ClearDepthStencilValue{1.0f, 0};
-
-    const vk::RenderingAttachmentInfo color{
-        .imageView   = *swapchain.image_views[image_index],
-        .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-        .loadOp      = vk::AttachmentLoadOp::eClear,
-        .storeOp     = vk::AttachmentStoreOp::eStore,
-        .clearValue  = clear_color,
-    };
-
-    const vk::RenderingAttachmentInfo depth{
-        .imageView   = *swapchain.depth_view,
-        .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
-        .loadOp      = vk::AttachmentLoadOp::eClear,
-        .storeOp     = vk::AttachmentStoreOp::eStore,
-        .clearValue  = clear_depth,
+    const RenderTargets targets{
+        .extent       = swapchain->extent(),
+        .color        = swapchain->image(image_index),
+        .color_view   = swapchain->view(image_index),
+        .color_layout = &swapchain->layout(image_index),
+        .depth        = swapchain->depth_image(),
+        .depth_view   = swapchain->depth_view(),
+        .depth_layout = &swapchain->depth_layout(),
     };
-
-    const vk::RenderingInfo rendering{
-        .renderArea           = {{0, 0}, swapchain.extent},
-        .layerCount           = 1,
-        .colorAttachmentCount = 1,
-        .pColorAttachments    = &color,
-        .pDepthAttachment     = &depth,
-    };
-
-    cmd.beginRendering(rendering);
-    const vk::Viewport vp{
-        .x        = 0.f,
-        .y        = static_cast<float>(swapchain.extent.height),
-        .width    = static_cast<float>(swapchain.extent.width),
-        .height   = -static_cast<float>(swapchain.extent.height),
-        .minDepth = 0.f,
-        .maxDepth = 1.f,
-    };
-
-    const vk::Rect2D scissor{{0, 0}, swapchain.extent};
-
-    cmd.setViewport(0, {vp});
-    cmd.setScissor(0, {scissor});
+    scene->record(cmd, frame_index, targets, grid_mvp, grid_eye, frame_profiler.get());
 
     // ========================================================================
-    // Grid draw: one quad + procedural shader.
+    // The capture reads the swapchain image directly (when the surface
+    // allows transfer-src usage); the copy rides this frame's submit.
     // ========================================================================
-    const bool grid_visible = grid.show_grid || grid.show_axes || grid.show_origin;
-    if (grid_mesh.index_count > 0 && grid_visible) {
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *grid_pipeline.pipeline);
-        const GridPush push = make_grid_push(grid, grid_mvp);
-        cmd.pushConstants(*grid_pipeline.layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, vk::ArrayProxy<const GridPush>{push});
-
-        vk::DeviceSize offset = 0;
-        cmd.bindVertexBuffers(0, {*grid_mesh.vertex_buffer.buffer}, {offset});
-        cmd.bindIndexBuffer(*grid_mesh.index_buffer.buffer, 0, vk::IndexType::eUint32);
-        cmd.drawIndexed(grid_mesh.index_count, 1, 0, 0, 0);
+    const capture::CaptureSource capture_source{swapchain->image(image_index), swapchain->format(), swapchain->extent(), vk::ImageLayout::eColorAttachmentOptimal, swapchain->transfer_source()};
+    const bool capture_frame = frame_capture->capturing();
+    if (capture_frame && !capture_ui) {
+        profiler::GpuScope scope{frame_profiler.get(), cmd, "capture"};
+        frame_capture->record(cmd, frame_index, capture_source);
     }
 
-    cmd.endRendering();
-
     // ========================================================================
     // ImGui pass (draw UI on top of scene).
     // ========================================================================
-    vk::imgui::render(imgui, cmd, swapchain.extent, *swapchain.image_views[image_index], vk::ImageLayout::eColorAttachmentOptimal);
-    vk::imgui::end_frame();
+    {
+        profiler::GpuScope scope{frame_profiler.get(), cmd, "imgui"};
+        vk::imgui::render(imgui, cmd, swapchain->extent(), swapchain->view(image_index), vk::ImageLayout::eColorAttachmentOptimal);
+        vk::imgui::end_frame();
+    }
+    if (capture_frame && capture_ui) {
+        profiler::GpuScope scope{frame_profiler.get(), cmd, "capture"};
+        frame_capture->record(cmd, frame_index, capture_source);
+    }
 
     // ========================================================================
     // Transition swapchain image for presentation.
@@ -470,7 +581,7 @@ void pngp::vis::rays::RaysInspector::record_commands(std::uint32_t frame_index,
             .dstStageMask     = vk::PipelineStageFlagBits2::eBottomOfPipe,
             .oldLayout        = vk::ImageLayout::eColorAttachmentOptimal,
             .newLayout        = vk::ImageLayout::ePresentSrcKHR,
-            .image            = swapchain.images[image_index],
+            .image            = swapchain->image(image_index),
             .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
         };
 
@@ -480,28 +591,286 @@ void pngp::vis::rays::RaysInspector::record_commands(std::uint32_t frame_index,
         };
 
         cmd.pipelineBarrier2(dep);
-        frames.swapchain_image_layout[image_index] = vk::ImageLayout::ePresentSrcKHR;
+        swapchain->layout(image_index) = vk::ImageLayout::ePresentSrcKHR;
     }
 }
 
+bool pngp::vis::rays::RaysInspector::submit_frame(const vk::raii::CommandBuffer& cmd, const std::uint32_t frame_index, const std::uint32_t image_index) {
+    cmd.end();
+
+    const vk::SemaphoreSubmitInfo wait = swapchain->acquire_wait(frame_index);
+    const vk::SemaphoreSubmitInfo signal = swapchain->present_signal(image_index);
+    const vk::CommandBufferSubmitInfo cmd_info{.commandBuffer = *cmd};
+    const vk::SubmitInfo2 submit{
+        .waitSemaphoreInfoCount   = 1,
+        .pWaitSemaphoreInfos      = &wait,
+        .commandBufferInfoCount   = 1,
+        .pCommandBufferInfos      = &cmd_info,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos    = &signal,
+    };
+    pacer->submit(ctx.graphics_queue, submit, frame_number);
+    return swapchain->present(ctx.graphics_queue, image_index);
+}
+
+// ============================================================================
+// No device idle: frames in flight keep the old images, which the swapchain
+// retires until the first frame on the new ones completes. That frame is
+// queued behind the old images' last presents, so their semaphores are
+// released by then as well.
+// ============================================================================
+void pngp::vis::rays::RaysInspector::recreate_swapchain() {
+    int width  = 0;
+    int height = 0;
+    glfwGetFramebufferSize(surface.window.get(), &width, &height);
+    while ((width <= 0 || height <= 0) && !glfwWindowShouldClose(surface.window.get())) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(surface.window.get(), &width, &height);
+    }
+
+    swapchain->collect(pacer->completed());
+    if (!swapchain->recreate(vk::Extent2D{static_cast<std::uint32_t>(std::max(width, 0)), static_cast<std::uint32_t>(std::max(height, 0))}, frame_number + 1)) return;
+    vk::imgui::set_min_image_count(imgui, imgui_min_images);
+    scene->set_formats(swapchain->format(), swapchain->depth_format());
+}
+
+// ============================================================================
+// Picking: a click pins whatever was hovered last frame (the press itself
+// starts a drag, which suspends hovering). Cursor and overlay both work in
+// window coordinates, so no framebuffer scaling is involved.
+// ============================================================================
+void pngp::vis::rays::RaysInspector::update_picking(const bool mouse_blocked) {
+    if (std::exchange(input.lmb_clicked, false) && !mouse_blocked) selected = hovered;
+
+    const auto* file = scene->ray_file();
+    if (!file) return;
+
+    int width  = 0;
+    int height = 0;
+    glfwGetWindowSize(surface.window.get(), &width, &height);
+    const std::array viewport{static_cast<float>(width), static_cast<float>(height)};
+    const auto& view_proj = cam.matrices().view_proj;
+
+    const bool dragging = input.lmb || input.mmb || input.rmb;
+    hovered.reset();
+    if (hover_picking && !mouse_blocked && !dragging) {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (const auto ray = picking::cursor_ray(view_proj, viewport, {static_cast<float>(input.last_x), static_cast<float>(input.last_y)}, pick_radius_px)) hovered = scene->pick(*ray);
+        pick_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    if (selected) highlight_ray(*file, *selected, view_proj, viewport, IM_COL32(255, 210, 0, 255));
+    if (hovered) highlight_ray(*file, *hovered, view_proj, viewport, IM_COL32(255, 255, 255, 200));
+}
+
+// ============================================================================
+// Dirty sources, checked after every rendered frame: input events, camera
+// motion (inertia, held keys, scripted moves), settings edited by the panel
+// or by code, scene work in flight, and ImGui widgets mid-interaction.
+// ============================================================================
+void pngp::vis::rays::RaysInspector::track_redraw() {
+    if (redraw.frames_left > 0) --redraw.frames_left;
+    if (std::exchange(input.activity, false)) redraw.request(settle_frames);
+
+    const auto view_proj = std::bit_cast<std::array<float, 16>>(cam.matrices().view_proj);
+    if (view_proj != redraw.view_proj) redraw.request(settle_frames);
+    redraw.view_proj = view_proj;
+
+    if (scene->grid_settings() != redraw.grid || scene->ray_settings() != redraw.rays || scene->filter_settings() != redraw.filters) redraw.request(settle_frames);
+    redraw.grid    = scene->grid_settings();
+    redraw.rays    = scene->ray_settings();
+    redraw.filters = scene->filter_settings();
+
+    if (scene->has_pending_work()) redraw.request(1);
+    // A take renders every frame; its last copies still need a pass through
+    // their frame slots before the writer gets them.
+    if (frame_capture->capturing() || frame_capture->readback_pending()) redraw.request(1);
+    if (!replay_frames.empty()) redraw.request(1);
+    if (ImGui::IsAnyItemActive() || ImGui::GetIO().WantTextInput) redraw.request(1);
+
+    // A held button or key keeps a drag / fly move going without events.
+    const bool held = input.lmb || input.mmb || input.rmb || std::ranges::any_of(input.keys, std::identity{});
+    if (held) redraw.request(1);
+}
+
+// ============================================================================
+// Any early return from the wait is an event, including ones on detached
+// ImGui windows whose callbacks never reach InputState. A minimized window
+// (zero framebuffer) stays idle.
+// ============================================================================
+bool pngp::vis::rays::RaysInspector::wait_for_redraw() {
+    if (!redraw.on_demand) return true;
+
+    const auto resized = [&] {
+        int width  = 0;
+        int height = 0;
+        glfwGetFramebufferSize(surface.window.get(), &width, &height);
+        if (width <= 0 || height <= 0) return false;
+        return static_cast<std::uint32_t>(width) != swapchain->extent().width || static_cast<std::uint32_t>(height) != swapchain->extent().height;
+    };
+
+    if (std::exchange(input.activity, false)) redraw.request(settle_frames);
+    if (redraw.frames_left > 0 || resized()) return true;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    glfwWaitEventsTimeout(redraw.idle_timeout_s);
+    const bool woke_early = std::chrono::steady_clock::now() - t0 < std::chrono::duration<double>(redraw.idle_timeout_s);
+    if (std::exchange(input.activity, false) || woke_early) redraw.request(settle_frames);
+    return redraw.frames_left > 0 || resized();
+}
+
 // ============================================================================
 // ImGui panel: return true when geometry should be rebuilt.
 // ============================================================================
 bool pngp::vis::rays::RaysInspector::imgui_panel() {
     bool rebuild = false;
+    auto& grid   = scene->grid_settings();
+    auto& rays   = scene->ray_settings();
     ImGui::Begin("Rays Inspector");
     ImGui::TextUnformatted("Ground Plane");
     ImGui::Checkbox("Show grid", &grid.show_grid);
     ImGui::Checkbox("Show axes", &grid.show_axes);
     ImGui::Checkbox("Show origin", &grid.show_origin);
     ImGui::Separator();
-    rebuild |= ImGui::SliderFloat("Grid extent", &grid.grid_extent, 2.0f, 100.0f);
+    ImGui::Checkbox("Infinite grid", &grid.infinite);
+    if (grid.infinite) ImGui::SliderFloat("Fade distance", &grid.fade_distance, 5.0f, 1000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+    else rebuild |= ImGui::SliderFloat("Grid extent", &grid.grid_extent, 2.0f, 100.0f);
     ImGui::SliderFloat("Grid step", &grid.grid_step, 0.1f, 5.0f);
     ImGui::SliderInt("Major every", &grid.major_every, 1, 20);
     ImGui::SliderFloat("Axis length", &grid.axis_length, 0.5f, 20.0f);
     ImGui::SliderFloat("Origin scale", &grid.origin_scale, 0.05f, 2.0f);
     ImGui::Separator();
+    ImGui::TextUnformatted("Rays");
+    if (const auto* file = scene->ray_file()) {
+        const auto& h = file->header();
+        ImGui::Checkbox("Show rays", &rays.show_rays);
+        ImGui::SliderFloat("Ray opacity", &rays.opacity, 0.05f, 1.0f);
+        ImGui::BeginDisabled(rays.density);
+        ImGui::Checkbox("Order-independent transparency", &rays.oit);
+        ImGui::EndDisabled();
+        ImGui::SliderInt("Chunks per frame", &rays.chunks_per_frame, 1, 32);
+        ImGui::Checkbox("Level of detail", &rays.lod);
+        ImGui::BeginDisabled(!rays.lod);
+        ImGui::SliderFloat("Rays per pixel", &rays.rays_per_pixel, 0.01f, 4.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+        ImGui::EndDisabled();
+        ImGui::Checkbox("Density heatmap", &rays.density);
+        ImGui::BeginDisabled(!rays.density);
+        ImGui::Checkbox("Ray colors", &rays.density_radiance);
+        ImGui::SliderFloat("Exposure", &rays.density_exposure, 0.0001f, 10.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Splat budget (ms)", &rays.density_budget_ms, 0.25f, 16.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+        ImGui::Text("Converged: %.1f%%, %llu rays / frame", 100.0f * scene->density_progress(), static_cast<unsigned long long>(scene->density_rays_per_frame()));
+        ImGui::EndDisabled();
+        ImGui::Text("Chunks: %zu / %u", scene->chunks_resident(), h.chunk_count);
+        ImGui::Text("Rays: %llu / %llu", static_cast<unsigned long long>(scene->rays_resident()), static_cast<unsigned long long>(h.ray_count));
+        const auto& memory = scene->memory();
+        ImGui::Text("VRAM: %.0f / %.0f MB%s", static_cast<double>(memory.device_local_usage()) / (1024.0 * 1024.0), static_cast<double>(memory.device_local_budget()) / (1024.0 * 1024.0), memory.tracked() ? "" : " (no budget ext.)");
+        ImGui::Text("Pool: %zu slots, %llu evictions", scene->pool_slots(), static_cast<unsigned long long>(scene->chunks_evicted()));
+        if (ImGui::CollapsingHeader("Picking", ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Checkbox("Hover picking", &hover_picking);
+            ImGui::SliderFloat("Pick radius (px)", &pick_radius_px, 1.0f, 24.0f);
+            ImGui::Text("Pick: %.3f ms, %zu / %zu chunks indexed", pick_ms, scene->chunks_pickable(), scene->chunks_resident());
+            ray_details("Hovered", *file, hovered);
+            ray_details("Selected", *file, selected);
+            if (selected && ImGui::Button("Clear selection")) selected.reset();
+        }
+        if (ImGui::CollapsingHeader("Filters", ImGuiTreeNodeFlags_DefaultOpen)) {
+            // Predicates on columns the file lacks stay disabled.
+            auto& filters         = scene->filter_settings();
+            const bool has_camera = (h.columns & dataset::column_bit(dataset::Column::CameraId)) != 0;
+            const bool has_pixel  = (h.columns & dataset::column_bit(dataset::Column::Pixel)) != 0;
+            ImGui::Checkbox("Enable filters", &filters.enabled);
+            ImGui::BeginDisabled(!filters.enabled);
+            ImGui::BeginDisabled(!has_camera);
+            ImGui::Checkbox("By camera", &filters.by_camera);
+            ImGui::DragIntRange2("Camera ids", &filters.camera_min, &filters.camera_max, 0.2f, 0, std::numeric_limits<int>::max());
+            ImGui::EndDisabled();
+            ImGui::BeginDisabled(!has_pixel);
+            ImGui::Checkbox("By pixel", &filters.by_pixel);
+            ImGui::DragInt2("Pixel min", filters.pixel_min.data(), 1.0f, 0, 65535);
+            ImGui::DragInt2("Pixel max", filters.pixel_max.data(), 1.0f, 0, 65535);
+            ImGui::EndDisabled();
+            ImGui::Checkbox("By hit distance", &filters.by_depth);
+            ImGui::DragFloatRange2("Hit distance", &filters.depth_min, &filters.depth_max, 0.05f, 0.0f, std::numeric_limits<float>::max());
+            ImGui::EndDisabled();
+            ImGui::Text("Selected: %llu / %llu rays", static_cast<unsigned long long>(scene->rays_selected()), static_cast<unsigned long long>(scene->rays_resident()));
+        }
+    } else {
+        ImGui::TextUnformatted("No dataset loaded (pass a .rays file on the command line)");
+    }
+    ImGui::Separator();
+    if (ImGui::CollapsingHeader("Profiler")) {
+        // Rolling average/max over the last frames; nested scopes overlap
+        // their parents (scene contains layout barriers, rays, grid).
+        const auto scope_table = [](const char* id, const std::vector<profiler::ScopeStats>& stats) {
+            if (!ImGui::BeginTable(id, 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) return;
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("avg ms");
+            ImGui::TableSetupColumn("max ms");
+            ImGui::TableHeadersRow();
+            for (const auto& s : stats) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(s.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", s.avg_ms);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", s.max_ms);
+            }
+            ImGui::EndTable();
+        };
+        // Input event to GPU completion of the frame that showed it; display
+        // scan-out (the vblank wait under FIFO) comes on top.
+        const auto latency = pacer->latency();
+        ImGui::Text("Present: %s, %u frames in flight", vk::to_string(swapchain->present_mode()).c_str(), pacer->frames_in_flight());
+        ImGui::Text("Input latency: %.2f ms (avg %.2f, max %.2f over %zu)", latency.last_ms, latency.average_ms, latency.max_ms, latency.samples);
+        ImGui::TextUnformatted("CPU");
+        scope_table("cpu_scopes", frame_profiler->cpu_stats());
+        ImGui::TextUnformatted("GPU");
+        if (frame_profiler->gpu_supported()) scope_table("gpu_scopes", frame_profiler->gpu_stats());
+        else ImGui::TextUnformatted("Timestamps unsupported on this queue");
+
+        if (ImGui::Button("Export trace")) trace_status = frame_profiler->export_chrome_trace(trace_path) ? std::format("Wrote {}", trace_path.string()) : std::string("Trace export failed");
+        if (!trace_status.empty()) ImGui::TextUnformatted(trace_status.c_str());
+    }
+    ImGui::Separator();
+    if (ImGui::CollapsingHeader("Capture")) {
+        // Frames that find every staging buffer busy are dropped, never waited on.
+        int encoding = static_cast<int>(capture_encoding);
+        ImGui::Combo("Encoding", &encoding, "PNG\0Raw (PPM)\0");
+        capture_encoding = static_cast<capture::ImageEncoding>(encoding);
+        ImGui::Checkbox("Include UI", &capture_ui);
+        if (ImGui::Button("Screenshot")) frame_capture->request(1, capture_encoding);
+        ImGui::SliderInt("Sequence frames", &sequence_frames, 2, 3600, "%d", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Turntable (px / frame)", &turntable_px, -20.0f, 20.0f);
+        if (ImGui::Button(frame_capture->capturing() ? "Stop sequence" : "Record sequence")) frame_capture->request(frame_capture->capturing() ? 0 : static_cast<std::uint32_t>(sequence_frames), capture_encoding);
+        ImGui::Text("Captured %llu, dropped %llu, written %llu", static_cast<unsigned long long>(frame_capture->frames_captured()), static_cast<unsigned long long>(frame_capture->frames_dropped()), static_cast<unsigned long long>(frame_capture->frames_written()));
+        if (const auto status = frame_capture->status(); !status.empty()) ImGui::TextUnformatted(status.c_str());
+    }
+    ImGui::Separator();
+    if (ImGui::CollapsingHeader("Input recording")) {
+        ImGui::Text("File: %s", record_path.string().c_str());
+        if (input_recorder) {
+            if (ImGui::Button("Stop recording")) stop_recording();
+            ImGui::SameLine();
+            ImGui::Text("%zu frames", input_recorder->frames().size());
+        } else if (replay_frames.empty()) {
+            if (ImGui::Button("Record")) start_recording();
+            ImGui::SameLine();
+            if (ImGui::Button("Replay")) start_replay(record_path);
+        } else {
+            if (ImGui::Button("Stop replay")) {
+                replay_frames.clear();
+                replaying = false;
+            }
+            ImGui::SameLine();
+            if (replaying) ImGui::Text("Frame %zu / %zu", replay_cursor, replay_frames.size());
+            else ImGui::TextUnformatted("Waiting for streaming");
+        }
+        if (!input_status.empty()) ImGui::TextUnformatted(input_status.c_str());
+    }
+    ImGui::Separator();
     ImGui::Checkbox("Fly mode", &grid.fly_mode);
+    ImGui::Checkbox("Render on demand", &redraw.on_demand);
     ImGui::TextUnformatted("Orbit: Alt/Space + LMB rotate, MMB pan, wheel zoom");
     ImGui::TextUnformatted("Fly: RMB look + WASD move, Q/E down/up");
     ImGui::End();
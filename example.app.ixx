@@ -1,38 +1,24 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
 export module pngp.vis.rays;
 // ============================================================================
 // Rays Inspector public interface.
 // ============================================================================
 import vk.context;
-import vk.swapchain;
-import vk.frame;
 import vk.imgui;
 import vk.camera;
-import vk.pipeline;
-import vk.memory;
-import vk.geometry;
 import vk.math;
+import pngp.vis.rays.scene;
+import pngp.vis.rays.picking;
+import pngp.vis.rays.filter;
+import pngp.vis.rays.profiler;
+import pngp.vis.rays.capture;
+import pngp.vis.rays.replay;
+import pngp.vis.rays.pacing;
+import pngp.vis.rays.present;
 import std;
 
 namespace pngp::vis::rays {
-    // ========================================================================
-    // Ground grid UI + render settings.
-    // These values are mirrored into shader push constants each frame, so only
-    // geometry-dependent knobs should trigger mesh rebuilds.
-    // ========================================================================
-    struct GridSettings {
-        bool show_grid   = true;
-        bool show_axes   = true;
-        bool show_origin = true;
-        bool fly_mode    = false;
-
-        float grid_extent = 30.0f;
-        float grid_step   = 1.0f;
-        int major_every   = 5;
-
-        float axis_length  = 4.0f;
-        float origin_scale = 0.25f;
-    };
-
     // ========================================================================
     // Lightweight input cache (GLFW callbacks fill, camera consumes).
     // ========================================================================
@@ -46,6 +32,12 @@ namespace pngp::vis::rays {
         double last_x  = 0.0;
         double last_y  = 0.0;
         bool have_last = false;
+        // Left button went down since the last frame (consumed by picking).
+        bool lmb_clicked = false;
+        // Any callback fired since the last frame (consumed by redraw).
+        bool activity = false;
+        // First callback since the last frame (consumed by latency timing).
+        std::optional<pacing::Clock::time_point> first_event{};
 
         float dx     = 0.0f;
         float dy     = 0.0f;
@@ -62,10 +54,62 @@ namespace pngp::vis::rays {
         bool srgb_textures    = true;
         bool enable_docking   = true;
         bool enable_viewports = true;
+        // Render only when something marks the view dirty; otherwise sleep
+        // in glfwWaitEventsTimeout and re-check every idle_timeout_s.
+        bool on_demand        = true;
+        double idle_timeout_s = 0.25;
+        // ====================================================================
+        // Latency vs throughput: one frame in flight samples input right
+        // before the GPU needs it; more keep the GPU busy. Mailbox and
+        // immediate present without waiting for vblank (FIFO when the
+        // surface lacks them).
+        // ====================================================================
+        std::uint32_t frames_in_flight  = 2;
+        vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+    };
+
+    // ========================================================================
+    // On-demand redraw bookkeeping. Every dirty source requests a number of
+    // frames; the loop idles once the count runs out.
+    // ========================================================================
+    struct RedrawState {
+        bool on_demand            = true;
+        double idle_timeout_s     = 0.25;
+        std::uint32_t frames_left = 1;
+        // Snapshots of what the last rendered frame showed.
+        std::array<float, 16> view_proj{};
+        GridSettings grid{};
+        RaySettings rays{};
+        filter::FilterSettings filters{};
+
+        void request(const std::uint32_t frames) noexcept {
+            frames_left = std::max(frames_left, frames);
+        }
     };
 
+    // Upper bound on ViewerRenderConfig::frames_in_flight (at least one).
+    export constexpr std::uint32_t max_frames_in_flight = 4;
+
     export struct RaysInspectorInfo {
         ViewerRenderConfig render{};
+        // Optional ray dump to stream in; empty shows only the ground plane.
+        std::filesystem::path dataset{};
+        // Driver pipeline cache blob, reloaded on the next launch.
+        std::filesystem::path pipeline_cache = "rays_pipeline_cache.bin";
+        // Chrome trace written by the profiler panel's export button.
+        std::filesystem::path trace = "rays_trace.json";
+        // Directory screenshots and frame sequences are written to.
+        std::filesystem::path captures = "captures";
+        // ====================================================================
+        // Input recording: camera input + dt per frame, written when the
+        // recording stops (or on exit). A replay drives the camera instead
+        // of the mouse and writes per-frame timings; a replay given here
+        // starts with the viewer and closes it when done.
+        // ====================================================================
+        std::filesystem::path input_recording = "rays_input.rin";
+        bool record_at_start                  = false;
+        std::filesystem::path replay_input{};
+        std::filesystem::path replay_timings = "rays_replay_timings.csv";
     };
 
     // ========================================================================
@@ -89,11 +133,48 @@ namespace pngp::vis::rays {
         // ====================================================================
         // Build the per-frame command buffer contents.
         // ====================================================================
-        void record_commands(std::uint32_t frame_index, std::uint32_t image_index);
+        void record_commands(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index, std::uint32_t image_index);
+        // ====================================================================
+        // Submit the recorded frame (acquire wait, present signal, pacer
+        // fence) and present; false when the swapchain must be recreated.
+        // ====================================================================
+        bool submit_frame(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index, std::uint32_t image_index);
+        // ====================================================================
+        // Rebuild the swapchain for the window size without idling: the old
+        // images are retired until the pacer reaches value frame_number + 1,
+        // i.e. the first frame on the new ones has completed. Blocks in the
+        // event queue while the window is minimized.
+        // ====================================================================
+        void recreate_swapchain();
         // ====================================================================
         // Draw ImGui widgets; returns true when geometry needs rebuild.
         // ====================================================================
         bool imgui_panel();
+        // ====================================================================
+        // Hover pick under the cursor; a left click pins the hovered ray.
+        // ====================================================================
+        void update_picking(bool mouse_blocked);
+        // ====================================================================
+        // After a rendered frame: collect every dirty source into redraw.
+        // ====================================================================
+        void track_redraw();
+        // ====================================================================
+        // On-demand mode: block until an event or a dirty source needs a
+        // frame. Returns false when the loop should skip this iteration.
+        // ====================================================================
+        bool wait_for_redraw();
+        // ====================================================================
+        // Orbit framing of the grid (and dataset) that recordings start from.
+        // ====================================================================
+        void home_camera();
+        // ====================================================================
+        // Next recorded frame with its grid settings applied, or null when
+        // no replay is running; the last call writes the timings.
+        // ====================================================================
+        const replay::InputFrame* next_replay_frame();
+        void start_recording();
+        void stop_recording();
+        void start_replay(const std::filesystem::path& path);
 
     private:
         // ====================================================================
@@ -101,23 +182,72 @@ namespace pngp::vis::rays {
         // ====================================================================
         vk::context::VulkanContext ctx;
         vk::context::SurfaceContext surface;
-        vk::swapchain::Swapchain swapchain;
-        vk::frame::FrameSystem frames;
+        std::unique_ptr<present::Swapchain> swapchain;
+        // ====================================================================
+        // Frame pacing: frame n records into command buffer n % frames in
+        // flight once the pacer says that slot's last frame is done.
+        // ====================================================================
+        std::unique_ptr<pacing::FramePacer> pacer;
+        vk::raii::CommandPool command_pool{nullptr};
+        std::vector<vk::raii::CommandBuffer> frame_cmds;
+        std::uint64_t frame_number     = 0;
+        std::uint32_t imgui_min_images = 2;
         vk::imgui::ImGuiSystem imgui;
         // ====================================================================
+        // Grid + ray resources, uploads, and pipelines.
+        // ====================================================================
+        std::unique_ptr<Scene> scene;
+        // ====================================================================
+        // CPU stage timers + per-pass GPU timestamps.
+        // ====================================================================
+        std::unique_ptr<profiler::Profiler> frame_profiler;
+        std::filesystem::path trace_path;
+        std::string trace_status;
+        // ====================================================================
+        // Screenshot / frame-sequence capture. A sequence can drive a
+        // turntable orbit so every frame differs without touching the mouse.
+        // ====================================================================
+        std::unique_ptr<capture::CaptureRing> frame_capture;
+        capture::ImageEncoding capture_encoding = capture::ImageEncoding::png;
+        bool capture_ui                         = true;
+        int sequence_frames                     = 120;
+        float turntable_px                      = 0.0f;
+        // ====================================================================
+        // Input recording / replay. Replay starts once streaming settles so
+        // every run times the same resident set.
+        // ====================================================================
+        struct ReplayTiming {
+            float dt_ms     = 0.0f;
+            double frame_ms = 0.0;
+            double cpu_ms   = 0.0;
+        };
+        std::optional<replay::InputRecorder> input_recorder{};
+        std::filesystem::path record_path;
+        std::vector<replay::InputFrame> replay_frames;
+        std::size_t replay_cursor = 0;
+        bool replaying            = false;
+        std::vector<ReplayTiming> replay_log;
+        std::filesystem::path replay_timings_path;
+        bool close_after_replay = false;
+        std::string input_status;
+        // ====================================================================
         // Camera controller.
         // ====================================================================
         vk::camera::Camera cam;
+        vk::math::mat4 grid_mvp{};
+        std::array<float, 3> grid_eye{};
         // ====================================================================
-        // Grid GPU resources.
+        // Ray picking (hover + pinned selection).
         // ====================================================================
-        vk::pipeline::GraphicsPipeline grid_pipeline;
-        vk::memory::MeshGPU grid_mesh;
-        vk::math::mat4 grid_mvp{};
+        bool hover_picking   = true;
+        float pick_radius_px = 6.0f;
+        double pick_ms       = 0.0;
+        std::optional<picking::PickHit> hovered{};
+        std::optional<picking::PickHit> selected{};
         // ====================================================================
         // UI + input state.
         // ====================================================================
-        GridSettings grid{};
         InputState input{};
+        RedrawState redraw{};
     };
 } // namespace pngp::vis::rays
@@ -0,0 +1,57 @@
+// ============================================================================
+// App entry point.
+// ============================================================================
+import std;
+import pngp.vis.rays;
+import pngp.vis.rays.present;
+
+namespace {
+    void print_usage() {
+        std::println(stderr, "usage: example-app [dataset.rays] [--record input.rin] [--replay input.rin] [--timings timings.csv] [--present fifo|mailbox|immediate] [--frames-in-flight N]");
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    pngp::vis::rays::RaysInspectorInfo info{};
+
+    const std::vector<std::string_view> args(argv + 1, argv + argc);
+    bool valid = true;
+    for (std::size_t i = 0; i < args.size() && valid; ++i) {
+        const auto value = [&]() -> std::string_view { return i + 1 < args.size() ? args[++i] : std::string_view{}; };
+
+        if (args[i] == "--record") {
+            info.input_recording = value();
+            info.record_at_start = true;
+            valid                = !info.input_recording.empty();
+        } else if (args[i] == "--replay") {
+            info.replay_input = value();
+            valid             = !info.replay_input.empty();
+        } else if (args[i] == "--timings") {
+            info.replay_timings = value();
+            valid               = !info.replay_timings.empty();
+        } else if (args[i] == "--present") {
+            const auto mode = pngp::vis::rays::present::parse_present_mode(value());
+            if (mode) info.render.present_mode = *mode;
+            valid = mode.has_value();
+        } else if (args[i] == "--frames-in-flight") {
+            const auto s = value();
+            valid        = !s.empty() && std::from_chars(s.data(), s.data() + s.size(), info.render.frames_in_flight).ec == std::errc{};
+            if (valid && (info.render.frames_in_flight == 0 || info.render.frames_in_flight > pngp::vis::rays::max_frames_in_flight)) {
+                std::println(stderr, "--frames-in-flight must be 1..{}, got {}", pngp::vis::rays::max_frames_in_flight, info.render.frames_in_flight);
+                valid = false;
+            }
+        } else if (!args[i].starts_with("--") && info.dataset.empty()) {
+            info.dataset = args[i];
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        print_usage();
+        return 2;
+    }
+
+    pngp::vis::rays::RaysInspector app{info};
+    app.run();
+    return 0;
+}
@@ -0,0 +1,377 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.capture;
+// ============================================================================
+// Frame capture implementation.
+// ============================================================================
+import std;
+import pngp.vis.rays.upload;
+
+// ============================================================================
+// Translation-unit helpers (PNG container, checksums, pixel rows).
+// ============================================================================
+namespace {
+    constexpr std::uint32_t bytes_per_pixel = 4;
+    // Largest payload of one stored (uncompressed) deflate block.
+    constexpr std::size_t stored_block_max = 65535;
+
+    // ========================================================================
+    // CRC-32 slicing-by-8: eight table lookups per 8 bytes instead of a
+    // dependent lookup per byte (the whole image passes through it).
+    // ========================================================================
+    constexpr std::array<std::array<std::uint32_t, 256>, 8> crc_tables = [] {
+        std::array<std::array<std::uint32_t, 256>, 8> t{};
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[0][n] = c;
+        }
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            for (std::size_t k = 1; k < 8; ++k) t[k][n] = t[0][t[k - 1][n] & 0xffu] ^ (t[k - 1][n] >> 8);
+        }
+        return t;
+    }();
+
+    // Chains: crc32(b, crc32(a)) == crc32(a + b).
+    std::uint32_t crc32(const std::span<const std::uint8_t> data, std::uint32_t crc = 0) {
+        const auto& t = crc_tables;
+        crc           = ~crc;
+        std::size_t i = 0;
+        for (; i + 8 <= data.size(); i += 8) {
+            const std::uint32_t lo = crc ^ (std::uint32_t{data[i]} | std::uint32_t{data[i + 1]} << 8 | std::uint32_t{data[i + 2]} << 16 | std::uint32_t{data[i + 3]} << 24);
+            crc                    = t[7][lo & 0xffu] ^ t[6][(lo >> 8) & 0xffu] ^ t[5][(lo >> 16) & 0xffu] ^ t[4][lo >> 24] ^ t[3][data[i + 4]] ^ t[2][data[i + 5]] ^ t[1][data[i + 6]] ^ t[0][data[i + 7]];
+        }
+        for (; i < data.size(); ++i) crc = t[0][(crc ^ data[i]) & 0xffu] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // Sums stay below 2^32 for 5552 bytes between reductions.
+    std::uint32_t adler32(const std::span<const std::uint8_t> data) {
+        constexpr std::uint32_t mod = 65521;
+        std::uint32_t a             = 1;
+        std::uint32_t b             = 0;
+        for (std::size_t base = 0; base < data.size(); base += 5552) {
+            const std::size_t end = std::min(data.size(), base + 5552);
+            for (std::size_t i = base; i < end; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= mod;
+            b %= mod;
+        }
+        return b << 16 | a;
+    }
+
+    void put_u32_be(std::vector<std::uint8_t>& out, const std::uint32_t v) {
+        out.push_back(static_cast<std::uint8_t>(v >> 24));
+        out.push_back(static_cast<std::uint8_t>(v >> 16));
+        out.push_back(static_cast<std::uint8_t>(v >> 8));
+        out.push_back(static_cast<std::uint8_t>(v));
+    }
+
+    void put_chunk(std::vector<std::uint8_t>& out, const char (&type)[5], const std::span<const std::uint8_t> data) {
+        put_u32_be(out, static_cast<std::uint32_t>(data.size()));
+        const std::size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        put_u32_be(out, crc32(std::span{out}.subspan(start)));
+    }
+
+    // ========================================================================
+    // RGB rows, each led by the filter byte when filter_bytes is set.
+    // ========================================================================
+    std::vector<std::uint8_t> rgb_rows(const std::span<const std::byte> pixels, const vk::Extent2D extent, const bool bgra, const bool filter_bytes) {
+        const std::size_t row_bytes = std::size_t{3} * extent.width + (filter_bytes ? 1 : 0);
+        std::vector<std::uint8_t> out(row_bytes * extent.height);
+        const auto* src = reinterpret_cast<const std::uint8_t*>(pixels.data());
+        const int red   = bgra ? 2 : 0;
+        const int blue  = bgra ? 0 : 2;
+        for (std::uint32_t y = 0; y < extent.height; ++y) {
+            std::uint8_t* dst = out.data() + y * row_bytes;
+            if (filter_bytes) *dst++ = 0;
+            const std::uint8_t* row = src + std::size_t{bytes_per_pixel} * extent.width * y;
+            for (std::uint32_t x = 0; x < extent.width; ++x) {
+                dst[3 * x + 0] = row[4 * x + red];
+                dst[3 * x + 1] = row[4 * x + 1];
+                dst[3 * x + 2] = row[4 * x + blue];
+            }
+        }
+        return out;
+    }
+
+    void write_bytes(std::ofstream& out, const std::span<const std::uint8_t> bytes) {
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+} // namespace
+
+bool pngp::vis::rays::capture::supported_format(const vk::Format format) noexcept {
+    switch (format) {
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+    case vk::Format::eA8B8G8R8UnormPack32:
+    case vk::Format::eA8B8G8R8SrgbPack32: return true;
+    default: return false;
+    }
+}
+
+// ============================================================================
+// 8-bit RGB, one IDAT holding a zlib stream of stored blocks: no
+// compression, but no encoder state either, and every row keeps filter 0.
+// ============================================================================
+bool pngp::vis::rays::capture::write_png(const std::filesystem::path& path, const std::span<const std::byte> rgba, const vk::Extent2D extent, const bool bgra) {
+    if (extent.width == 0 || extent.height == 0 || rgba.size() < std::size_t{bytes_per_pixel} * extent.width * extent.height) return false;
+    const auto rows = rgb_rows(rgba, extent, bgra, true);
+
+    std::vector<std::uint8_t> header;
+    put_u32_be(header, extent.width);
+    put_u32_be(header, extent.height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+
+    std::vector<std::uint8_t> head{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    put_chunk(head, "IHDR", header);
+
+    // ========================================================================
+    // IDAT is streamed: the rows go to the file in place, framed by the
+    // block headers, and the chunk CRC chains over the pieces.
+    // ========================================================================
+    const std::size_t blocks = (rows.size() + stored_block_max - 1) / stored_block_max;
+    const auto idat_size     = static_cast<std::uint32_t>(2 + 5 * blocks + rows.size() + 4);
+    put_u32_be(head, idat_size);
+    const std::size_t crc_start = head.size();
+    head.insert(head.end(), {'I', 'D', 'A', 'T', 0x78, 0x01});
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    write_bytes(out, head);
+    std::uint32_t crc = crc32(std::span{head}.subspan(crc_start));
+
+    for (std::size_t base = 0; base < rows.size(); base += stored_block_max) {
+        const auto len  = static_cast<std::uint16_t>(std::min(stored_block_max, rows.size() - base));
+        const auto nlen = static_cast<std::uint16_t>(~len);
+        const std::array<std::uint8_t, 5> block_header{static_cast<std::uint8_t>(base + len == rows.size() ? 1 : 0), static_cast<std::uint8_t>(len), static_cast<std::uint8_t>(len >> 8), static_cast<std::uint8_t>(nlen), static_cast<std::uint8_t>(nlen >> 8)};
+        const auto block = std::span{rows}.subspan(base, len);
+        write_bytes(out, block_header);
+        write_bytes(out, block);
+        crc = crc32(block, crc32(block_header, crc));
+    }
+
+    std::vector<std::uint8_t> tail;
+    put_u32_be(tail, adler32(rows));
+    crc = crc32(tail, crc);
+    put_u32_be(tail, crc);
+    put_chunk(tail, "IEND", {});
+    write_bytes(out, tail);
+    return static_cast<bool>(out);
+}
+
+bool pngp::vis::rays::capture::write_ppm(const std::filesystem::path& path, const std::span<const std::byte> rgba, const vk::Extent2D extent, const bool bgra) {
+    if (rgba.size() < std::size_t{bytes_per_pixel} * extent.width * extent.height) return false;
+    const std::string header = std::format("P6\n{} {}\n255\n", extent.width, extent.height);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    write_bytes(out, rgb_rows(rgba, extent, bgra, false));
+    return static_cast<bool>(out);
+}
+
+// ============================================================================
+// CaptureRing: readback memory is host-cached when the device has it (CPU
+// reads of uncached memory are slow), invalidated before the writer reads.
+// ============================================================================
+pngp::vis::rays::capture::CaptureRing::CaptureRing(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const CaptureInfo& info)
+    : physical_device(&physical_device), device(&device), info(info) {
+    const auto cached = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+    const auto mem    = physical_device.getMemoryProperties();
+    bool has_cached   = false;
+    for (std::uint32_t i = 0; i < mem.memoryTypeCount; ++i) has_cached |= (mem.memoryTypes[i].propertyFlags & cached) == cached;
+
+    memory_props = has_cached ? cached : vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    coherent     = !has_cached;
+
+    slots.resize(info.frames_in_flight + info.writer_slack);
+    thread = std::jthread([this](const std::stop_token& stop) { writer(stop); });
+}
+
+pngp::vis::rays::capture::CaptureRing::~CaptureRing() {
+    thread.request_stop();
+    work_available.notify_all();
+}
+
+void pngp::vis::rays::capture::CaptureRing::request(const std::uint32_t frames, const ImageEncoding encoding) {
+    if (frames == 0) {
+        frames_left = 0;
+        return;
+    }
+    const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+    take_name      = std::format("capture_{:%Y%m%d_%H%M%S}_{}", now, takes++);
+    take_encoding  = encoding;
+    take_frame     = 0;
+    frames_left    = frames;
+}
+
+bool pngp::vis::rays::capture::CaptureRing::readback_pending() const {
+    std::lock_guard lock(mutex);
+    return std::ranges::any_of(slots, [](const Staging& s) { return s.state == SlotState::recorded; });
+}
+
+std::string pngp::vis::rays::capture::CaptureRing::status() const {
+    std::lock_guard lock(mutex);
+    return last_error;
+}
+
+// ============================================================================
+// A dropped frame still uses up its number, so gaps in a sequence show
+// where the writer fell behind.
+// ============================================================================
+bool pngp::vis::rays::capture::CaptureRing::record(const vk::raii::CommandBuffer& cmd, const std::uint32_t frame_index, const CaptureSource& source) {
+    if (frames_left == 0) return false;
+    --frames_left;
+    const std::uint32_t number = take_frame++;
+
+    if (!supported_format(source.format)) {
+        std::lock_guard lock(mutex);
+        last_error = std::format("cannot capture format {}", vk::to_string(source.format));
+        ++dropped;
+        return false;
+    }
+    if (!source.transfer_src) {
+        std::lock_guard lock(mutex);
+        last_error = "capture unsupported on this surface";
+        ++dropped;
+        return false;
+    }
+
+    Staging* slot = nullptr;
+    {
+        std::lock_guard lock(mutex);
+        const auto it = std::ranges::find_if(slots, [](const Staging& s) { return s.state == SlotState::free; });
+        if (it == slots.end()) {
+            ++dropped;
+            return false;
+        }
+        it->state = SlotState::recorded;
+        slot      = &*it;
+    }
+
+    // ========================================================================
+    // A free buffer has been read by the writer, so the GPU is done with it.
+    // ========================================================================
+    const vk::DeviceSize bytes = vk::DeviceSize{bytes_per_pixel} * source.extent.width * source.extent.height;
+    if (slot->buffer.size < bytes) slot->buffer = upload::create_buffer(*physical_device, *device, bytes, vk::BufferUsageFlagBits::eTransferDst, memory_props);
+
+    slot->frame_index = frame_index;
+    slot->extent      = source.extent;
+    slot->bgra        = source.format == vk::Format::eB8G8R8A8Unorm || source.format == vk::Format::eB8G8R8A8Srgb;
+    slot->encoding    = take_encoding;
+    slot->path        = info.directory / std::format("{}_{:05}.{}", take_name, number, take_encoding == ImageEncoding::png ? "png" : "ppm");
+
+    const vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+    {
+        const vk::ImageMemoryBarrier2 barrier{
+            .srcStageMask     = vk::PipelineStageFlagBits2::eAllCommands,
+            .srcAccessMask    = vk::AccessFlagBits2::eMemoryWrite,
+            .dstStageMask     = vk::PipelineStageFlagBits2::eCopy,
+            .dstAccessMask    = vk::AccessFlagBits2::eTransferRead,
+            .oldLayout        = source.layout,
+            .newLayout        = vk::ImageLayout::eTransferSrcOptimal,
+            .image            = source.image,
+            .subresourceRange = range,
+        };
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers    = &barrier,
+        });
+    }
+
+    const vk::BufferImageCopy region{
+        .bufferOffset     = 0,
+        .imageSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1},
+        .imageOffset      = {0, 0, 0},
+        .imageExtent      = {source.extent.width, source.extent.height, 1},
+    };
+    cmd.copyImageToBuffer(source.image, vk::ImageLayout::eTransferSrcOptimal, *slot->buffer.buffer, region);
+
+    // ========================================================================
+    // Back to the caller's layout, and the copy made visible to host reads
+    // (the fence alone does not do that).
+    // ========================================================================
+    {
+        const vk::ImageMemoryBarrier2 image_barrier{
+            .srcStageMask     = vk::PipelineStageFlagBits2::eCopy,
+            .dstStageMask     = vk::PipelineStageFlagBits2::eAllCommands,
+            .dstAccessMask    = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
+            .oldLayout        = vk::ImageLayout::eTransferSrcOptimal,
+            .newLayout        = source.layout,
+            .image            = source.image,
+            .subresourceRange = range,
+        };
+        const vk::BufferMemoryBarrier2 buffer_barrier{
+            .srcStageMask  = vk::PipelineStageFlagBits2::eCopy,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eHost,
+            .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+            .buffer        = *slot->buffer.buffer,
+            .offset        = 0,
+            .size          = VK_WHOLE_SIZE,
+        };
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .bufferMemoryBarrierCount = 1,
+            .pBufferMemoryBarriers    = &buffer_barrier,
+            .imageMemoryBarrierCount  = 1,
+            .pImageMemoryBarriers     = &image_barrier,
+        });
+    }
+
+    ++captured;
+    return true;
+}
+
+void pngp::vis::rays::capture::CaptureRing::begin_frame(const std::uint32_t frame_index) {
+    bool handed_off = false;
+    {
+        std::lock_guard lock(mutex);
+        for (std::uint32_t i = 0; i < slots.size(); ++i) {
+            Staging& s = slots[i];
+            if (s.state != SlotState::recorded || s.frame_index != frame_index) continue;
+            if (!coherent) device->invalidateMappedMemoryRanges(vk::MappedMemoryRange{.memory = *s.buffer.memory, .offset = 0, .size = VK_WHOLE_SIZE});
+            s.state = SlotState::writing;
+            queued.push_back(i);
+            handed_off = true;
+        }
+    }
+    if (handed_off) work_available.notify_one();
+}
+
+void pngp::vis::rays::capture::CaptureRing::shutdown() {
+    for (std::uint32_t f = 0; f < info.frames_in_flight; ++f) begin_frame(f);
+}
+
+// ============================================================================
+// Writer: encodes straight out of the mapped buffer, then frees it. On
+// stop it finishes what is queued first, so a take is never cut short.
+// ============================================================================
+void pngp::vis::rays::capture::CaptureRing::writer(const std::stop_token& stop) {
+    while (true) {
+        std::uint32_t index = 0;
+        {
+            std::unique_lock lock(mutex);
+            if (!work_available.wait(lock, stop, [this] { return !queued.empty(); })) return;
+            index = queued.front();
+            queued.pop_front();
+        }
+
+        const Staging& s  = slots[index];
+        const auto pixels = std::span{static_cast<const std::byte*>(s.buffer.mapped), std::size_t{bytes_per_pixel} * s.extent.width * s.extent.height};
+
+        std::error_code ec;
+        std::filesystem::create_directories(s.path.parent_path(), ec);
+        const bool ok = s.encoding == ImageEncoding::png ? write_png(s.path, pixels, s.extent, s.bgra) : write_ppm(s.path, pixels, s.extent, s.bgra);
+        if (ok) written.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard lock(mutex);
+        if (!ok) last_error = std::format("could not write {}", s.path.string());
+        slots[index].state = SlotState::free;
+    }
+}
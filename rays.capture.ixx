@@ -0,0 +1,150 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.capture;
+// ============================================================================
+// Frame capture: the color image is copied into a ring of host-visible
+// staging buffers inside the frame's own command buffer, read back once
+// the frame has completed on the GPU, and encoded to disk on a writer
+// thread. Nothing waits on the GPU; with no free staging buffer a capture
+// frame is dropped rather than stalling the render loop.
+// ============================================================================
+import pngp.vis.rays.upload;
+import std;
+
+namespace pngp::vis::rays::capture {
+    // ========================================================================
+    // PNG is deflate-stored (no compression library in the tree), so both
+    // formats cost about one pass over the pixels; raw is a binary PPM.
+    // ========================================================================
+    export enum class ImageEncoding : std::uint8_t { png, raw };
+
+    // ========================================================================
+    // 8-bit RGBA/BGRA image to copy from. It is in layout on entry and is
+    // returned to it, so the capture can sit between any two passes.
+    // transfer_src: the image has transfer-src usage (a surface need not
+    // offer it); without it nothing is copied.
+    // ========================================================================
+    export struct CaptureSource {
+        vk::Image image{};
+        vk::Format format = vk::Format::eUndefined;
+        vk::Extent2D extent{};
+        vk::ImageLayout layout = vk::ImageLayout::eColorAttachmentOptimal;
+        bool transfer_src      = true;
+    };
+
+    export struct CaptureInfo {
+        std::uint32_t frames_in_flight = 2;
+        // Staging buffers beyond frames_in_flight let the writer fall behind
+        // this many frames before captures are dropped.
+        std::uint32_t writer_slack      = 2;
+        std::filesystem::path directory = "captures";
+    };
+
+    // Formats record() can read back (4 bytes per pixel, 8-bit channels).
+    export [[nodiscard]] bool supported_format(vk::Format format) noexcept;
+
+    // ========================================================================
+    // Pixel readback encoders, also usable on their own. rgba is tightly
+    // packed; alpha is dropped.
+    // ========================================================================
+    export bool write_png(const std::filesystem::path& path, std::span<const std::byte> rgba, vk::Extent2D extent, bool bgra);
+    export bool write_ppm(const std::filesystem::path& path, std::span<const std::byte> rgba, vk::Extent2D extent, bool bgra);
+
+    export class CaptureRing {
+    public:
+        // ====================================================================
+        // Capture the next frames (1 = screenshot) into one numbered take.
+        // A request while a take is running starts a new take; 0 stops.
+        // ====================================================================
+        void request(std::uint32_t frames, ImageEncoding encoding);
+        // ====================================================================
+        // Frame slot's last frame is done: its copies are final, hand them
+        // to the writer.
+        // ====================================================================
+        void begin_frame(std::uint32_t frame_index);
+        // ====================================================================
+        // Outside rendering: copy source into a free staging buffer when a
+        // take wants this frame. Returns false when the frame was not
+        // captured (nothing requested, no free buffer, unsupported source).
+        // ====================================================================
+        bool record(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index, const CaptureSource& source);
+        // ====================================================================
+        // Device must be idle: every recorded copy is final, hand them all
+        // to the writer (it drains its queue before the ring goes away).
+        // ====================================================================
+        void shutdown();
+
+        // A take still wants frames.
+        [[nodiscard]] bool capturing() const noexcept {
+            return frames_left > 0;
+        }
+        // Copies recorded but not yet handed to the writer; the loop has to
+        // keep cycling frame slots until they are.
+        [[nodiscard]] bool readback_pending() const;
+        [[nodiscard]] std::uint64_t frames_captured() const noexcept {
+            return captured;
+        }
+        [[nodiscard]] std::uint64_t frames_dropped() const noexcept {
+            return dropped;
+        }
+        [[nodiscard]] std::uint64_t frames_written() const noexcept {
+            return written.load(std::memory_order_relaxed);
+        }
+        // Last failure (unsupported source, file write), empty if none.
+        [[nodiscard]] std::string status() const;
+
+        CaptureRing(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const CaptureInfo& info);
+        ~CaptureRing();
+        CaptureRing(const CaptureRing&)            = delete;
+        CaptureRing& operator=(const CaptureRing&) = delete;
+        CaptureRing(CaptureRing&&)                 = delete;
+        CaptureRing& operator=(CaptureRing&&)      = delete;
+
+    private:
+        enum class SlotState : std::uint8_t { free, recorded, writing };
+
+        // ====================================================================
+        // One staging buffer. state is guarded by mutex; the rest belongs to
+        // whichever side owns the buffer in that state.
+        // ====================================================================
+        struct Staging {
+            upload::GpuBuffer buffer;
+            SlotState state           = SlotState::free;
+            std::uint32_t frame_index = 0;
+            vk::Extent2D extent{};
+            bool bgra              = false;
+            ImageEncoding encoding = ImageEncoding::png;
+            std::filesystem::path path;
+        };
+
+        void writer(const std::stop_token& stop);
+
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        const vk::raii::Device* device                  = nullptr;
+        CaptureInfo info{};
+        vk::MemoryPropertyFlags memory_props{};
+        bool coherent = true;
+        // ====================================================================
+        // Main thread: the running take.
+        // ====================================================================
+        std::uint32_t frames_left = 0;
+        std::uint32_t take_frame  = 0;
+        std::uint32_t takes       = 0;
+        std::string take_name;
+        ImageEncoding take_encoding = ImageEncoding::png;
+        std::uint64_t captured      = 0;
+        std::uint64_t dropped       = 0;
+        // ====================================================================
+        // Hand-off (guarded by mutex): slot states and the writer queue.
+        // ====================================================================
+        mutable std::mutex mutex;
+        std::condition_variable_any work_available;
+        std::vector<Staging> slots;
+        std::deque<std::uint32_t> queued;
+        std::string last_error;
+        std::atomic<std::uint64_t> written{0};
+
+        // Declared last so the writer stops before the buffers go.
+        std::jthread thread;
+    };
+} // namespace pngp::vis::rays::capture
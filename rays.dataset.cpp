@@ -0,0 +1,599 @@
+module;
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+module pngp.vis.rays.dataset;
+// ============================================================================
+// Ray dump loader implementation.
+// ============================================================================
+import std;
+import pngp.vis.rays.jobs;
+
+// ============================================================================
+// Translation-unit helpers (column sizes, alignment, page ranges).
+// ============================================================================
+namespace {
+    using pngp::vis::rays::dataset::Column;
+
+    constexpr std::uint64_t column_element_bytes(const Column c) {
+        switch (c) {
+            case Column::Color:
+            case Column::Pixel:
+            case Column::CameraId: return sizeof(std::uint32_t);
+            default: return sizeof(float);
+        }
+    }
+
+    constexpr std::uint64_t align_up(const std::uint64_t v, const std::uint64_t a) {
+        return (v + a - 1) / a * a;
+    }
+
+    // Written as a subtraction so a crafted offset cannot wrap past the end.
+    constexpr bool range_fits(const std::uint64_t offset, const std::uint64_t length, const std::uint64_t size) {
+        return offset <= size && length <= size - offset;
+    }
+
+    // =========================================================================
+    // Page-align a byte range so OS hints never touch neighbouring data.
+    // =========================================================================
+    std::pair<std::uint64_t, std::uint64_t> page_range(const std::uint64_t offset, const std::uint64_t size, const std::uint64_t mapped) {
+#if defined(_WIN32)
+        SYSTEM_INFO si{};
+        GetSystemInfo(&si);
+        const std::uint64_t page = si.dwPageSize;
+#else
+        const std::uint64_t page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+        const std::uint64_t first = align_up(offset, page);
+        const std::uint64_t last  = std::min(mapped, (offset + size) / page * page);
+        if (last <= first) return {0, 0};
+        return {first, last - first};
+    }
+
+    template <typename T>
+    std::span<const T> column_span(const std::byte* block, const pngp::vis::rays::dataset::ColumnLayout& layout, const Column c, const std::uint32_t count) {
+        return {reinterpret_cast<const T*>(block + layout.offsets[static_cast<std::size_t>(c)]), count};
+    }
+
+    // Round [0, 1] to 16 bits.
+    std::uint32_t unorm16(const float v) {
+        return static_cast<std::uint32_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    // Round [-1, 1] to a two's complement 16-bit pattern.
+    std::uint32_t snorm16(const float v) {
+        return static_cast<std::uint32_t>(static_cast<std::uint16_t>(static_cast<std::int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f))));
+    }
+
+    float from_unorm16(const std::uint32_t bits) {
+        return static_cast<float>(bits & 0xffffu) / 65535.0f;
+    }
+
+    float from_snorm16(const std::uint32_t bits) {
+        return std::max(static_cast<float>(static_cast<std::int16_t>(bits & 0xffffu)) / 32767.0f, -1.0f);
+    }
+
+    // =========================================================================
+    // Octahedral map of a unit vector onto [-1, 1]^2; the lower hemisphere
+    // folds over the diagonals.
+    // =========================================================================
+    std::array<float, 2> octahedral(const std::array<float, 3>& d) {
+        const float l1 = std::abs(d[0]) + std::abs(d[1]) + std::abs(d[2]);
+        if (!(l1 > 0.0f)) return {0.0f, 0.0f};
+        const float x = d[0] / l1;
+        const float y = d[1] / l1;
+        if (d[2] >= 0.0f) return {x, y};
+        return {(1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f)};
+    }
+
+    std::array<float, 3> octahedral_decode(const std::array<float, 2>& e) {
+        std::array v{e[0], e[1], 1.0f - std::abs(e[0]) - std::abs(e[1])};
+        const float t = std::clamp(-v[2], 0.0f, 1.0f);
+        v[0] += v[0] >= 0.0f ? -t : t;
+        v[1] += v[1] >= 0.0f ? -t : t;
+        const float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        return {v[0] / len, v[1] / len, v[2] / len};
+    }
+
+    // =========================================================================
+    // Spread 10 bits so that two zero bits sit between each (Morton 3D).
+    // =========================================================================
+    std::uint32_t spread_bits(std::uint32_t v) {
+        v = (v | (v << 16)) & 0x030000ffu;
+        v = (v | (v << 8)) & 0x0300f00fu;
+        v = (v | (v << 4)) & 0x030c30c3u;
+        v = (v | (v << 2)) & 0x09249249u;
+        return v;
+    }
+
+    // Low `bits` bits of v in reverse order.
+    std::uint32_t reverse_bits(std::uint32_t v, const int bits) {
+        std::uint32_t r = 0;
+        for (int b = 0; b < bits; ++b, v >>= 1) r = (r << 1) | (v & 1u);
+        return r;
+    }
+
+    // =========================================================================
+    // Level-of-detail ray order. Rays are sorted along a Morton curve over the
+    // chunk bounds (segment midpoints), then visited in bit-reversed rank
+    // order: any prefix of the result is an evenly strided sample of the
+    // curve, i.e. roughly one ray per occupied octree cell at the depth the
+    // prefix length affords. The renderer draws a prefix sized to the
+    // chunk's projected screen area.
+    // =========================================================================
+    std::vector<std::uint32_t> stratified_order(const pngp::vis::rays::dataset::ChunkView& view) {
+        const std::uint32_t n = view.record->ray_count;
+        std::vector<std::uint32_t> order(n);
+        if (n < 2) {
+            std::iota(order.begin(), order.end(), 0u);
+            return order;
+        }
+
+        const auto& lo = view.record->bounds_min;
+        const auto& hi = view.record->bounds_max;
+        std::array<float, 3> scale{};
+        for (int axis = 0; axis < 3; ++axis) scale[axis] = hi[axis] > lo[axis] ? 1023.0f / (hi[axis] - lo[axis]) : 0.0f;
+
+        auto cell = [&](const int axis, const float v) { return static_cast<std::uint32_t>(std::clamp((v - lo[axis]) * scale[axis], 0.0f, 1023.0f)); };
+
+        // (morton << 32 | ray) sorts by cell and keeps ties in file order.
+        std::vector<std::uint64_t> keyed(n);
+        for (std::uint32_t i = 0; i < n; ++i) {
+            const float tm = 0.5f * (view.t_min[i] + view.t_max[i]);
+            const auto x   = cell(0, view.origin_x[i] + view.dir_x[i] * tm);
+            const auto y   = cell(1, view.origin_y[i] + view.dir_y[i] * tm);
+            const auto z   = cell(2, view.origin_z[i] + view.dir_z[i] * tm);
+            keyed[i]       = static_cast<std::uint64_t>(spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2)) << 32 | i;
+        }
+        std::ranges::sort(keyed);
+
+        const int bits        = std::bit_width(n - 1);
+        std::uint32_t written = 0;
+        for (std::uint32_t r = 0; written < n; ++r) {
+            const std::uint32_t rank = reverse_bits(r, bits);
+            if (rank < n) order[written++] = static_cast<std::uint32_t>(keyed[rank]);
+        }
+        return order;
+    }
+
+    // =========================================================================
+    // Encode a chunk into GPU records: one segment per ray over
+    // [t_min, t_max], in the given (level-of-detail) order.
+    // =========================================================================
+    std::vector<pngp::vis::rays::dataset::RayRecord> build_chunk_records(const pngp::vis::rays::dataset::ChunkView& view, const std::span<const std::uint32_t> order) {
+        std::vector<pngp::vis::rays::dataset::RayRecord> records;
+        records.reserve(order.size());
+
+        for (const std::uint32_t i : order) {
+            const float ox = view.origin_x[i];
+            const float oy = view.origin_y[i];
+            const float oz = view.origin_z[i];
+            const float dx = view.dir_x[i];
+            const float dy = view.dir_y[i];
+            const float dz = view.dir_z[i];
+            const float t0 = view.t_min[i];
+            const float t1 = view.t_max[i];
+
+            records.push_back(pngp::vis::rays::dataset::encode_ray({ox + dx * t0, oy + dy * t0, oz + dz * t0}, {ox + dx * t1, oy + dy * t1, oz + dz * t1}, view.color[i], *view.record));
+        }
+        return records;
+    }
+} // namespace
+
+// ============================================================================
+// Column layout: fixed column order, each column 16-byte aligned.
+// ============================================================================
+pngp::vis::rays::dataset::ColumnLayout pngp::vis::rays::dataset::column_layout(const std::uint32_t columns, const std::uint32_t ray_count) {
+    ColumnLayout layout{};
+    std::uint64_t cursor = 0;
+    for (std::uint32_t c = 0; c < static_cast<std::uint32_t>(Column::Count); ++c) {
+        const auto col = static_cast<Column>(c);
+        if ((columns & column_bit(col)) == 0) continue;
+        cursor            = align_up(cursor, column_alignment);
+        layout.offsets[c] = cursor;
+        cursor += column_element_bytes(col) * ray_count;
+    }
+    layout.block_bytes = align_up(cursor, column_alignment);
+    return layout;
+}
+
+// ============================================================================
+// Ray record: quantize against the chunk bounds; ray_segments.slang inverts
+// this with the same bounds from the pool's chunk info.
+// ============================================================================
+pngp::vis::rays::dataset::RayRecord pngp::vis::rays::dataset::encode_ray(const std::array<float, 3>& start, const std::array<float, 3>& end, const std::uint32_t color, const ChunkRecord& chunk) {
+    std::array<float, 3> q{};
+    std::array<float, 3> seg{};
+    float diagonal2 = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+        const float extent = chunk.bounds_max[a] - chunk.bounds_min[a];
+        q[a]               = extent > 0.0f ? (start[a] - chunk.bounds_min[a]) / extent : 0.0f;
+        seg[a]             = end[a] - start[a];
+        diagonal2 += extent * extent;
+    }
+    const float length   = std::sqrt(seg[0] * seg[0] + seg[1] * seg[1] + seg[2] * seg[2]);
+    const float diagonal = std::sqrt(diagonal2);
+
+    const std::array<float, 3> dir = length > 0.0f ? std::array{seg[0] / length, seg[1] / length, seg[2] / length} : std::array{0.0f, 0.0f, 1.0f};
+    const auto oct                 = octahedral(dir);
+
+    RayRecord r{};
+    r.start_xy       = unorm16(q[0]) | unorm16(q[1]) << 16;
+    r.start_z_length = unorm16(q[2]) | unorm16(diagonal > 0.0f ? length / diagonal : 0.0f) << 16;
+    r.direction      = snorm16(oct[0]) | snorm16(oct[1]) << 16;
+    r.color          = color;
+    return r;
+}
+
+pngp::vis::rays::dataset::DecodedRay pngp::vis::rays::dataset::decode_ray(const RayRecord& record, const ChunkRecord& chunk) {
+    const std::array q{from_unorm16(record.start_xy), from_unorm16(record.start_xy >> 16), from_unorm16(record.start_z_length)};
+    const auto dir = octahedral_decode({from_snorm16(record.direction), from_snorm16(record.direction >> 16)});
+
+    DecodedRay out{};
+    float diagonal2 = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+        const float extent = chunk.bounds_max[a] - chunk.bounds_min[a];
+        out.start[a]       = chunk.bounds_min[a] + q[a] * extent;
+        diagonal2 += extent * extent;
+    }
+    const float length = from_unorm16(record.start_z_length >> 16) * std::sqrt(diagonal2);
+    for (int a = 0; a < 3; ++a) out.end[a] = out.start[a] + dir[a] * length;
+    out.color = record.color;
+    return out;
+}
+
+// ============================================================================
+// MappedFile: read-only mapping of the entire file.
+// ============================================================================
+pngp::vis::rays::dataset::MappedFile::MappedFile(const std::filesystem::path& path) {
+#if defined(_WIN32)
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) throw std::runtime_error(std::format("cannot open ray file: {}", path.string()));
+    file = reinterpret_cast<std::intptr_t>(h);
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(h, &size)) {
+        close();
+        throw std::runtime_error(std::format("cannot stat ray file: {}", path.string()));
+    }
+    length = static_cast<std::uint64_t>(size.QuadPart);
+    if (length == 0) {
+        close();
+        throw std::runtime_error(std::format("ray file is empty: {}", path.string()));
+    }
+
+    mapping = CreateFileMappingW(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        throw std::runtime_error(std::format("cannot map ray file: {}", path.string()));
+    }
+    base = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error(std::format("cannot open ray file: {}", path.string()));
+    file = fd;
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        close();
+        throw std::runtime_error(std::format("cannot stat ray file: {}", path.string()));
+    }
+    length = static_cast<std::uint64_t>(st.st_size);
+    if (length == 0) {
+        close();
+        throw std::runtime_error(std::format("ray file is empty: {}", path.string()));
+    }
+
+    void* p = ::mmap(nullptr, static_cast<std::size_t>(length), PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) base = static_cast<const std::byte*>(p);
+#endif
+    if (!base) {
+        close();
+        throw std::runtime_error(std::format("cannot map ray file: {}", path.string()));
+    }
+}
+
+pngp::vis::rays::dataset::MappedFile::~MappedFile() {
+    close();
+}
+
+pngp::vis::rays::dataset::MappedFile::MappedFile(MappedFile&& other) noexcept
+    : base(std::exchange(other.base, nullptr)), length(std::exchange(other.length, 0)), file(std::exchange(other.file, -1)), mapping(std::exchange(other.mapping, nullptr)) {}
+
+pngp::vis::rays::dataset::MappedFile& pngp::vis::rays::dataset::MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        base    = std::exchange(other.base, nullptr);
+        length  = std::exchange(other.length, 0);
+        file    = std::exchange(other.file, -1);
+        mapping = std::exchange(other.mapping, nullptr);
+    }
+    return *this;
+}
+
+void pngp::vis::rays::dataset::MappedFile::close() noexcept {
+#if defined(_WIN32)
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle(mapping);
+    if (file != -1) CloseHandle(reinterpret_cast<HANDLE>(file));
+#else
+    if (base) ::munmap(const_cast<std::byte*>(base), static_cast<std::size_t>(length));
+    if (file != -1) ::close(static_cast<int>(file));
+#endif
+    base    = nullptr;
+    length  = 0;
+    file    = -1;
+    mapping = nullptr;
+}
+
+void pngp::vis::rays::dataset::MappedFile::advise_sequential(const std::uint64_t offset, const std::uint64_t size) const noexcept {
+    const auto [first, bytes] = page_range(offset, size, length);
+    if (bytes == 0) return;
+#if defined(_WIN32)
+    WIN32_MEMORY_RANGE_ENTRY range{const_cast<std::byte*>(base + first), static_cast<SIZE_T>(bytes)};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    ::madvise(const_cast<std::byte*>(base + first), static_cast<std::size_t>(bytes), MADV_SEQUENTIAL);
+    ::madvise(const_cast<std::byte*>(base + first), static_cast<std::size_t>(bytes), MADV_WILLNEED);
+#endif
+}
+
+void pngp::vis::rays::dataset::MappedFile::release(const std::uint64_t offset, const std::uint64_t size) const noexcept {
+    const auto [first, bytes] = page_range(offset, size, length);
+    if (bytes == 0) return;
+#if defined(_WIN32)
+    // Unlocking pages that were never locked trims them from the working set.
+    VirtualUnlock(const_cast<std::byte*>(base + first), static_cast<SIZE_T>(bytes));
+#else
+    ::madvise(const_cast<std::byte*>(base + first), static_cast<std::size_t>(bytes), MADV_DONTNEED);
+#endif
+}
+
+// ============================================================================
+// RayFile: validate header and chunk index against the mapped size.
+// ============================================================================
+pngp::vis::rays::dataset::RayFile::RayFile(const std::filesystem::path& path) : map(path) {
+    const auto bytes = map.bytes();
+    if (bytes.size() < sizeof(FileHeader)) throw std::runtime_error("ray file: truncated header");
+
+    head = reinterpret_cast<const FileHeader*>(bytes.data());
+    if (head->magic != file_magic) throw std::runtime_error("ray file: bad magic");
+    if (head->version != file_version) throw std::runtime_error(std::format("ray file: unsupported version {}", head->version));
+    if ((head->columns & required_columns) != required_columns) throw std::runtime_error("ray file: missing required columns");
+    if ((head->columns & ~(required_columns | optional_columns)) != 0) throw std::runtime_error("ray file: unknown columns");
+
+    const std::uint64_t index_bytes = static_cast<std::uint64_t>(head->chunk_count) * sizeof(ChunkRecord);
+    if (head->index_offset % alignof(ChunkRecord) != 0 || !range_fits(head->index_offset, index_bytes, bytes.size())) throw std::runtime_error("ray file: chunk index out of range");
+    index = {reinterpret_cast<const ChunkRecord*>(bytes.data() + head->index_offset), head->chunk_count};
+
+    std::uint64_t total = 0;
+    for (const ChunkRecord& rec : index) {
+        if (rec.ray_count > head->chunk_capacity) throw std::runtime_error("ray file: chunk exceeds capacity");
+        const auto layout = column_layout(head->columns, rec.ray_count);
+        if (rec.data_offset % column_alignment != 0 || !range_fits(rec.data_offset, layout.block_bytes, bytes.size())) throw std::runtime_error("ray file: chunk block out of range");
+        total += rec.ray_count;
+    }
+    if (total != head->ray_count) throw std::runtime_error("ray file: ray count mismatch");
+}
+
+pngp::vis::rays::dataset::ChunkView pngp::vis::rays::dataset::RayFile::chunk(const std::uint32_t chunk_index) const {
+    const ChunkRecord& rec = index[chunk_index];
+    const auto layout      = column_layout(head->columns, rec.ray_count);
+    const std::byte* block = map.bytes().data() + rec.data_offset;
+
+    ChunkView view{};
+    view.index    = chunk_index;
+    view.record   = &rec;
+    view.origin_x = column_span<float>(block, layout, Column::OriginX, rec.ray_count);
+    view.origin_y = column_span<float>(block, layout, Column::OriginY, rec.ray_count);
+    view.origin_z = column_span<float>(block, layout, Column::OriginZ, rec.ray_count);
+    view.dir_x    = column_span<float>(block, layout, Column::DirX, rec.ray_count);
+    view.dir_y    = column_span<float>(block, layout, Column::DirY, rec.ray_count);
+    view.dir_z    = column_span<float>(block, layout, Column::DirZ, rec.ray_count);
+    view.color    = column_span<std::uint32_t>(block, layout, Column::Color, rec.ray_count);
+    view.t_min    = column_span<float>(block, layout, Column::TMin, rec.ray_count);
+    view.t_max    = column_span<float>(block, layout, Column::TMax, rec.ray_count);
+    if (head->columns & column_bit(Column::Pixel)) view.pixel = column_span<std::uint32_t>(block, layout, Column::Pixel, rec.ray_count);
+    if (head->columns & column_bit(Column::CameraId)) view.camera_id = column_span<std::uint32_t>(block, layout, Column::CameraId, rec.ray_count);
+    return view;
+}
+
+void pngp::vis::rays::dataset::RayFile::prefetch_chunk(const std::uint32_t chunk_index) const noexcept {
+    const ChunkRecord& rec = index[chunk_index];
+    map.advise_sequential(rec.data_offset, column_layout(head->columns, rec.ray_count).block_bytes);
+}
+
+void pngp::vis::rays::dataset::RayFile::release_chunk(const std::uint32_t chunk_index) const noexcept {
+    const ChunkRecord& rec = index[chunk_index];
+    map.release(rec.data_offset, column_layout(head->columns, rec.ray_count).block_bytes);
+}
+
+// ============================================================================
+// Writer: header, chunk blocks, then the chunk index at the end.
+// ============================================================================
+void pngp::vis::rays::dataset::write_ray_file(const std::filesystem::path& path, const std::span<const Ray> rays, const std::uint32_t chunk_capacity, const std::uint32_t columns) {
+    if (chunk_capacity == 0) throw std::invalid_argument("write_ray_file: chunk_capacity must be > 0");
+    if ((columns & required_columns) != required_columns || (columns & ~(required_columns | optional_columns)) != 0) throw std::invalid_argument("write_ray_file: bad column mask");
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error(std::format("cannot create ray file: {}", path.string()));
+
+    FileHeader header{};
+    header.columns        = columns;
+    header.ray_count      = rays.size();
+    header.chunk_count    = static_cast<std::uint32_t>((rays.size() + chunk_capacity - 1) / chunk_capacity);
+    header.chunk_capacity = chunk_capacity;
+    header.bounds_min     = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    header.bounds_max     = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+    std::vector<ChunkRecord> records(header.chunk_count);
+    std::vector<std::byte> block;
+    std::uint64_t cursor = align_up(sizeof(FileHeader), column_alignment);
+
+    auto write_at = [&out](const std::uint64_t offset, const void* data, const std::uint64_t size) {
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    };
+
+    for (std::uint32_t c = 0; c < header.chunk_count; ++c) {
+        const std::size_t first = static_cast<std::size_t>(c) * chunk_capacity;
+        const auto count        = static_cast<std::uint32_t>(std::min<std::size_t>(chunk_capacity, rays.size() - first));
+        const auto layout       = column_layout(header.columns, count);
+        const auto chunk_rays   = rays.subspan(first, count);
+
+        ChunkRecord& rec = records[c];
+        rec.first_ray    = first;
+        rec.data_offset  = cursor;
+        rec.ray_count    = count;
+        rec.bounds_min   = header.bounds_max;
+        rec.bounds_max   = header.bounds_min;
+
+        block.assign(static_cast<std::size_t>(layout.block_bytes), std::byte{0});
+        auto put = [&](const Column col, const std::uint32_t i, const auto value) {
+            std::memcpy(block.data() + layout.offsets[static_cast<std::size_t>(col)] + column_element_bytes(col) * i, &value, sizeof(value));
+        };
+
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const Ray& r = chunk_rays[i];
+            put(Column::OriginX, i, r.origin[0]);
+            put(Column::OriginY, i, r.origin[1]);
+            put(Column::OriginZ, i, r.origin[2]);
+            put(Column::DirX, i, r.direction[0]);
+            put(Column::DirY, i, r.direction[1]);
+            put(Column::DirZ, i, r.direction[2]);
+            put(Column::Color, i, r.color);
+            put(Column::TMin, i, r.t_min);
+            put(Column::TMax, i, r.t_max);
+            if (columns & column_bit(Column::Pixel)) put(Column::Pixel, i, r.pixel);
+            if (columns & column_bit(Column::CameraId)) put(Column::CameraId, i, r.camera_id);
+
+            // Chunk bounds cover the drawn segment, not just the origin.
+            for (int axis = 0; axis < 3; ++axis) {
+                const float a        = r.origin[axis] + r.direction[axis] * r.t_min;
+                const float b        = r.origin[axis] + r.direction[axis] * r.t_max;
+                rec.bounds_min[axis] = std::min({rec.bounds_min[axis], a, b});
+                rec.bounds_max[axis] = std::max({rec.bounds_max[axis], a, b});
+            }
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            header.bounds_min[axis] = std::min(header.bounds_min[axis], rec.bounds_min[axis]);
+            header.bounds_max[axis] = std::max(header.bounds_max[axis], rec.bounds_max[axis]);
+        }
+
+        write_at(cursor, block.data(), block.size());
+        cursor += layout.block_bytes;
+    }
+
+    header.index_offset = align_up(cursor, column_alignment);
+    if (!records.empty()) write_at(header.index_offset, records.data(), records.size() * sizeof(ChunkRecord));
+    write_at(0, &header, sizeof(header));
+    if (!out) throw std::runtime_error(std::format("failed writing ray file: {}", path.string()));
+}
+
+// ============================================================================
+// ChunkStreamer: one feeder thread fanning decode batches out to a pool and
+// filling a bounded ready queue.
+// ============================================================================
+pngp::vis::rays::dataset::ChunkStreamer::ChunkStreamer(std::shared_ptr<const RayFile> file, std::shared_ptr<jobs::ThreadPool> workers, const StreamerConfig& config) : file(std::move(file)), config(config), decoders(std::move(workers)) {
+    if (!decoders) throw std::invalid_argument("ChunkStreamer: worker pool required");
+    this->config.max_ready_chunks = std::max(1u, this->config.max_ready_chunks);
+    scheduled                     = this->file->header().chunk_count;
+    thread                        = std::jthread([this](const std::stop_token& stop) { worker(stop); });
+}
+
+pngp::vis::rays::dataset::ChunkStreamer::~ChunkStreamer() {
+    thread.request_stop();
+    space_available.notify_all();
+}
+
+std::optional<pngp::vis::rays::dataset::StreamedChunk> pngp::vis::rays::dataset::ChunkStreamer::try_pop() {
+    std::optional<StreamedChunk> out;
+    {
+        std::lock_guard lock(mutex);
+        if (ready.empty()) return std::nullopt;
+        out.emplace(std::move(ready.front()));
+        ready.pop_front();
+    }
+    delivered.fetch_add(1, std::memory_order_relaxed);
+    space_available.notify_one();
+    return out;
+}
+
+void pngp::vis::rays::dataset::ChunkStreamer::request(const std::uint32_t chunk_index) {
+    if (chunk_index >= file->header().chunk_count) throw std::out_of_range("ChunkStreamer: chunk index out of range");
+    {
+        std::lock_guard lock(mutex);
+        requested.push_back(chunk_index);
+        scheduled.fetch_add(1, std::memory_order_relaxed);
+    }
+    space_available.notify_one();
+}
+
+bool pngp::vis::rays::dataset::ChunkStreamer::finished() const noexcept {
+    return chunks_delivered() >= scheduled.load(std::memory_order_relaxed);
+}
+
+// ============================================================================
+// One pass over the file in order, with requested chunks jumping the
+// queue; after the pass the worker keeps serving requests until stopped.
+// ============================================================================
+void pngp::vis::rays::dataset::ChunkStreamer::worker(const std::stop_token& stop) {
+    const std::uint32_t count = file->header().chunk_count;
+    const std::uint32_t width = decoders->thread_count() + 1;
+    std::vector<bool> served(count, false);
+    std::uint32_t next = 0;
+    while (!stop.stop_requested()) {
+        std::vector<std::uint32_t> batch;
+        {
+            // Back-pressure: wait until the consumer has drained a slot and
+            // there is work, then take as many chunks as the queue has room
+            // for.
+            std::unique_lock lock(mutex);
+            if (!space_available.wait(lock, stop, [&] { return ready.size() < config.max_ready_chunks && (next < count || !requested.empty()); })) return;
+            const std::size_t room = std::min<std::size_t>(config.max_ready_chunks - ready.size(), width);
+            while (batch.size() < room && !requested.empty()) {
+                served[requested.front()] = true;
+                batch.push_back(requested.front());
+                requested.pop_front();
+            }
+            while (batch.size() < room && next < count) {
+                if (served[next]) {
+                    scheduled.fetch_sub(1, std::memory_order_relaxed);
+                } else {
+                    batch.push_back(next);
+                }
+                ++next;
+            }
+        }
+        if (batch.empty()) continue;
+
+        // Prefetch this batch and the first block of the next one.
+        for (const std::uint32_t c : batch) file->prefetch_chunk(c);
+        if (next < count) file->prefetch_chunk(next);
+
+        std::vector<StreamedChunk> decoded(batch.size());
+        decoders->parallel_for(static_cast<std::uint32_t>(batch.size()), [&](const std::uint32_t i) {
+            const ChunkView view = file->chunk(batch[i]);
+            decoded[i].index     = batch[i];
+            decoded[i].ray_count = view.record->ray_count;
+            decoded[i].order     = stratified_order(view);
+            decoded[i].records   = build_chunk_records(view, decoded[i].order);
+            file->release_chunk(batch[i]);
+        });
+
+        std::lock_guard lock(mutex);
+        for (auto& chunk : decoded) ready.push_back(std::move(chunk));
+    }
+}
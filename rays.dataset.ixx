@@ -0,0 +1,265 @@
+export module pngp.vis.rays.dataset;
+// ============================================================================
+// Ray dump file format + memory-mapped streaming loader.
+// ============================================================================
+import pngp.vis.rays.jobs;
+import std;
+
+namespace pngp::vis::rays::dataset {
+    // ========================================================================
+    // On-disk layout (little endian, offsets are absolute file offsets):
+    //   FileHeader
+    //   ChunkRecord[chunk_count]          at header.index_offset
+    //   per chunk: one SoA block          at record.data_offset
+    // A chunk block stores every enabled column back to back, each column
+    // holding record.ray_count elements and starting on a 16-byte boundary.
+    // ========================================================================
+    export inline constexpr std::array<char, 8> file_magic{'P', 'N', 'G', 'P', 'R', 'A', 'Y', 'S'};
+    export inline constexpr std::uint32_t file_version     = 1;
+    export inline constexpr std::uint64_t column_alignment = 16;
+
+    export enum class Column : std::uint32_t {
+        OriginX,
+        OriginY,
+        OriginZ,
+        DirX,
+        DirY,
+        DirZ,
+        Color,
+        TMin,
+        TMax,
+        // Optional: source pixel packed as x | y << 16.
+        Pixel,
+        // Optional: index of the camera that traced the ray.
+        CameraId,
+        Count,
+    };
+
+    export constexpr std::uint32_t column_bit(const Column c) {
+        return 1u << static_cast<std::uint32_t>(c);
+    }
+
+    // Columns every file must carry; optional columns extend this mask.
+    export inline constexpr std::uint32_t required_columns = column_bit(Column::OriginX) | column_bit(Column::OriginY) | column_bit(Column::OriginZ) | column_bit(Column::DirX) | column_bit(Column::DirY) | column_bit(Column::DirZ) | column_bit(Column::Color) | column_bit(Column::TMin) | column_bit(Column::TMax);
+    export inline constexpr std::uint32_t optional_columns = column_bit(Column::Pixel) | column_bit(Column::CameraId);
+
+    export struct FileHeader {
+        std::array<char, 8> magic    = file_magic;
+        std::uint32_t version        = file_version;
+        std::uint32_t columns        = required_columns;
+        std::uint64_t ray_count      = 0;
+        std::uint32_t chunk_count    = 0;
+        std::uint32_t chunk_capacity = 0;
+        std::uint64_t index_offset   = 0;
+        std::array<float, 3> bounds_min{};
+        std::array<float, 3> bounds_max{};
+    };
+    static_assert(sizeof(FileHeader) == 64);
+
+    export struct ChunkRecord {
+        std::uint64_t first_ray   = 0;
+        std::uint64_t data_offset = 0;
+        std::uint32_t ray_count   = 0;
+        std::uint32_t reserved    = 0;
+        std::array<float, 3> bounds_min{};
+        std::array<float, 3> bounds_max{};
+    };
+    static_assert(sizeof(ChunkRecord) == 48);
+
+    // ========================================================================
+    // Byte offsets of each column inside a chunk block (0 for absent columns).
+    // ========================================================================
+    export struct ColumnLayout {
+        std::array<std::uint64_t, static_cast<std::size_t>(Column::Count)> offsets{};
+        std::uint64_t block_bytes = 0;
+    };
+
+    export ColumnLayout column_layout(std::uint32_t columns, std::uint32_t ray_count);
+
+    // ========================================================================
+    // Zero-copy view of one chunk; spans point straight into the mapping.
+    // Optional columns the file lacks are empty spans.
+    // ========================================================================
+    export struct ChunkView {
+        std::uint32_t index       = 0;
+        const ChunkRecord* record = nullptr;
+
+        std::span<const float> origin_x;
+        std::span<const float> origin_y;
+        std::span<const float> origin_z;
+        std::span<const float> dir_x;
+        std::span<const float> dir_y;
+        std::span<const float> dir_z;
+        std::span<const std::uint32_t> color;
+        std::span<const float> t_min;
+        std::span<const float> t_max;
+        std::span<const std::uint32_t> pixel;
+        std::span<const std::uint32_t> camera_id;
+    };
+
+    // ========================================================================
+    // Read-only memory mapping of a whole file.
+    // ========================================================================
+    export class MappedFile {
+    public:
+        [[nodiscard]] std::span<const std::byte> bytes() const noexcept {
+            return {base, static_cast<std::size_t>(length)};
+        }
+        // Hint that the range will be read front to back.
+        void advise_sequential(std::uint64_t offset, std::uint64_t size) const noexcept;
+        // Drop the range from the process working set; pages refault on access.
+        void release(std::uint64_t offset, std::uint64_t size) const noexcept;
+
+        explicit MappedFile(const std::filesystem::path& path);
+        ~MappedFile();
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+    private:
+        void close() noexcept;
+
+        const std::byte* base = nullptr;
+        std::uint64_t length  = 0;
+        std::intptr_t file    = -1;
+        void* mapping         = nullptr;
+    };
+
+    // ========================================================================
+    // Validated ray file: header + chunk index over a mapping.
+    // ========================================================================
+    export class RayFile {
+    public:
+        [[nodiscard]] const FileHeader& header() const noexcept {
+            return *head;
+        }
+        [[nodiscard]] std::span<const ChunkRecord> chunks() const noexcept {
+            return index;
+        }
+        [[nodiscard]] ChunkView chunk(std::uint32_t chunk_index) const;
+        // Ask the OS to start reading a chunk ahead of its decode.
+        void prefetch_chunk(std::uint32_t chunk_index) const noexcept;
+        // Release a chunk's pages once its data has been consumed.
+        void release_chunk(std::uint32_t chunk_index) const noexcept;
+
+        explicit RayFile(const std::filesystem::path& path);
+
+    private:
+        MappedFile map;
+        const FileHeader* head = nullptr;
+        std::span<const ChunkRecord> index;
+    };
+
+    // ========================================================================
+    // Writer used by capture tools; splits rays into fixed-size chunks.
+    // ========================================================================
+    export struct Ray {
+        std::array<float, 3> origin{};
+        std::array<float, 3> direction{};
+        std::uint32_t color = 0xffffffffu;
+        float t_min         = 0.0f;
+        float t_max         = 1.0f;
+        // Written only when the matching optional column is requested.
+        std::uint32_t pixel     = 0;
+        std::uint32_t camera_id = 0;
+    };
+
+    // columns: required_columns plus any subset of optional_columns.
+    export void write_ray_file(const std::filesystem::path& path, std::span<const Ray> rays, std::uint32_t chunk_capacity = 65536, std::uint32_t columns = required_columns);
+
+    // ========================================================================
+    // Compact GPU ray record (16 bytes, decoded by ray_segments.slang):
+    //   start_xy / start_z_length  start point as unorm16 per axis over the
+    //                              chunk bounds, segment length as unorm16
+    //                              of the bounds diagonal
+    //   direction                  octahedral snorm16 x | y << 16
+    //   color                      RGBA8, as stored in the file
+    // Quantization error is about 1/65535 of the chunk extent.
+    // ========================================================================
+    export struct RayRecord {
+        std::uint32_t start_xy       = 0;
+        std::uint32_t start_z_length = 0;
+        std::uint32_t direction      = 0;
+        std::uint32_t color          = 0;
+    };
+    static_assert(sizeof(RayRecord) == 16);
+
+    export [[nodiscard]] RayRecord encode_ray(const std::array<float, 3>& start, const std::array<float, 3>& end, std::uint32_t color, const ChunkRecord& chunk);
+
+    // CPU mirror of the ray_segments.slang decode (checks, inspection).
+    export struct DecodedRay {
+        std::array<float, 3> start{};
+        std::array<float, 3> end{};
+        std::uint32_t color = 0;
+    };
+
+    export [[nodiscard]] DecodedRay decode_ray(const RayRecord& record, const ChunkRecord& chunk);
+
+    // ========================================================================
+    // Background chunk decoder. A worker thread walks the chunk index and
+    // encodes chunks into RayRecords (the renderer expands each into a line
+    // segment), decoding a batch of chunks at a time across a (possibly
+    // shared) worker pool. Records come out in level-of-detail order, so
+    // any prefix of a chunk is a spatially even subsample. At most
+    // max_ready_chunks decoded chunks are held at once so the CPU working
+    // set stays bounded; chunks are delivered in file order, with requested
+    // chunks going ahead.
+    // ========================================================================
+    export struct StreamedChunk {
+        std::uint32_t index     = 0;
+        std::uint32_t ray_count = 0;
+        std::vector<RayRecord> records;
+        // File-order ray index of each record (attribute filters map their
+        // per-ray results to record positions through it).
+        std::vector<std::uint32_t> order;
+    };
+
+    export struct StreamerConfig {
+        std::uint32_t max_ready_chunks = 8;
+    };
+
+    export class ChunkStreamer {
+    public:
+        // Non-blocking; returns the next decoded chunk if one is ready.
+        [[nodiscard]] std::optional<StreamedChunk> try_pop();
+        // ====================================================================
+        // Decode a chunk again (it was evicted from the GPU), ahead of the
+        // rest of the initial pass. A chunk the pass has not reached yet is
+        // then skipped there.
+        // ====================================================================
+        void request(std::uint32_t chunk_index);
+        // True once every chunk and every request has been handed out.
+        [[nodiscard]] bool finished() const noexcept;
+        [[nodiscard]] std::uint32_t chunks_delivered() const noexcept {
+            return delivered.load(std::memory_order_relaxed);
+        }
+
+        ChunkStreamer(std::shared_ptr<const RayFile> file, std::shared_ptr<jobs::ThreadPool> workers, const StreamerConfig& config);
+        ~ChunkStreamer();
+        ChunkStreamer(const ChunkStreamer&)            = delete;
+        ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+        ChunkStreamer(ChunkStreamer&&)                 = delete;
+        ChunkStreamer& operator=(ChunkStreamer&&)      = delete;
+
+    private:
+        void worker(const std::stop_token& stop);
+
+        std::shared_ptr<const RayFile> file;
+        StreamerConfig config{};
+        std::shared_ptr<jobs::ThreadPool> decoders;
+
+        std::mutex mutex;
+        // Signalled when the consumer frees queue space or requests a chunk.
+        std::condition_variable_any space_available;
+        std::deque<StreamedChunk> ready;
+        std::deque<std::uint32_t> requested;
+        // Chunks the worker will hand out in total: the initial pass plus
+        // requests, minus pass entries a request already covered.
+        std::atomic<std::uint32_t> scheduled{0};
+        std::atomic<std::uint32_t> delivered{0};
+
+        // Declared last so the worker stops before the queue is destroyed.
+        std::jthread thread;
+    };
+} // namespace pngp::vis::rays::dataset
@@ -0,0 +1,255 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.density;
+// ============================================================================
+// Progressive density implementation.
+// ============================================================================
+import std;
+import vk.math;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+import pngp.vis.rays.pool;
+
+// ============================================================================
+// Translation-unit helpers.
+// ============================================================================
+namespace {
+    constexpr std::uint32_t splat_group_size = 64;
+    // Dispatch y covers slots; stay within the guaranteed group count limit.
+    constexpr std::uint32_t max_dispatch_slots = 65535;
+    // Longest screen-space walk per ray (a 4K diagonal takes ~4400 steps).
+    constexpr std::uint32_t max_splat_steps = 4096;
+    // Samples + red, green, blue sums per pixel.
+    constexpr vk::DeviceSize pixel_bytes = 4 * sizeof(std::uint32_t);
+
+    // ========================================================================
+    // Budget controller: start small, grow at most 2x per frame so a bad
+    // estimate cannot stall one frame, and never stop making progress.
+    // ========================================================================
+    constexpr std::uint64_t initial_rays = std::uint64_t{1} << 18;
+    constexpr std::uint64_t min_rays     = std::uint64_t{1} << 14;
+    constexpr std::uint64_t max_rays     = std::uint64_t{1} << 26;
+    // Weight of the newest timing sample in the per-ray cost estimate.
+    constexpr double cost_smoothing = 0.25;
+
+    static_assert(sizeof(pngp::vis::rays::density::SplatPush) == 96);
+    static_assert(sizeof(pngp::vis::rays::density::CompositePush) == 16);
+
+    void memory_barrier(const vk::raii::CommandBuffer& cmd, const vk::PipelineStageFlags2 src_stage, const vk::AccessFlags2 src_access, const vk::PipelineStageFlags2 dst_stage, const vk::AccessFlags2 dst_access) {
+        const vk::MemoryBarrier2 barrier{
+            .srcStageMask  = src_stage,
+            .srcAccessMask = src_access,
+            .dstStageMask  = dst_stage,
+            .dstAccessMask = dst_access,
+        };
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers    = &barrier,
+        });
+    }
+
+    void write_storage_buffers(const vk::raii::Device& device, const vk::DescriptorSet set, const std::span<const vk::DescriptorBufferInfo> buffers) {
+        std::vector<vk::WriteDescriptorSet> writes(buffers.size());
+        for (std::uint32_t b = 0; b < buffers.size(); ++b) {
+            writes[b] = vk::WriteDescriptorSet{
+                .dstSet          = set,
+                .dstBinding      = b,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo     = &buffers[b],
+            };
+        }
+        device.updateDescriptorSets(writes, {});
+    }
+} // namespace
+
+pngp::vis::rays::pipelines::DescriptorBindings pngp::vis::rays::density::bindings() {
+    const auto stages = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment;
+    return {
+        {.binding = 0, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = stages},
+        {.binding = 1, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = stages},
+        {.binding = 2, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = stages},
+        {.binding = 3, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = stages},
+    };
+}
+
+// ============================================================================
+// Constructor: set layout and pool for one live target plus one retired
+// per frame in flight; the buffer itself waits for the first extent.
+// ============================================================================
+pngp::vis::rays::density::DensityAccumulator::DensityAccumulator(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const std::uint32_t queue_family, const std::uint32_t frames_in_flight)
+    : physical_device(&physical_device), device(&device), frame_rays(frames_in_flight, 0), budget_rays(initial_rays), retire(frames_in_flight) {
+    const vk::DescriptorPoolSize pool_size{
+        .type            = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = 4 * (frames_in_flight + 1),
+    };
+    descriptor_pool = vk::raii::DescriptorPool(device, vk::DescriptorPoolCreateInfo{
+                                                           .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                                                           .maxSets       = frames_in_flight + 1,
+                                                           .poolSizeCount = 1,
+                                                           .pPoolSizes    = &pool_size,
+                                                       });
+
+    const auto set_bindings = bindings();
+
+    set_layout = vk::raii::DescriptorSetLayout(device, vk::DescriptorSetLayoutCreateInfo{
+                                                           .bindingCount = static_cast<std::uint32_t>(set_bindings.size()),
+                                                           .pBindings    = set_bindings.data(),
+                                                       });
+
+    // ========================================================================
+    // Without timestamps the budget stays at its initial ray count.
+    // ========================================================================
+    const auto families = physical_device.getQueueFamilyProperties();
+    const auto bits     = families[queue_family].timestampValidBits;
+    if (bits == 0) return;
+
+    timestamp_period_ns = physical_device.getProperties().limits.timestampPeriod;
+    timestamp_mask      = bits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+    queries             = vk::raii::QueryPool(device, vk::QueryPoolCreateInfo{
+                                                      .queryType  = vk::QueryType::eTimestamp,
+                                                      .queryCount = 2 * frames_in_flight,
+                                                  });
+}
+
+// ============================================================================
+// The slot's last frame is done, so its timestamps are final: read them
+// without eWait and skip the sample if the driver disagrees.
+// ============================================================================
+void pngp::vis::rays::density::DensityAccumulator::begin_frame(const std::uint32_t frame_index) {
+    retire.collect(frame_index);
+
+    const std::uint64_t rays = std::exchange(frame_rays[frame_index], 0);
+    if (!*queries || rays == 0) return;
+
+    const auto [result, ticks] = queries.getResults<std::uint64_t>(2 * frame_index, 2, 2 * sizeof(std::uint64_t), sizeof(std::uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) return;
+
+    const double sample = static_cast<double>((ticks[1] - ticks[0]) & timestamp_mask) * timestamp_period_ns / static_cast<double>(rays);
+    ns_per_ray          = ns_per_ray > 0.0 ? std::lerp(ns_per_ray, sample, cost_smoothing) : sample;
+}
+
+// ============================================================================
+// A new extent gets a new buffer and set; the old ones may still be read by
+// frames in flight, so they are retired rather than destroyed.
+// ============================================================================
+void pngp::vis::rays::density::DensityAccumulator::resize(const std::uint32_t frame_index, const pool::RayPool& ray_pool, const vk::Extent2D new_extent) {
+    if (*target.set) retire.retire(frame_index, std::move(target));
+
+    Target next{};
+    next.accum = upload::create_buffer(*physical_device, *device, pixel_bytes * new_extent.width * new_extent.height, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    const vk::DescriptorSetLayout layout = *set_layout;
+
+    auto sets = vk::raii::DescriptorSets(*device, vk::DescriptorSetAllocateInfo{
+                                                      .descriptorPool     = *descriptor_pool,
+                                                      .descriptorSetCount = 1,
+                                                      .pSetLayouts        = &layout,
+                                                  });
+    next.set = std::move(sets.front());
+
+    const auto rays = ray_pool.ray_buffers();
+    const std::array buffers{
+        rays[0],
+        rays[1],
+        rays[2],
+        vk::DescriptorBufferInfo{.buffer = *next.accum.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+    };
+    write_storage_buffers(*device, *next.set, buffers);
+
+    target = std::move(next);
+    extent = new_extent;
+    dirty  = true;
+}
+
+void pngp::vis::rays::density::DensityAccumulator::splat(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& splat_pipeline, const std::uint32_t frame_index, const pool::RayPool& ray_pool, const vk::math::mat4& view_proj, const vk::Extent2D new_extent, const float budget_ms) {
+    if (new_extent.width == 0 || new_extent.height == 0) return;
+    if (new_extent != extent) resize(frame_index, ray_pool, new_extent);
+
+    // ========================================================================
+    // Restart on any change of the camera matrices, bit for bit: inertia
+    // settling still moves the view, and a stale image would smear.
+    // ========================================================================
+    const bool restart = dirty || std::memcmp(&view_proj, &last_view_proj, sizeof(vk::math::mat4)) != 0;
+    if (restart) {
+        fraction       = 0.0f;
+        dirty          = false;
+        last_view_proj = view_proj;
+    }
+
+    const std::uint64_t selected = ray_pool.rays_selected();
+    if (selected == 0) fraction = 1.0f;
+    const bool dispatch = fraction < 1.0f;
+    if (!restart && !dispatch) return;
+
+    // ========================================================================
+    // Earlier frames' composites read the buffer (write-after-read).
+    // ========================================================================
+    memory_barrier(cmd, vk::PipelineStageFlagBits2::eFragmentShader, {}, vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader, {});
+
+    if (restart) {
+        cmd.fillBuffer(*target.accum.buffer, 0, VK_WHOLE_SIZE, 0);
+        memory_barrier(cmd, vk::PipelineStageFlagBits2::eClear, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eFragmentShader,
+                       vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+    }
+    if (!dispatch) return;
+
+    // ========================================================================
+    // Size this frame's share from the measured cost per ray.
+    // ========================================================================
+    if (ns_per_ray > 0.0) {
+        const double fit = std::max(0.0, static_cast<double>(budget_ms)) * 1e6 / ns_per_ray;
+        budget_rays      = std::clamp(static_cast<std::uint64_t>(fit), min_rays, std::min(max_rays, 2 * budget_rays));
+    }
+
+    const float begin = fraction;
+    float end         = std::min(1.0f, begin + static_cast<float>(static_cast<double>(budget_rays) / static_cast<double>(selected)));
+    end               = std::max(end, std::nextafter(begin, 2.0f));
+
+    SplatPush push{};
+    push.view_proj      = view_proj;
+    push.viewport       = {static_cast<float>(extent.width), static_cast<float>(extent.height)};
+    push.fraction_begin = begin;
+    push.fraction_end   = end;
+    push.slot_rays      = ray_pool.slot_rays();
+    push.max_steps      = max_splat_steps;
+
+    // One thread per entry of the widest slot's share (+1 for rounding).
+    const auto span   = static_cast<std::uint32_t>(std::ceil(static_cast<double>(push.slot_rays) * (end - begin))) + 1;
+    const auto groups = (span + splat_group_size - 1) / splat_group_size;
+
+    if (*queries) {
+        cmd.resetQueryPool(*queries, 2 * frame_index, 2);
+        cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eComputeShader, *queries, 2 * frame_index);
+    }
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *splat_pipeline.pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *splat_pipeline.layout, 0, {*target.set}, {});
+    const std::uint32_t slots = ray_pool.slot_range();
+    for (std::uint32_t first = 0; first < slots; first += max_dispatch_slots) {
+        push.first_slot = first;
+        cmd.pushConstants(*splat_pipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, vk::ArrayProxy<const SplatPush>{push});
+        cmd.dispatch(groups, std::min(max_dispatch_slots, slots - first), 1);
+    }
+
+    if (*queries) {
+        cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eComputeShader, *queries, 2 * frame_index + 1);
+        frame_rays[frame_index] = static_cast<std::uint64_t>(std::ceil(static_cast<double>(selected) * (end - begin)));
+    }
+    fraction = end;
+
+    memory_barrier(cmd, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead);
+}
+
+// ============================================================================
+// Samples are scaled up by the share splatted, so the brightness stays put
+// while the image converges.
+// ============================================================================
+void pngp::vis::rays::density::DensityAccumulator::composite(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& composite_pipeline, const float exposure, const float opacity) const {
+    if (!*target.set || fraction <= 0.0f) return;
+
+    const CompositePush push{exposure / fraction, extent.width, 0, opacity};
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *composite_pipeline.layout, 0, {*target.set}, {});
+    cmd.pushConstants(*composite_pipeline.layout, vk::ShaderStageFlagBits::eFragment, 0, vk::ArrayProxy<const CompositePush>{push});
+    cmd.draw(3, 1, 0, 0);
+}
@@ -0,0 +1,127 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.density;
+// ============================================================================
+// Progressive density: resident rays are splatted into a per-pixel
+// accumulation buffer a share per frame, sized to a GPU time budget, and
+// composited as a heatmap (or mean ray color). The image restarts whenever
+// the view, the extent or the selected rays change.
+// ============================================================================
+import vk.math;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+import pngp.vis.rays.pool;
+import std;
+
+namespace pngp::vis::rays::density {
+    // ========================================================================
+    // Push constants consumed by ray_splat.slang.
+    // ========================================================================
+    export struct SplatPush {
+        vk::math::mat4 view_proj{};
+        std::array<float, 2> viewport{};
+        // Fractions of each slot's selection before and after this dispatch.
+        float fraction_begin     = 0.0f;
+        float fraction_end       = 0.0f;
+        std::uint32_t slot_rays  = 0;
+        std::uint32_t first_slot = 0;
+        std::uint32_t max_steps  = 0;
+        std::uint32_t pad        = 0;
+    };
+
+    // ========================================================================
+    // Push constants consumed by ray_density.slang.
+    // ========================================================================
+    export struct CompositePush {
+        float density_scale = 0.0f;
+        std::uint32_t width = 0;
+        std::uint32_t pad   = 0;
+        float opacity       = 1.0f;
+    };
+
+    // ========================================================================
+    // Set 0 of both the splat and the composite pipeline: the pool's ray
+    // buffers (0-2, as in draw_bindings) and the accumulation buffer (3).
+    // ========================================================================
+    export [[nodiscard]] pipelines::DescriptorBindings bindings();
+
+    export class DensityAccumulator {
+    public:
+        // ====================================================================
+        // Frame slot's last frame is done: fold its splat timing into the
+        // cost estimate and free buffers retired by a resize.
+        // ====================================================================
+        void begin_frame(std::uint32_t frame_index);
+        // Selected rays changed (new slot, filter upload): restart.
+        void invalidate() noexcept {
+            dirty = true;
+        }
+        // ====================================================================
+        // Outside rendering: restart on a new view_proj or extent, then
+        // splat the next share of every resident slot, as many rays as fit
+        // budget_ms at the measured cost, and make the result visible to
+        // fragment shaders.
+        // ====================================================================
+        void splat(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& splat_pipeline, std::uint32_t frame_index, const pool::RayPool& ray_pool, const vk::math::mat4& view_proj, vk::Extent2D extent, float budget_ms);
+        // ====================================================================
+        // Inside rendering with a composite pipeline bound (the colormap or
+        // the radiance permutation): one fullscreen triangle. Does nothing
+        // before the first splat.
+        // ====================================================================
+        void composite(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& composite_pipeline, float exposure, float opacity) const;
+
+        // Share of every slot's selection accumulated so far.
+        [[nodiscard]] float progress() const noexcept {
+            return fraction;
+        }
+        [[nodiscard]] bool converged() const noexcept {
+            return fraction >= 1.0f;
+        }
+        [[nodiscard]] std::uint64_t rays_per_frame() const noexcept {
+            return budget_rays;
+        }
+
+        DensityAccumulator(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, std::uint32_t queue_family, std::uint32_t frames_in_flight);
+        ~DensityAccumulator()                                    = default;
+        DensityAccumulator(const DensityAccumulator&)            = delete;
+        DensityAccumulator& operator=(const DensityAccumulator&) = delete;
+        DensityAccumulator(DensityAccumulator&&)                 = delete;
+        DensityAccumulator& operator=(DensityAccumulator&&)      = delete;
+
+    private:
+        // Accumulation buffer for one extent and the set that binds it.
+        struct Target {
+            upload::GpuBuffer accum;
+            vk::raii::DescriptorSet set{nullptr};
+        };
+
+        void resize(std::uint32_t frame_index, const pool::RayPool& ray_pool, vk::Extent2D new_extent);
+
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        const vk::raii::Device* device                  = nullptr;
+
+        vk::raii::DescriptorPool descriptor_pool{nullptr};
+        vk::raii::DescriptorSetLayout set_layout{nullptr};
+        Target target;
+        vk::Extent2D extent{};
+        // ====================================================================
+        // Progress: restart when the view changes or invalidate() was called.
+        // ====================================================================
+        vk::math::mat4 last_view_proj{};
+        float fraction = 0.0f;
+        bool dirty     = true;
+        // ====================================================================
+        // Budget: one timestamp pair per frame slot around the dispatch, and
+        // rays splatted in that slot (0 = nothing to read back).
+        // ====================================================================
+        vk::raii::QueryPool queries{nullptr};
+        double timestamp_period_ns   = 0.0;
+        std::uint64_t timestamp_mask = 0;
+        std::vector<std::uint64_t> frame_rays;
+        double ns_per_ray         = 0.0;
+        std::uint64_t budget_rays = 0;
+
+        // Declared last: retired targets go before the descriptor pool.
+        upload::RetireQueue retire;
+    };
+} // namespace pngp::vis::rays::density
@@ -0,0 +1,242 @@
+module pngp.vis.rays.filter;
+// ============================================================================
+// Attribute filter implementation.
+// ============================================================================
+import std;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+
+// ============================================================================
+// Translation-unit helpers.
+// ============================================================================
+namespace {
+    using pngp::vis::rays::filter::FilterSettings;
+
+    // Key of a chunk whose records all pass (what a fresh upload holds).
+    constexpr std::uint64_t all_selected = 0;
+
+    // Inclusive range over non-negative ImGui ints as column values.
+    std::pair<std::uint32_t, std::uint32_t> id_range(const int lo, const int hi) {
+        return {static_cast<std::uint32_t>(std::max(0, lo)), static_cast<std::uint32_t>(std::max(0, hi))};
+    }
+
+    bool camera_active(const FilterSettings& s, const pngp::vis::rays::dataset::ChunkView& view) {
+        return s.enabled && s.by_camera && !view.camera_id.empty();
+    }
+    bool pixel_active(const FilterSettings& s, const pngp::vis::rays::dataset::ChunkView& view) {
+        return s.enabled && s.by_pixel && !view.pixel.empty();
+    }
+    bool depth_active(const FilterSettings& s) {
+        return s.enabled && s.by_depth;
+    }
+
+    // =========================================================================
+    // Two independent 32-bit sums of mixed entries: no carried dependency,
+    // so it vectorizes (a serial FNV chain cost 4x more than the scan).
+    // Odd, so it never collides with all_selected.
+    // =========================================================================
+    std::uint64_t selection_key(const std::span<const std::uint32_t> records, const std::size_t ray_count) {
+        if (records.size() == ray_count) return all_selected;
+        std::uint32_t a = 0;
+        std::uint32_t b = 0;
+        for (const std::uint32_t r : records) {
+            std::uint32_t x = r * 0x9e3779b1u;
+            x ^= x >> 15;
+            a += x * 0x85ebca77u;
+            b += (x ^ (x >> 13)) * 0xc2b2ae3du;
+        }
+        return ((static_cast<std::uint64_t>(a) << 32 | b) ^ records.size()) | 1;
+    }
+
+    // =========================================================================
+    // keep[i] &= pred(i), a block at a time: the predicate fills a local byte
+    // array first, which cannot alias the columns it reads, so the loop
+    // vectorizes without runtime alias checks.
+    // =========================================================================
+    template <typename Pred>
+    void and_mask(const std::span<std::uint8_t> keep, const Pred& pred) {
+        constexpr std::size_t block = 256;
+        std::array<std::uint8_t, block> pass{};
+        for (std::size_t base = 0; base < keep.size(); base += block) {
+            const std::size_t m = std::min(block, keep.size() - base);
+            for (std::size_t j = 0; j < m; ++j) pass[j] = static_cast<std::uint8_t>(pred(base + j));
+            for (std::size_t j = 0; j < m; ++j) keep[base + j] &= pass[j];
+        }
+    }
+
+    // =========================================================================
+    // Branch-free compaction in record order into out (order.size() long):
+    // every position is written and the cursor only advances past the
+    // ones that pass. Returns the count.
+    // =========================================================================
+    std::size_t compact(const std::span<const std::uint8_t> keep, const std::span<const std::uint32_t> order, const std::span<std::uint32_t> out) {
+        std::size_t count = 0;
+        for (std::uint32_t k = 0; k < order.size(); ++k) {
+            out[count] = k;
+            count += keep[order[k]];
+        }
+        return count;
+    }
+} // namespace
+
+// ============================================================================
+// Each predicate is a branch-free pass over contiguous columns and-ing into
+// a byte mask, so compilers vectorize it (16-32 rays per instruction on
+// SSE/AVX2) without intrinsics.
+// ============================================================================
+void pngp::vis::rays::filter::scan_chunk(const FilterSettings& settings, const dataset::ChunkView& view, const std::span<std::uint8_t> keep) {
+    std::ranges::fill(keep, std::uint8_t{1});
+
+    if (camera_active(settings, view)) {
+        const auto [lo, hi]         = id_range(settings.camera_min, settings.camera_max);
+        const std::uint32_t* camera = view.camera_id.data();
+        and_mask(keep, [&](const std::size_t i) { return (camera[i] >= lo) & (camera[i] <= hi); });
+    }
+
+    if (pixel_active(settings, view)) {
+        const auto [x_lo, x_hi]    = id_range(settings.pixel_min[0], settings.pixel_max[0]);
+        const auto [y_lo, y_hi]    = id_range(settings.pixel_min[1], settings.pixel_max[1]);
+        const std::uint32_t* pixel = view.pixel.data();
+        and_mask(keep, [&](const std::size_t i) {
+            const std::uint32_t x = pixel[i] & 0xffffu;
+            const std::uint32_t y = pixel[i] >> 16;
+            return (x >= x_lo) & (x <= x_hi) & (y >= y_lo) & (y <= y_hi);
+        });
+    }
+
+    if (depth_active(settings)) {
+        const float lo     = settings.depth_min;
+        const float hi     = settings.depth_max;
+        const float* t_max = view.t_max.data();
+        and_mask(keep, [&](const std::size_t i) { return (t_max[i] >= lo) & (t_max[i] <= hi); });
+    }
+}
+
+bool pngp::vis::rays::filter::matches(const FilterSettings& settings, const dataset::ChunkView& view, const std::uint32_t ray) {
+    if (camera_active(settings, view)) {
+        const auto [lo, hi] = id_range(settings.camera_min, settings.camera_max);
+        if (view.camera_id[ray] < lo || view.camera_id[ray] > hi) return false;
+    }
+    if (pixel_active(settings, view)) {
+        const auto [x_lo, x_hi] = id_range(settings.pixel_min[0], settings.pixel_max[0]);
+        const auto [y_lo, y_hi] = id_range(settings.pixel_min[1], settings.pixel_max[1]);
+        const std::uint32_t x   = view.pixel[ray] & 0xffffu;
+        const std::uint32_t y   = view.pixel[ray] >> 16;
+        if (x < x_lo || x > x_hi || y < y_lo || y > y_hi) return false;
+    }
+    if (depth_active(settings)) {
+        const float t = view.t_max[ray];
+        if (!(t >= settings.depth_min && t <= settings.depth_max)) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// RayFilter: one scanner thread fans each scan out over the worker pool.
+// ============================================================================
+pngp::vis::rays::filter::RayFilter::RayFilter(std::shared_ptr<const dataset::RayFile> file, std::shared_ptr<jobs::ThreadPool> workers) : file(std::move(file)), workers(std::move(workers)) {
+    if (!this->file || !this->workers) throw std::invalid_argument("RayFilter: file and worker pool required");
+    thread = std::jthread([this](const std::stop_token& stop) { scanner(stop); });
+}
+
+pngp::vis::rays::filter::RayFilter::~RayFilter() {
+    thread.request_stop();
+    work_available.notify_all();
+}
+
+void pngp::vis::rays::filter::RayFilter::add_chunk(const std::uint32_t chunk_index, std::vector<std::uint32_t> order) {
+    {
+        std::lock_guard lock(mutex);
+        queued.push_back({chunk_index, std::move(order), all_selected});
+    }
+    work_available.notify_one();
+}
+
+void pngp::vis::rays::filter::RayFilter::remove_chunk(const std::uint32_t chunk_index) {
+    std::lock_guard lock(mutex);
+    std::erase_if(queued, [&](const ChunkState& c) { return c.chunk == chunk_index; });
+    std::erase_if(changes, [&](const Selection& s) { return s.chunk == chunk_index; });
+    removed.push_back(chunk_index);
+}
+
+void pngp::vis::rays::filter::RayFilter::set_settings(const FilterSettings& new_settings) {
+    {
+        std::lock_guard lock(mutex);
+        if (settings == new_settings) return;
+        settings = new_settings;
+        generation.fetch_add(1, std::memory_order_relaxed);
+    }
+    work_available.notify_one();
+}
+
+std::vector<pngp::vis::rays::filter::Selection> pngp::vis::rays::filter::RayFilter::take_changes() {
+    std::lock_guard lock(mutex);
+    return std::exchange(changes, {});
+}
+
+bool pngp::vis::rays::filter::RayFilter::busy() const {
+    std::lock_guard lock(mutex);
+    return scanning || !queued.empty() || scanned_generation != generation.load(std::memory_order_relaxed);
+}
+
+// ============================================================================
+// New chunks are scanned under the current settings; a settings change
+// rescans everything. A scan overtaken by a newer change stops claiming
+// chunks and is dropped, and the next pass rescans from scratch.
+// ============================================================================
+void pngp::vis::rays::filter::RayFilter::scanner(const std::stop_token& stop) {
+    while (true) {
+        FilterSettings current{};
+        std::uint64_t gen = 0;
+        std::size_t begin = 0;
+        {
+            std::unique_lock lock(mutex);
+            if (!work_available.wait(lock, stop, [this] { return !queued.empty() || scanned_generation != generation.load(std::memory_order_relaxed); })) return;
+            // Removals first: a chunk evicted and re-added since the last
+            // pass keeps only its new entry.
+            if (!removed.empty()) {
+                std::erase_if(chunks, [&](const ChunkState& c) { return std::ranges::contains(removed, c.chunk); });
+                removed.clear();
+            }
+            begin = chunks.size();
+            for (auto& c : queued) chunks.push_back(std::move(c));
+            queued.clear();
+
+            gen     = generation.load(std::memory_order_relaxed);
+            current = settings;
+            if (scanned_generation != gen) begin = 0;
+            scanning = true;
+        }
+
+        const auto count = static_cast<std::uint32_t>(chunks.size() - begin);
+        std::vector<std::optional<Selection>> results(count);
+        std::vector<std::uint64_t> keys(count);
+        workers->parallel_for(count, [&](const std::uint32_t i) {
+            if (generation.load(std::memory_order_relaxed) != gen) return;
+            const ChunkState& state = chunks[begin + i];
+            const auto view         = file->chunk(state.chunk);
+
+            // Per-thread scratch; only a changed selection is copied out.
+            thread_local std::vector<std::uint8_t> keep;
+            thread_local std::vector<std::uint32_t> picked;
+            keep.resize(view.record->ray_count);
+            picked.resize(state.order.size());
+            scan_chunk(current, view, keep);
+
+            const auto records = std::span{picked}.first(compact(keep, state.order, picked));
+            keys[i]            = selection_key(records, state.order.size());
+            if (keys[i] != state.key) results[i] = Selection{state.chunk, {records.begin(), records.end()}};
+        });
+
+        std::lock_guard lock(mutex);
+        scanning = false;
+        if (generation.load(std::memory_order_relaxed) != gen) continue;
+        scanned_generation = gen;
+        for (std::uint32_t i = 0; i < count; ++i) {
+            if (!results[i]) continue;
+            chunks[begin + i].key = keys[i];
+            std::erase_if(changes, [&](const Selection& s) { return s.chunk == results[i]->chunk; });
+            changes.push_back(std::move(*results[i]));
+        }
+    }
+}
@@ -0,0 +1,119 @@
+export module pngp.vis.rays.filter;
+// ============================================================================
+// Attribute filtering: predicate scans over a chunk's SoA columns produce a
+// compact list of the records that pass, in GPU record (level-of-detail)
+// order. Chunks are scanned in parallel on the worker pool, and only
+// selections that changed are handed back for upload.
+// ============================================================================
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+import std;
+
+namespace pngp::vis::rays::filter {
+    // ========================================================================
+    // Filter UI state. Each predicate applies only when its toggle is on and
+    // the file carries the column; all active predicates must pass.
+    // ========================================================================
+    export struct FilterSettings {
+        bool enabled = false;
+
+        // Inclusive camera id range (CameraId column).
+        bool by_camera = false;
+        int camera_min = 0;
+        int camera_max = 0;
+
+        // Inclusive source pixel rectangle (Pixel column).
+        bool by_pixel = false;
+        std::array<int, 2> pixel_min{0, 0};
+        std::array<int, 2> pixel_max{65535, 65535};
+
+        // Hit distance (t_max) range.
+        bool by_depth   = false;
+        float depth_min = 0.0f;
+        float depth_max = 100.0f;
+
+        bool operator==(const FilterSettings&) const = default;
+    };
+
+    // ========================================================================
+    // Branch-free scan of one chunk: keep[i] (file order) ends up 1 when ray
+    // i passes every active predicate, 0 otherwise.
+    // ========================================================================
+    export void scan_chunk(const FilterSettings& settings, const dataset::ChunkView& view, std::span<std::uint8_t> keep);
+
+    // Single-ray test with the same semantics (picking, inspection).
+    export [[nodiscard]] bool matches(const FilterSettings& settings, const dataset::ChunkView& view, std::uint32_t ray);
+
+    // ========================================================================
+    // Record positions (ascending) that pass, for one chunk. A prefix is
+    // still an even subsample, so level of detail keeps working.
+    // ========================================================================
+    export struct Selection {
+        std::uint32_t chunk = 0;
+        std::vector<std::uint32_t> records;
+    };
+
+    export class RayFilter {
+    public:
+        // ====================================================================
+        // Chunk is resident with every record selected. order[k] is the
+        // file-order ray stored at record position k.
+        // ====================================================================
+        void add_chunk(std::uint32_t chunk_index, std::vector<std::uint32_t> order);
+        // Chunk left the GPU: stop scanning it and drop its unsent changes.
+        // Adding it again later starts over with every record selected.
+        void remove_chunk(std::uint32_t chunk_index);
+        // Rescan every chunk when the settings differ from the last ones.
+        void set_settings(const FilterSettings& settings);
+        // ====================================================================
+        // Main thread: selections that differ from the last ones handed
+        // out, from the newest finished scan.
+        // ====================================================================
+        [[nodiscard]] std::vector<Selection> take_changes();
+        // A scan is queued or running.
+        [[nodiscard]] bool busy() const;
+
+        RayFilter(std::shared_ptr<const dataset::RayFile> file, std::shared_ptr<jobs::ThreadPool> workers);
+        ~RayFilter();
+        RayFilter(const RayFilter&)            = delete;
+        RayFilter& operator=(const RayFilter&) = delete;
+        RayFilter(RayFilter&&)                 = delete;
+        RayFilter& operator=(RayFilter&&)      = delete;
+
+    private:
+        // ====================================================================
+        // Scanner-owned per-chunk state; key identifies the selection the
+        // main thread last received (the record count when all pass).
+        // ====================================================================
+        struct ChunkState {
+            std::uint32_t chunk = 0;
+            std::vector<std::uint32_t> order;
+            std::uint64_t key = 0;
+        };
+
+        void scanner(const std::stop_token& stop);
+
+        std::shared_ptr<const dataset::RayFile> file;
+        std::shared_ptr<jobs::ThreadPool> workers;
+        // ====================================================================
+        // Hand-off (guarded by mutex). generation bumps on every settings
+        // change so a stale scan stops early and is discarded.
+        // ====================================================================
+        mutable std::mutex mutex;
+        std::condition_variable_any work_available;
+        FilterSettings settings{};
+        std::atomic<std::uint64_t> generation{0};
+        std::uint64_t scanned_generation = 0;
+        std::vector<ChunkState> queued;
+        std::vector<std::uint32_t> removed;
+        std::vector<Selection> changes;
+        bool scanning = false;
+        // ====================================================================
+        // Scanner thread only.
+        // ====================================================================
+        std::vector<ChunkState> chunks;
+
+        // Declared last so the scanner stops before the state above goes.
+        std::jthread thread;
+    };
+} // namespace pngp::vis::rays::filter
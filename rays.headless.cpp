@@ -0,0 +1,339 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.headless;
+// ============================================================================
+// Headless benchmark implementation.
+// ============================================================================
+import std;
+import vk.camera;
+import vk.math;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.scene;
+import pngp.vis.rays.replay;
+import pngp.vis.rays.pacing;
+
+// ============================================================================
+// Translation-unit helpers (device selection, JSON).
+// ============================================================================
+namespace {
+    // Fixed step keeps the scripted camera path identical across runs.
+    constexpr float script_dt = 1.0f / 60.0f;
+
+    int device_rank(const vk::PhysicalDeviceType type) {
+        switch (type) {
+        case vk::PhysicalDeviceType::eDiscreteGpu: return 0;
+        case vk::PhysicalDeviceType::eIntegratedGpu: return 1;
+        case vk::PhysicalDeviceType::eVirtualGpu: return 2;
+        case vk::PhysicalDeviceType::eCpu: return 3;
+        default: return 4;
+        }
+    }
+
+    std::string json_escape(const std::string_view s) {
+        std::string out;
+        for (const char c : s) {
+            if (c == '"' || c == '\\') out.push_back('\\');
+            if (static_cast<unsigned char>(c) < 0x20) continue;
+            out.push_back(c);
+        }
+        return out;
+    }
+
+    std::string stats_json(const pngp::vis::rays::headless::FrameStats& s) {
+        return std::format(R"({{"mean": {:.4f}, "p50": {:.4f}, "p95": {:.4f}, "p99": {:.4f}, "max": {:.4f}}})", s.mean, s.p50, s.p95, s.p99, s.max);
+    }
+} // namespace
+
+pngp::vis::rays::headless::FrameStats pngp::vis::rays::headless::frame_stats(std::vector<double> samples_ms) {
+    FrameStats out{};
+    if (samples_ms.empty()) return out;
+
+    std::ranges::sort(samples_ms);
+    const auto rank = [&](const double p) {
+        const auto n = samples_ms.size();
+        const auto k = static_cast<std::size_t>(std::ceil(p / 100.0 * static_cast<double>(n)));
+        return samples_ms[std::clamp<std::size_t>(k, 1, n) - 1];
+    };
+
+    out.mean = std::accumulate(samples_ms.begin(), samples_ms.end(), 0.0) / static_cast<double>(samples_ms.size());
+    out.p50  = rank(50.0);
+    out.p95  = rank(95.0);
+    out.p99  = rank(99.0);
+    out.max  = samples_ms.back();
+    return out;
+}
+
+std::string pngp::vis::rays::headless::to_json(const BenchResult& result) {
+    std::string out = "{\n";
+    out += std::format("  \"device\": \"{}\",\n", json_escape(result.device));
+    out += std::format("  \"width\": {},\n  \"height\": {},\n", result.extent.width, result.extent.height);
+    out += std::format("  \"frames\": {},\n  \"frames_in_flight\": {},\n", result.frames, result.frames_in_flight);
+    out += std::format("  \"rays\": {},\n  \"chunks\": {},\n", result.rays, result.chunks);
+    out += std::format("  \"cpu_ms\": {},\n", stats_json(result.cpu));
+    out += std::format("  \"gpu_ms\": {},\n", result.gpu ? stats_json(*result.gpu) : std::string("null"));
+    out += std::format("  \"frame_ms\": {}\n", stats_json(result.frame));
+    out += "}\n";
+    return out;
+}
+
+// ============================================================================
+// Constructor: device, offscreen targets, frame slots, scene, camera.
+// ============================================================================
+pngp::vis::rays::headless::HeadlessBench::HeadlessBench(const BenchInfo& info) : info(info) {
+    if (!info.replay.empty()) {
+        camera_path = replay::read_recording(info.replay);
+        if (camera_path.empty()) throw std::runtime_error(std::format("input recording has no frames: {}", info.replay.string()));
+        this->info.frames = static_cast<std::uint32_t>(camera_path.size());
+    }
+    if (info.frames_in_flight == 0) throw std::runtime_error("at least one frame in flight");
+    const std::uint32_t frames_in_flight = info.frames_in_flight;
+    create_device();
+    create_targets();
+
+    command_pool = vk::raii::CommandPool(device, vk::CommandPoolCreateInfo{
+                                                     .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                                     .queueFamilyIndex = queue_family,
+                                                 });
+    auto cmds = vk::raii::CommandBuffers(device, vk::CommandBufferAllocateInfo{
+                                                     .commandPool        = *command_pool,
+                                                     .level              = vk::CommandBufferLevel::ePrimary,
+                                                     .commandBufferCount = frames_in_flight,
+                                                 });
+    for (auto& cmd : cmds) slots.push_back(FrameSlot{.cmd = std::move(cmd)});
+    pacer = std::make_unique<pacing::FramePacer>(device, pacing::PacerInfo{.frames_in_flight = frames_in_flight});
+
+    // ========================================================================
+    // Timestamps need nonzero valid bits on the queue family; without them
+    // the report simply carries no GPU section.
+    // ========================================================================
+    const auto families = physical_device.getQueueFamilyProperties();
+    if (families[queue_family].timestampValidBits > 0) {
+        timestamp_period_ns = physical_device.getProperties().limits.timestampPeriod;
+        timestamps          = vk::raii::QueryPool(device, vk::QueryPoolCreateInfo{
+                                                         .queryType  = vk::QueryType::eTimestamp,
+                                                         .queryCount = 2 * frames_in_flight,
+                                                     });
+    }
+
+    const GpuDevice gpu{&physical_device, &device, &queue, queue_family, indirect};
+    scene = std::make_unique<Scene>(gpu, SceneInfo{.frames_in_flight = frames_in_flight, .dataset = info.dataset, .pipeline_cache = info.pipeline_cache, .picking = false});
+    scene->set_formats(color_format, depth_format);
+    if (!camera_path.empty() && camera_path.front().grid) scene->grid_settings() = *camera_path.front().grid;
+
+    // ========================================================================
+    // Same framing as the viewer: orbit the grid, pulled back for datasets.
+    // A replay starts from the recorded grid, as the viewer's does.
+    // ========================================================================
+    vk::camera::CameraConfig cam_cfg{};
+    cam_cfg.fov_y_rad = info.fov_y_rad;
+    cam_cfg.znear     = info.near_plane;
+    cam_cfg.zfar      = info.far_plane;
+    cam.set_config(cam_cfg);
+    cam.home();
+    cam.set_mode(vk::camera::Mode::Orbit);
+    {
+        auto st           = cam.state();
+        st.orbit.distance = std::max(1.0f, scene->grid_settings().grid_extent * 1.15f);
+        if (const auto radius = scene->dataset_radius()) st.orbit.distance = std::max(st.orbit.distance, *radius * 2.0f);
+        cam.set_state(st);
+    }
+}
+
+pngp::vis::rays::headless::HeadlessBench::~HeadlessBench() {
+    // Slots may still be executing if run() threw part-way through.
+    try {
+        if (*device) device.waitIdle();
+    } catch (...) {
+    }
+}
+
+void pngp::vis::rays::headless::HeadlessBench::create_device() {
+    const vk::ApplicationInfo app{
+        .pApplicationName   = "Rays Bench",
+        .applicationVersion = 1,
+        .pEngineName        = "Engine",
+        .engineVersion      = 1,
+        .apiVersion         = VK_API_VERSION_1_3,
+    };
+    instance = vk::raii::Instance(context, vk::InstanceCreateInfo{.pApplicationInfo = &app});
+
+    // ========================================================================
+    // Prefer real GPUs, but accept software rasterizers for CI machines.
+    // ========================================================================
+    std::optional<vk::raii::PhysicalDevice> best;
+    int best_rank = std::numeric_limits<int>::max();
+    for (auto& pd : instance.enumeratePhysicalDevices()) {
+        const auto props = pd.getProperties();
+        if (props.apiVersion < VK_API_VERSION_1_3) continue;
+        if (const int rank = device_rank(props.deviceType); rank < best_rank) {
+            best_rank = rank;
+            best.emplace(std::move(pd));
+        }
+    }
+    if (!best) throw std::runtime_error("no Vulkan 1.3 device available");
+    physical_device = std::move(*best);
+    queue_family    = upload::graphics_queue_family(physical_device);
+
+    // Indirect ray draws use indirect count / multi-draw when available.
+    auto logical                 = upload::create_device(physical_device, queue_family);
+    device                       = std::move(logical.device);
+    queue                        = std::move(logical.queue);
+    indirect.draw_indirect_count = logical.features.draw_indirect_count;
+    indirect.multi_draw_indirect = logical.features.multi_draw_indirect;
+}
+
+void pngp::vis::rays::headless::HeadlessBench::create_targets() {
+    const auto depth_props = physical_device.getFormatProperties(depth_format);
+    if (!(depth_props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)) throw std::runtime_error("D32 depth attachments unsupported");
+
+    auto c       = upload::create_image(physical_device, device, info.extent, color_format, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::ImageAspectFlagBits::eColor);
+    color        = std::move(c.image);
+    color_memory = std::move(c.memory);
+    color_view   = std::move(c.view);
+
+    auto d       = upload::create_image(physical_device, device, info.extent, depth_format, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth);
+    depth        = std::move(d.image);
+    depth_memory = std::move(d.memory);
+    depth_view   = std::move(d.view);
+}
+
+// ============================================================================
+// Record the scene pass between two timestamps.
+// ============================================================================
+void pngp::vis::rays::headless::HeadlessBench::record(FrameSlot& slot, const std::uint32_t slot_index) {
+    const auto& cmd = slot.cmd;
+    cmd.reset();
+    cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    if (*timestamps) {
+        cmd.resetQueryPool(*timestamps, 2 * slot_index, 2);
+        cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *timestamps, 2 * slot_index);
+    }
+
+    // ========================================================================
+    // Both slots share one set of targets; order this frame's attachment
+    // writes after the previous frame's (the swapchain path gets this from
+    // the acquire semaphore instead).
+    // ========================================================================
+    const vk::MemoryBarrier2 barrier{
+        .srcStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eLateFragmentTests,
+        .srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+        .dstStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eEarlyFragmentTests,
+        .dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers    = &barrier,
+    });
+
+    const RenderTargets targets{
+        .extent       = info.extent,
+        .color        = *color,
+        .color_view   = *color_view,
+        .color_layout = &color_layout,
+        .depth        = *depth,
+        .depth_view   = *depth_view,
+        .depth_layout = &depth_layout,
+    };
+    scene->record(cmd, slot_index, targets, cam.matrices().view_proj, camera_eye(cam.matrices().c2w));
+
+    if (*timestamps) cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *timestamps, 2 * slot_index + 1);
+    cmd.end();
+}
+
+// ============================================================================
+// Scripted frame: slow orbit (Alt + LMB drag) with a zoom in/out cycle, or
+// the recorded input and dt when replaying.
+// ============================================================================
+pngp::vis::rays::headless::HeadlessBench::FrameSample pngp::vis::rays::headless::HeadlessBench::frame(const std::uint32_t frame_number, const replay::InputFrame* replayed) {
+    const std::uint32_t slot_index = pacer->slot(frame_number);
+    FrameSlot& slot                = slots[slot_index];
+
+    FrameSample sample{};
+    if (frame_number >= info.frames_in_flight) {
+        pacer->wait_for_slot(frame_number);
+        if (*timestamps) {
+            const auto [result, ticks] = timestamps.getResults<std::uint64_t>(2 * slot_index, 2, 2 * sizeof(std::uint64_t), sizeof(std::uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+            if (result == vk::Result::eSuccess && ticks[1] >= ticks[0]) sample.gpu_ms = static_cast<double>(ticks[1] - ticks[0]) * timestamp_period_ns * 1e-6;
+        }
+    }
+
+    // Host-side cost starts once the slot is free, matching the viewer loop.
+    const auto t0 = std::chrono::steady_clock::now();
+    scene->begin_frame(slot_index);
+    if (replayed && replayed->grid) {
+        const bool rebuild     = replayed->grid->grid_extent != scene->grid_settings().grid_extent;
+        scene->grid_settings() = *replayed->grid;
+        if (rebuild) scene->mark_grid_dirty();
+    }
+    scene->update(slot_index);
+
+    vk::camera::CameraInput ci{};
+    float dt = script_dt;
+    if (replayed) {
+        ci = replayed->input;
+        dt = replayed->dt;
+        cam.set_mode(scene->grid_settings().fly_mode ? vk::camera::Mode::Fly : vk::camera::Mode::Orbit);
+    } else if (camera_path.empty()) {
+        ci.alt      = true;
+        ci.lmb      = true;
+        ci.mouse_dx = 4.0f;
+        ci.scroll   = (frame_number / 120) % 2 == 0 ? 0.05f : -0.05f;
+    }
+    cam.update(dt, info.extent.width, info.extent.height, ci);
+
+    record(slot, slot_index);
+    const vk::CommandBufferSubmitInfo cmd_info{.commandBuffer = *slot.cmd};
+    pacer->submit(queue, vk::SubmitInfo2{.commandBufferInfoCount = 1, .pCommandBufferInfos = &cmd_info}, frame_number);
+    pacer->submitted(frame_number, std::nullopt);
+
+    sample.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return sample;
+}
+
+// ============================================================================
+// Stream -> warm up -> measure. GPU samples lag their frame by one slot
+// cycle, so the tail is drained after the loop.
+// ============================================================================
+pngp::vis::rays::headless::BenchResult pngp::vis::rays::headless::HeadlessBench::run() {
+    std::uint32_t frame_number = 0;
+    if (info.wait_for_dataset) {
+        while (scene->streaming()) (void) frame(frame_number++);
+    }
+    for (std::uint32_t i = 0; i < info.warmup_frames; ++i) (void) frame(frame_number++);
+
+    std::vector<double> cpu_ms;
+    std::vector<double> gpu_ms;
+    std::vector<double> frame_ms;
+    cpu_ms.reserve(info.frames);
+    gpu_ms.reserve(info.frames);
+    frame_ms.reserve(info.frames);
+
+    auto t_prev                          = std::chrono::steady_clock::now();
+    const std::uint32_t frames_in_flight = info.frames_in_flight;
+    for (std::uint32_t i = 0; i < info.frames + frames_in_flight; ++i) {
+        const auto sample = frame(frame_number++, i < camera_path.size() ? &camera_path[i] : nullptr);
+        const auto t_now  = std::chrono::steady_clock::now();
+
+        // Timestamps read in iteration i belong to measured frame i - frames_in_flight.
+        if (sample.gpu_ms && i >= frames_in_flight) gpu_ms.push_back(*sample.gpu_ms);
+        if (i < info.frames) {
+            cpu_ms.push_back(sample.cpu_ms);
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(t_now - t_prev).count());
+        }
+        t_prev = t_now;
+    }
+    device.waitIdle();
+    scene->shutdown();
+
+    BenchResult result{};
+    result.device           = physical_device.getProperties().deviceName.data();
+    result.extent           = info.extent;
+    result.frames           = info.frames;
+    result.frames_in_flight = info.frames_in_flight;
+    result.rays             = scene->rays_resident();
+    result.chunks           = scene->chunks_resident();
+    result.cpu              = frame_stats(std::move(cpu_ms));
+    result.frame            = frame_stats(std::move(frame_ms));
+    if (!gpu_ms.empty()) result.gpu = frame_stats(std::move(gpu_ms));
+    return result;
+}
@@ -0,0 +1,153 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.headless;
+// ============================================================================
+// Headless benchmark: no window or surface, the scene pass renders into
+// offscreen color + depth images under a scripted camera, and frame-time
+// percentiles are reported as JSON.
+// ============================================================================
+import vk.camera;
+import vk.math;
+import pngp.vis.rays.pool;
+import pngp.vis.rays.scene;
+import pngp.vis.rays.replay;
+import pngp.vis.rays.pacing;
+import std;
+
+namespace pngp::vis::rays::headless {
+    // ========================================================================
+    // Benchmark run parameters.
+    // ========================================================================
+    export struct BenchInfo {
+        std::filesystem::path dataset{};
+        std::filesystem::path pipeline_cache = "rays_pipeline_cache.bin";
+        vk::Extent2D extent{1920, 1080};
+        // Unmeasured frames after streaming settles (pipelines, caches, clocks).
+        std::uint32_t warmup_frames = 30;
+        std::uint32_t frames        = 600;
+        // Measure with the whole dataset resident instead of mid-stream.
+        bool wait_for_dataset = true;
+        // Frames the CPU may run ahead of the GPU (timeline-paced); more
+        // keep the queue full for throughput runs.
+        std::uint32_t frames_in_flight = 2;
+        // Input recording from the viewer: replaces the scripted orbit and
+        // sets the measured frame count; earlier frames hold the home view.
+        std::filesystem::path replay{};
+
+        float fov_y_rad  = std::numbers::pi_v<float> / 3.0f;
+        float near_plane = 0.05f;
+        float far_plane  = 2000.0f;
+    };
+
+    // ========================================================================
+    // Milliseconds over the measured frames (nearest-rank percentiles).
+    // ========================================================================
+    export struct FrameStats {
+        double mean = 0.0;
+        double p50  = 0.0;
+        double p95  = 0.0;
+        double p99  = 0.0;
+        double max  = 0.0;
+    };
+
+    export [[nodiscard]] FrameStats frame_stats(std::vector<double> samples_ms);
+
+    export struct BenchResult {
+        std::string device{};
+        vk::Extent2D extent{};
+        std::uint32_t frames           = 0;
+        std::uint32_t frames_in_flight = 0;
+        std::uint64_t rays             = 0;
+        std::size_t chunks             = 0;
+        // Host time to update + record + submit one frame (slot wait excluded).
+        FrameStats cpu{};
+        // Scene pass duration from GPU timestamps; empty when unsupported.
+        std::optional<FrameStats> gpu{};
+        // Wall-clock time between consecutive frame starts.
+        FrameStats frame{};
+    };
+
+    export [[nodiscard]] std::string to_json(const BenchResult& result);
+
+    // ========================================================================
+    // Owns its own instance/device; GLFW is never initialized, so it runs on
+    // display-less machines (lavapipe included).
+    // ========================================================================
+    export class HeadlessBench {
+    public:
+        // ====================================================================
+        // Stream the dataset, warm up, then time the measured frames.
+        // ====================================================================
+        BenchResult run();
+
+        explicit HeadlessBench(const BenchInfo& info);
+        ~HeadlessBench();
+        HeadlessBench(const HeadlessBench&)            = delete;
+        HeadlessBench& operator=(const HeadlessBench&) = delete;
+        HeadlessBench(HeadlessBench&&)                 = delete;
+        HeadlessBench& operator=(HeadlessBench&&)      = delete;
+
+    private:
+        // ====================================================================
+        // Per-slot recording state; timestamps sit at [2 * slot, 2 * slot + 1].
+        // ====================================================================
+        struct FrameSlot {
+            vk::raii::CommandBuffer cmd{nullptr};
+        };
+
+        struct FrameSample {
+            double cpu_ms = 0.0;
+            std::optional<double> gpu_ms{};
+        };
+
+        void create_device();
+        void create_targets();
+        // ====================================================================
+        // One scripted frame; returns the GPU time of the frame that last used
+        // this slot, once the pacer has seen it complete. A replay frame
+        // replaces the script; in replay mode, frames without one hold the
+        // camera.
+        // ====================================================================
+        FrameSample frame(std::uint32_t frame_number, const replay::InputFrame* replayed = nullptr);
+        void record(FrameSlot& slot, std::uint32_t slot_index);
+
+        BenchInfo info{};
+        // ====================================================================
+        // Instance + device (no surface, no swapchain).
+        // ====================================================================
+        vk::raii::Context context;
+        vk::raii::Instance instance{nullptr};
+        vk::raii::PhysicalDevice physical_device{nullptr};
+        vk::raii::Device device{nullptr};
+        vk::raii::Queue queue{nullptr};
+        std::uint32_t queue_family = 0;
+        pool::IndirectFeatures indirect{};
+        // ====================================================================
+        // Offscreen render targets standing in for the swapchain image.
+        // ====================================================================
+        vk::Format color_format = vk::Format::eR8G8B8A8Unorm;
+        vk::Format depth_format = vk::Format::eD32Sfloat;
+        vk::raii::Image color{nullptr};
+        vk::raii::DeviceMemory color_memory{nullptr};
+        vk::raii::ImageView color_view{nullptr};
+        vk::ImageLayout color_layout = vk::ImageLayout::eUndefined;
+        vk::raii::Image depth{nullptr};
+        vk::raii::DeviceMemory depth_memory{nullptr};
+        vk::raii::ImageView depth_view{nullptr};
+        vk::ImageLayout depth_layout = vk::ImageLayout::eUndefined;
+        // ====================================================================
+        // Frames in flight + GPU timestamps.
+        // ====================================================================
+        vk::raii::CommandPool command_pool{nullptr};
+        std::vector<FrameSlot> slots;
+        std::unique_ptr<pacing::FramePacer> pacer;
+        vk::raii::QueryPool timestamps{nullptr};
+        double timestamp_period_ns = 0.0;
+        // ====================================================================
+        // Scene under test + scripted (or recorded) camera.
+        // ====================================================================
+        std::unique_ptr<Scene> scene;
+        vk::camera::Camera cam;
+        std::vector<replay::InputFrame> camera_path;
+    };
+} // namespace pngp::vis::rays::headless
@@ -0,0 +1,86 @@
+module pngp.vis.rays.jobs;
+// ============================================================================
+// Worker pool implementation.
+// ============================================================================
+import std;
+
+std::uint32_t pngp::vis::rays::jobs::default_thread_count() noexcept {
+    const std::uint32_t hw = std::thread::hardware_concurrency();
+    return hw > 1 ? hw - 1 : 1;
+}
+
+pngp::vis::rays::jobs::ThreadPool::ThreadPool(const std::uint32_t threads) {
+    workers.reserve(std::max(1u, threads));
+    for (std::uint32_t i = 0; i < std::max(1u, threads); ++i) workers.emplace_back([this](const std::stop_token& stop) { worker(stop); });
+}
+
+pngp::vis::rays::jobs::ThreadPool::~ThreadPool() {
+    for (auto& w : workers) w.request_stop();
+    work_available.notify_all();
+}
+
+void pngp::vis::rays::jobs::ThreadPool::parallel_for(const std::uint32_t count, const std::function<void(std::uint32_t)>& fn) {
+    if (count == 0) return;
+
+    const auto batch = std::make_shared<Batch>();
+    batch->fn        = &fn;
+    batch->count     = count;
+    {
+        std::lock_guard lock(mutex);
+        open.push_back(batch);
+    }
+    work_available.notify_all();
+
+    drain(*batch);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(mutex);
+        batch_done.wait(lock, [&] { return batch->done.load(std::memory_order_acquire) == batch->count; });
+        std::erase(open, batch);
+        error = batch->error;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+// ============================================================================
+// Claim indices until the batch runs dry; the thread finishing the last
+// index wakes the submitter.
+// ============================================================================
+void pngp::vis::rays::jobs::ThreadPool::drain(Batch& batch) {
+    for (std::uint32_t i = batch.next.fetch_add(1, std::memory_order_relaxed); i < batch.count; i = batch.next.fetch_add(1, std::memory_order_relaxed)) {
+        try {
+            (*batch.fn)(i);
+        } catch (...) {
+            std::lock_guard lock(mutex);
+            if (!batch.error) batch.error = std::current_exception();
+        }
+        if (batch.done.fetch_add(1, std::memory_order_acq_rel) + 1 == batch.count) {
+            std::lock_guard lock(mutex);
+            batch_done.notify_all();
+        }
+    }
+}
+
+// ============================================================================
+// Newest first: the batch submitted last is usually the one its caller is
+// waiting on right now (a frame), older ones are background work.
+// ============================================================================
+std::shared_ptr<pngp::vis::rays::jobs::ThreadPool::Batch> pngp::vis::rays::jobs::ThreadPool::claimable() const {
+    for (const auto& batch : std::views::reverse(open)) {
+        if (batch->next.load(std::memory_order_relaxed) < batch->count) return batch;
+    }
+    return nullptr;
+}
+
+void pngp::vis::rays::jobs::ThreadPool::worker(const std::stop_token& stop) {
+    while (true) {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock lock(mutex);
+            if (!work_available.wait(lock, stop, [this] { return claimable() != nullptr; })) return;
+            batch = claimable();
+        }
+        drain(*batch);
+    }
+}
@@ -0,0 +1,59 @@
+export module pngp.vis.rays.jobs;
+// ============================================================================
+// Fixed worker pool for CPU-side work (chunk decode, BVH builds, command
+// recording). parallel_for blocks, and the calling thread helps out.
+// ============================================================================
+import std;
+
+namespace pngp::vis::rays::jobs {
+    // One worker per hardware thread, minus the submitting thread.
+    export [[nodiscard]] std::uint32_t default_thread_count() noexcept;
+
+    export class ThreadPool {
+    public:
+        // ====================================================================
+        // Run fn(i) for every i in [0, count) and return once all calls have
+        // finished. The first exception thrown by fn is rethrown here.
+        // Concurrent (and nested) calls run side by side: idle workers
+        // steal indices from the newest open batch, so a short frame-
+        // critical batch never queues behind a long decode batch.
+        // ====================================================================
+        void parallel_for(std::uint32_t count, const std::function<void(std::uint32_t)>& fn);
+
+        [[nodiscard]] std::uint32_t thread_count() const noexcept {
+            return static_cast<std::uint32_t>(workers.size());
+        }
+
+        explicit ThreadPool(std::uint32_t threads = default_thread_count());
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&)            = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ThreadPool(ThreadPool&&)                 = delete;
+        ThreadPool& operator=(ThreadPool&&)      = delete;
+
+    private:
+        // ====================================================================
+        // One parallel_for call; indices are claimed with an atomic counter.
+        // ====================================================================
+        struct Batch {
+            const std::function<void(std::uint32_t)>* fn = nullptr;
+            std::uint32_t count                          = 0;
+            std::atomic<std::uint32_t> next{0};
+            std::atomic<std::uint32_t> done{0};
+            std::exception_ptr error{};
+        };
+
+        void worker(const std::stop_token& stop);
+        void drain(Batch& batch);
+        // Newest batch with unclaimed indices; mutex must be held.
+        [[nodiscard]] std::shared_ptr<Batch> claimable() const;
+
+        std::mutex mutex;
+        std::condition_variable_any work_available;
+        std::condition_variable batch_done;
+        std::vector<std::shared_ptr<Batch>> open;
+
+        // Declared last so workers stop before the state they wait on goes.
+        std::vector<std::jthread> workers;
+    };
+} // namespace pngp::vis::rays::jobs
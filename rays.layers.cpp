@@ -0,0 +1,79 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.layers;
+// ============================================================================
+// Render layer implementation.
+// ============================================================================
+import std;
+import pngp.vis.rays.jobs;
+import pngp.vis.rays.profiler;
+
+pngp::vis::rays::layers::LayerRecorder::LayerRecorder(const vk::raii::Device& device, const std::uint32_t queue_family, std::shared_ptr<jobs::ThreadPool> workers, const std::uint32_t frames_in_flight)
+    : device(&device), queue_family(queue_family), workers(std::move(workers)), frames(frames_in_flight) {}
+
+void pngp::vis::rays::layers::LayerRecorder::execute(const vk::raii::CommandBuffer& primary, const std::uint32_t frame_index, const LayerPass& pass, const std::span<const Layer> layers, profiler::Profiler* frame_profiler) {
+    auto& slots = frames[frame_index];
+    while (slots.size() < layers.size()) {
+        LayerSlot slot{};
+        slot.pool = vk::raii::CommandPool(*device, vk::CommandPoolCreateInfo{
+                                                       .flags            = vk::CommandPoolCreateFlagBits::eTransient,
+                                                       .queueFamilyIndex = queue_family,
+                                                   });
+
+        auto cmds = vk::raii::CommandBuffers(*device, vk::CommandBufferAllocateInfo{
+                                                          .commandPool        = *slot.pool,
+                                                          .level              = vk::CommandBufferLevel::eSecondary,
+                                                          .commandBufferCount = 1,
+                                                      });
+        slot.cmd = std::move(cmds.front());
+        slots.push_back(std::move(slot));
+    }
+
+    // ========================================================================
+    // GPU scopes are claimed here, in layer order, because the profiler's
+    // bookkeeping is main-thread only; workers just write the timestamps.
+    // ========================================================================
+    std::vector<profiler::ReservedGpuScope> scopes(layers.size());
+    if (frame_profiler) {
+        for (std::size_t i = 0; i < layers.size(); ++i) scopes[i] = frame_profiler->reserve_gpu_scope(layers[i].name);
+    }
+
+    const vk::CommandBufferInheritanceRenderingInfo inherited_rendering{
+        .colorAttachmentCount    = 1,
+        .pColorAttachmentFormats = &pass.color_format,
+        .depthAttachmentFormat   = pass.depth_format,
+        .rasterizationSamples    = vk::SampleCountFlagBits::e1,
+    };
+    const vk::CommandBufferInheritanceInfo inheritance{.pNext = &inherited_rendering};
+
+    workers->parallel_for(static_cast<std::uint32_t>(layers.size()), [&](const std::uint32_t i) {
+        LayerSlot& slot = slots[i];
+        slot.pool.reset();
+        slot.cmd.begin(vk::CommandBufferBeginInfo{
+            .flags            = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+            .pInheritanceInfo = &inheritance,
+        });
+        {
+            profiler::GpuScope scope{frame_profiler, slot.cmd, scopes[i]};
+            slot.cmd.setViewport(0, {pass.viewport});
+            slot.cmd.setScissor(0, {pass.scissor});
+            layers[i].record(slot.cmd);
+        }
+        slot.cmd.end();
+    });
+
+    // ========================================================================
+    // Primary: the rendering scope holds nothing but the executes.
+    // ========================================================================
+    vk::RenderingInfo rendering = pass.rendering;
+    rendering.flags |= vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+
+    primary.beginRendering(rendering);
+    if (!layers.empty()) {
+        std::vector<vk::CommandBuffer> secondaries;
+        secondaries.reserve(layers.size());
+        for (std::size_t i = 0; i < layers.size(); ++i) secondaries.push_back(*slots[i].cmd);
+        primary.executeCommands(secondaries);
+    }
+    primary.endRendering();
+}
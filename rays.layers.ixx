@@ -0,0 +1,69 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.layers;
+// ============================================================================
+// Render layers: each draw layer of a rendering scope (rays, grid, overlays)
+// records its own secondary command buffer on the worker pool; the primary
+// only begins rendering, executes them in order, and ends it.
+// ============================================================================
+import pngp.vis.rays.jobs;
+import pngp.vis.rays.profiler;
+import std;
+
+namespace pngp::vis::rays::layers {
+    // ========================================================================
+    // One layer. record() runs on a worker with viewport and scissor already
+    // set; it must only read state that stays fixed while the frame records.
+    // ========================================================================
+    export struct Layer {
+        const char* name = "";
+        std::function<void(const vk::raii::CommandBuffer&)> record;
+    };
+
+    // ========================================================================
+    // Rendering scope the layers draw into. rendering.flags gets
+    // eContentsSecondaryCommandBuffers added; formats must match its
+    // attachments.
+    // ========================================================================
+    export struct LayerPass {
+        vk::RenderingInfo rendering{};
+        vk::Format color_format = vk::Format::eUndefined;
+        vk::Format depth_format = vk::Format::eUndefined;
+        vk::Viewport viewport{};
+        vk::Rect2D scissor{};
+    };
+
+    export class LayerRecorder {
+    public:
+        // ====================================================================
+        // Record every layer in parallel, then begin rendering on the
+        // primary, execute them in layer order and end rendering. A
+        // profiler, when given, gets one GPU scope per layer.
+        // ====================================================================
+        void execute(const vk::raii::CommandBuffer& primary, std::uint32_t frame_index, const LayerPass& pass, std::span<const Layer> layers, profiler::Profiler* frame_profiler = nullptr);
+
+        LayerRecorder(const vk::raii::Device& device, std::uint32_t queue_family, std::shared_ptr<jobs::ThreadPool> workers, std::uint32_t frames_in_flight);
+        ~LayerRecorder()                               = default;
+        LayerRecorder(const LayerRecorder&)            = delete;
+        LayerRecorder& operator=(const LayerRecorder&) = delete;
+        LayerRecorder(LayerRecorder&&)                 = delete;
+        LayerRecorder& operator=(LayerRecorder&&)      = delete;
+
+    private:
+        // ====================================================================
+        // One pool per layer and frame slot: a layer is recorded by a single
+        // thread at a time, and resetting the pool recycles its buffer once
+        // the slot's last frame is done.
+        // ====================================================================
+        struct LayerSlot {
+            vk::raii::CommandPool pool{nullptr};
+            vk::raii::CommandBuffer cmd{nullptr};
+        };
+
+        const vk::raii::Device* device = nullptr;
+        std::uint32_t queue_family     = 0;
+        std::shared_ptr<jobs::ThreadPool> workers;
+        // [frame][layer], grown on demand.
+        std::vector<std::vector<LayerSlot>> frames;
+    };
+} // namespace pngp::vis::rays::layers
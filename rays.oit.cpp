@@ -0,0 +1,192 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.oit;
+// ============================================================================
+// Order-independent transparency implementation.
+// ============================================================================
+import std;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+
+pngp::vis::rays::pipelines::DescriptorBindings pngp::vis::rays::oit::bindings() {
+    return {
+        {.binding = 0, .descriptorType = vk::DescriptorType::eSampledImage, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eFragment},
+        {.binding = 1, .descriptorType = vk::DescriptorType::eSampledImage, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eFragment},
+    };
+}
+
+// ============================================================================
+// Constructor: set layout and pool for one live target plus one retired
+// per frame in flight; the images wait for the first extent.
+// ============================================================================
+pngp::vis::rays::oit::OitTargets::OitTargets(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const std::uint32_t frames_in_flight) : physical_device(&physical_device), device(&device), retire(frames_in_flight) {
+    const vk::DescriptorPoolSize pool_size{
+        .type            = vk::DescriptorType::eSampledImage,
+        .descriptorCount = 2 * (frames_in_flight + 1),
+    };
+    descriptor_pool = vk::raii::DescriptorPool(device, vk::DescriptorPoolCreateInfo{
+                                                           .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                                                           .maxSets       = frames_in_flight + 1,
+                                                           .poolSizeCount = 1,
+                                                           .pPoolSizes    = &pool_size,
+                                                       });
+
+    const auto set_bindings = bindings();
+
+    set_layout = vk::raii::DescriptorSetLayout(device, vk::DescriptorSetLayoutCreateInfo{
+                                                           .bindingCount = static_cast<std::uint32_t>(set_bindings.size()),
+                                                           .pBindings    = set_bindings.data(),
+                                                       });
+}
+
+void pngp::vis::rays::oit::OitTargets::begin_frame(const std::uint32_t frame_index) {
+    retire.collect(frame_index);
+}
+
+// ============================================================================
+// A new extent gets new images and a new set; the old ones may still be
+// read by frames in flight, so they are retired rather than destroyed.
+// ============================================================================
+void pngp::vis::rays::oit::OitTargets::resize(const std::uint32_t frame_index, const vk::Extent2D new_extent) {
+    if (*target.set) retire.retire(frame_index, std::move(target));
+
+    constexpr auto usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+    Target next{};
+    next.accum     = upload::create_image(*physical_device, *device, new_extent, accum_format, usage, vk::ImageAspectFlagBits::eColor);
+    next.revealage = upload::create_image(*physical_device, *device, new_extent, revealage_format, usage, vk::ImageAspectFlagBits::eColor);
+
+    const vk::DescriptorSetLayout layout = *set_layout;
+
+    auto sets = vk::raii::DescriptorSets(*device, vk::DescriptorSetAllocateInfo{
+                                                      .descriptorPool     = *descriptor_pool,
+                                                      .descriptorSetCount = 1,
+                                                      .pSetLayouts        = &layout,
+                                                  });
+    next.set = std::move(sets.front());
+
+    const std::array images{
+        vk::DescriptorImageInfo{.imageView = *next.accum.view, .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal},
+        vk::DescriptorImageInfo{.imageView = *next.revealage.view, .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal},
+    };
+    std::array<vk::WriteDescriptorSet, images.size()> writes{};
+    for (std::uint32_t b = 0; b < images.size(); ++b) {
+        writes[b] = vk::WriteDescriptorSet{
+            .dstSet          = *next.set,
+            .dstBinding      = b,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eSampledImage,
+            .pImageInfo      = &images[b],
+        };
+    }
+    device->updateDescriptorSets(writes, {});
+
+    target = std::move(next);
+    extent = new_extent;
+}
+
+// ============================================================================
+// Both targets are cleared, so their previous contents are discarded
+// (eUndefined); the barrier still waits for the last composite's reads.
+// Depth keeps its layout and is neither written nor stored.
+// ============================================================================
+void pngp::vis::rays::oit::OitTargets::begin_accumulate(const vk::raii::CommandBuffer& cmd, const std::uint32_t frame_index, const vk::Extent2D new_extent, const vk::ImageView depth_view) {
+    if (new_extent != extent || !*target.set) resize(frame_index, new_extent);
+
+    const auto to_attachment = [](const vk::Image image) {
+        return vk::ImageMemoryBarrier2{
+            .srcStageMask     = vk::PipelineStageFlagBits2::eFragmentShader,
+            .dstStageMask     = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .dstAccessMask    = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+            .oldLayout        = vk::ImageLayout::eUndefined,
+            .newLayout        = vk::ImageLayout::eColorAttachmentOptimal,
+            .image            = image,
+            .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
+        };
+    };
+    const std::array barriers{to_attachment(*target.accum.image), to_attachment(*target.revealage.image)};
+
+    const vk::MemoryBarrier2 depth_barrier{
+        .srcStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+        .srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+        .dstStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+        .dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentRead,
+    };
+
+    cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount      = 1,
+        .pMemoryBarriers         = &depth_barrier,
+        .imageMemoryBarrierCount = static_cast<std::uint32_t>(barriers.size()),
+        .pImageMemoryBarriers    = barriers.data(),
+    });
+
+    // ========================================================================
+    // Accumulation starts at zero, revealage at one (fully revealed).
+    // ========================================================================
+    vk::ClearValue clear_accum{};
+    clear_accum.color = vk::ClearColorValue{std::array{0.f, 0.f, 0.f, 0.f}};
+
+    vk::ClearValue clear_revealage{};
+    clear_revealage.color = vk::ClearColorValue{std::array{1.f, 0.f, 0.f, 0.f}};
+
+    const std::array colors{
+        vk::RenderingAttachmentInfo{
+            .imageView   = *target.accum.view,
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp      = vk::AttachmentLoadOp::eClear,
+            .storeOp     = vk::AttachmentStoreOp::eStore,
+            .clearValue  = clear_accum,
+        },
+        vk::RenderingAttachmentInfo{
+            .imageView   = *target.revealage.view,
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp      = vk::AttachmentLoadOp::eClear,
+            .storeOp     = vk::AttachmentStoreOp::eStore,
+            .clearValue  = clear_revealage,
+        },
+    };
+
+    const vk::RenderingAttachmentInfo depth{
+        .imageView   = depth_view,
+        .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        .loadOp      = vk::AttachmentLoadOp::eLoad,
+        .storeOp     = vk::AttachmentStoreOp::eNone,
+    };
+
+    cmd.beginRendering(vk::RenderingInfo{
+        .renderArea           = {{0, 0}, extent},
+        .layerCount           = 1,
+        .colorAttachmentCount = static_cast<std::uint32_t>(colors.size()),
+        .pColorAttachments    = colors.data(),
+        .pDepthAttachment     = &depth,
+    });
+}
+
+void pngp::vis::rays::oit::OitTargets::end_accumulate(const vk::raii::CommandBuffer& cmd) {
+    cmd.endRendering();
+
+    const auto to_shader_read = [](const vk::Image image) {
+        return vk::ImageMemoryBarrier2{
+            .srcStageMask     = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .srcAccessMask    = vk::AccessFlagBits2::eColorAttachmentWrite,
+            .dstStageMask     = vk::PipelineStageFlagBits2::eFragmentShader,
+            .dstAccessMask    = vk::AccessFlagBits2::eShaderSampledRead,
+            .oldLayout        = vk::ImageLayout::eColorAttachmentOptimal,
+            .newLayout        = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .image            = image,
+            .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
+        };
+    };
+    const std::array barriers{to_shader_read(*target.accum.image), to_shader_read(*target.revealage.image)};
+
+    cmd.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = static_cast<std::uint32_t>(barriers.size()),
+        .pImageMemoryBarriers    = barriers.data(),
+    });
+}
+
+void pngp::vis::rays::oit::OitTargets::composite(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& composite_pipeline) const {
+    if (!*target.set) return;
+
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *composite_pipeline.layout, 0, {*target.set}, {});
+    cmd.draw(3, 1, 0, 0);
+}
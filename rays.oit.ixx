@@ -0,0 +1,74 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.oit;
+// ============================================================================
+// Weighted blended order-independent transparency (McGuire & Bavoil 2013):
+// translucent ray segments add into an accumulation and a revealage target
+// in one unsorted pass, at constant cost per fragment, and a fullscreen
+// composite resolves them over the scene color.
+// ============================================================================
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+import std;
+
+namespace pngp::vis::rays::oit {
+    // Weighted color + weight sum; fp16 blending is universally supported.
+    export inline constexpr vk::Format accum_format = vk::Format::eR16G16B16A16Sfloat;
+    // Product of (1 - alpha) over the pixel's fragments.
+    export inline constexpr vk::Format revealage_format = vk::Format::eR16Sfloat;
+
+    // ========================================================================
+    // Set 0 of the composite pipeline: accumulation (0) and revealage (1),
+    // read with texel loads (no sampler).
+    // ========================================================================
+    export [[nodiscard]] pipelines::DescriptorBindings bindings();
+
+    export class OitTargets {
+    public:
+        // Frame slot's last frame is done: free targets retired by a resize.
+        void begin_frame(std::uint32_t frame_index);
+        // ====================================================================
+        // Outside rendering: (re)create the targets for the extent, order
+        // the scene's depth writes before this pass's depth tests, and begin
+        // rendering into both targets (cleared) with the scene depth loaded
+        // for testing only. The caller binds a pipeline whose description
+        // sets oit_revealage_format and draws.
+        // ====================================================================
+        void begin_accumulate(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index, vk::Extent2D extent, vk::ImageView depth_view);
+        // End rendering and make both targets readable by the composite.
+        void end_accumulate(const vk::raii::CommandBuffer& cmd);
+        // ====================================================================
+        // Inside rendering over the color target with the composite pipeline
+        // bound: one fullscreen triangle, alpha-blended.
+        // ====================================================================
+        void composite(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& composite_pipeline) const;
+
+        OitTargets(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, std::uint32_t frames_in_flight);
+        ~OitTargets()                            = default;
+        OitTargets(const OitTargets&)            = delete;
+        OitTargets& operator=(const OitTargets&) = delete;
+        OitTargets(OitTargets&&)                 = delete;
+        OitTargets& operator=(OitTargets&&)      = delete;
+
+    private:
+        // Both targets for one extent and the set that binds them.
+        struct Target {
+            upload::GpuImage accum;
+            upload::GpuImage revealage;
+            vk::raii::DescriptorSet set{nullptr};
+        };
+
+        void resize(std::uint32_t frame_index, vk::Extent2D new_extent);
+
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        const vk::raii::Device* device                  = nullptr;
+
+        vk::raii::DescriptorPool descriptor_pool{nullptr};
+        vk::raii::DescriptorSetLayout set_layout{nullptr};
+        Target target;
+        vk::Extent2D extent{};
+
+        // Declared last: retired targets go before the descriptor pool.
+        upload::RetireQueue retire;
+    };
+} // namespace pngp::vis::rays::oit
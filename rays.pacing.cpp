@@ -0,0 +1,133 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.pacing;
+// ============================================================================
+// Frame pacing implementation.
+// ============================================================================
+import std;
+
+namespace {
+    // The watcher re-checks its stop token this often while a frame runs.
+    constexpr std::uint64_t watch_timeout_ns = 50'000'000;
+    // Fences cannot be waited on beside the main thread's resets, so the
+    // watcher polls their status; this bounds the added latency error.
+    constexpr std::chrono::microseconds fence_poll{250};
+} // namespace
+
+pngp::vis::rays::pacing::FramePacer::FramePacer(const vk::raii::Device& device, const PacerInfo& info) : device(&device), info(info) {
+    if (info.frames_in_flight == 0) throw std::invalid_argument("FramePacer: at least one frame in flight");
+    this->info.latency_window = std::max(1u, info.latency_window);
+
+    if (info.sync == PacerSync::timeline) {
+        vk::SemaphoreTypeCreateInfo type{
+            .semaphoreType = vk::SemaphoreType::eTimeline,
+            .initialValue  = 0,
+        };
+        timeline = vk::raii::Semaphore(device, vk::SemaphoreCreateInfo{.pNext = &type});
+    } else {
+        for (std::uint32_t i = 0; i < info.frames_in_flight; ++i) fences.emplace_back(device, vk::FenceCreateInfo{});
+        fence_values.assign(info.frames_in_flight, 0);
+    }
+    watcher = std::jthread([this](const std::stop_token& stop) { watch(stop); });
+}
+
+void pngp::vis::rays::pacing::FramePacer::wait_for_slot(const std::uint64_t frame_number) const {
+    if (frame_number < info.frames_in_flight) return;
+    if (info.sync == PacerSync::fences) {
+        (void) device->waitForFences(*fences[slot(frame_number)], true, std::numeric_limits<std::uint64_t>::max());
+        return;
+    }
+    const std::uint64_t value     = frame_number + 1 - info.frames_in_flight;
+    const vk::Semaphore semaphore = *timeline;
+    (void) device->waitSemaphores(vk::SemaphoreWaitInfo{.semaphoreCount = 1, .pSemaphores = &semaphore, .pValues = &value}, std::numeric_limits<std::uint64_t>::max());
+}
+
+// ============================================================================
+// A fence signal, like the timeline signal, covers every command submitted
+// before it, so a signalled slot fence completes all lower frame values.
+// ============================================================================
+void pngp::vis::rays::pacing::FramePacer::submit(const vk::raii::Queue& queue, vk::SubmitInfo2 submit_info, const std::uint64_t frame_number) {
+    if (info.sync == PacerSync::fences) {
+        const std::uint32_t slot_index = slot(frame_number);
+        std::lock_guard lock(mutex);
+        device->resetFences(*fences[slot_index]);
+        fence_values[slot_index] = frame_number + 1;
+        queue.submit2(submit_info, *fences[slot_index]);
+        return;
+    }
+
+    std::vector<vk::SemaphoreSubmitInfo> signals(submit_info.pSignalSemaphoreInfos, submit_info.pSignalSemaphoreInfos + submit_info.signalSemaphoreInfoCount);
+    signals.push_back(vk::SemaphoreSubmitInfo{
+        .semaphore = *timeline,
+        .value     = frame_number + 1,
+        .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    });
+    submit_info.signalSemaphoreInfoCount = static_cast<std::uint32_t>(signals.size());
+    submit_info.pSignalSemaphoreInfos    = signals.data();
+    queue.submit2(submit_info);
+}
+
+void pngp::vis::rays::pacing::FramePacer::submitted(const std::uint64_t frame_number, const std::optional<Clock::time_point> input_time) {
+    if (!input_time) return;
+    {
+        std::lock_guard lock(mutex);
+        watched.push_back({frame_number + 1, *input_time});
+    }
+    frame_submitted.notify_one();
+}
+
+std::uint64_t pngp::vis::rays::pacing::FramePacer::completed() const {
+    if (info.sync == PacerSync::timeline) return timeline.getCounterValue();
+
+    std::lock_guard lock(mutex);
+    std::uint64_t value = 0;
+    for (std::size_t i = 0; i < fences.size(); ++i) {
+        if (fence_values[i] > value && fences[i].getStatus() == vk::Result::eSuccess) value = fence_values[i];
+    }
+    return value;
+}
+
+pngp::vis::rays::pacing::LatencyStats pngp::vis::rays::pacing::FramePacer::latency() const {
+    std::lock_guard lock(mutex);
+    return stats;
+}
+
+// ============================================================================
+// Watcher: waits on each input frame's value in submit order and stamps
+// the wake-up, so a frame is timed when it completes rather than when the
+// main loop next looks (which may be after an on-demand idle).
+// ============================================================================
+void pngp::vis::rays::pacing::FramePacer::watch(const std::stop_token& stop) {
+    const vk::Semaphore semaphore = info.sync == PacerSync::timeline ? *timeline : vk::Semaphore{};
+    while (!stop.stop_requested()) {
+        Watched next{};
+        {
+            std::unique_lock lock(mutex);
+            if (!frame_submitted.wait(lock, stop, [this] { return !watched.empty(); })) return;
+            next = watched.front();
+        }
+
+        if (info.sync == PacerSync::fences) {
+            while (completed() < next.value) {
+                if (stop.stop_requested()) return;
+                std::this_thread::sleep_for(fence_poll);
+            }
+        } else {
+            const vk::SemaphoreWaitInfo wait{.semaphoreCount = 1, .pSemaphores = &semaphore, .pValues = &next.value};
+            while (device->waitSemaphores(wait, watch_timeout_ns) == vk::Result::eTimeout) {
+                if (stop.stop_requested()) return;
+            }
+        }
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - next.input_time).count();
+
+        std::lock_guard lock(mutex);
+        watched.pop_front();
+        window_ms.push_back(ms);
+        if (window_ms.size() > info.latency_window) window_ms.pop_front();
+
+        stats.last_ms    = ms;
+        stats.average_ms = std::ranges::fold_left(window_ms, 0.0, std::plus{}) / static_cast<double>(window_ms.size());
+        stats.max_ms     = std::ranges::max(window_ms);
+        stats.samples    = window_ms.size();
+    }
+}
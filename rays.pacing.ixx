@@ -0,0 +1,96 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.pacing;
+// ============================================================================
+// Frame pacing on one timeline semaphore: frame n's submit signals value
+// n + 1, and frame n may reuse its slot once value n + 1 - frames_in_flight
+// is reached. Fewer frames in flight sample input closer to the GPU (lower
+// latency); more keep the queue fed (higher throughput). A watcher thread
+// times input-carrying frames from their first input event to completion.
+// Devices not known to enable timeline semaphores pace on one fence per
+// slot instead, with the same frame values.
+// ============================================================================
+import std;
+
+namespace pngp::vis::rays::pacing {
+    export using Clock = std::chrono::steady_clock;
+
+    // ========================================================================
+    // Rolling latency over the last latency_window frames that carried input.
+    // ========================================================================
+    export struct LatencyStats {
+        double last_ms      = 0.0;
+        double average_ms   = 0.0;
+        double max_ms       = 0.0;
+        std::size_t samples = 0;
+    };
+
+    // timeline needs the device's timelineSemaphore feature (enabled by
+    // upload::create_device); fences work on any device.
+    export enum class PacerSync { timeline, fences };
+
+    export struct PacerInfo {
+        std::uint32_t frames_in_flight = 2;
+        std::uint32_t latency_window   = 120;
+        PacerSync sync                 = PacerSync::timeline;
+    };
+
+    export class FramePacer {
+    public:
+        // ====================================================================
+        // Block until the frame that last used frame_number's slot has
+        // completed on the GPU; its slot resources are then free.
+        // ====================================================================
+        void wait_for_slot(std::uint64_t frame_number) const;
+        // Submit the frame's work: frame_number + 1 is reached once every
+        // earlier command on the queue has completed.
+        void submit(const vk::raii::Queue& queue, vk::SubmitInfo2 submit_info, std::uint64_t frame_number);
+        // ====================================================================
+        // After the frame's submit: a frame carrying input (earliest event
+        // time) is timed until its signal. Frames are passed in order.
+        // ====================================================================
+        void submitted(std::uint64_t frame_number, std::optional<Clock::time_point> input_time);
+        // Highest frame count the GPU has completed (frames 0..n-1 done).
+        [[nodiscard]] std::uint64_t completed() const;
+        [[nodiscard]] LatencyStats latency() const;
+
+        [[nodiscard]] std::uint32_t slot(const std::uint64_t frame_number) const noexcept {
+            return static_cast<std::uint32_t>(frame_number % info.frames_in_flight);
+        }
+        [[nodiscard]] std::uint32_t frames_in_flight() const noexcept {
+            return info.frames_in_flight;
+        }
+
+        FramePacer(const vk::raii::Device& device, const PacerInfo& info);
+        ~FramePacer()                            = default;
+        FramePacer(const FramePacer&)            = delete;
+        FramePacer& operator=(const FramePacer&) = delete;
+        FramePacer(FramePacer&&)                 = delete;
+        FramePacer& operator=(FramePacer&&)      = delete;
+
+    private:
+        struct Watched {
+            std::uint64_t value = 0;
+            Clock::time_point input_time{};
+        };
+
+        void watch(const std::stop_token& stop);
+
+        const vk::raii::Device* device = nullptr;
+        PacerInfo info{};
+        vk::raii::Semaphore timeline{nullptr};
+        // PacerSync::fences: one per slot and the frame value it signals.
+        // Guarded by mutex, which the watcher's status checks share.
+        std::vector<vk::raii::Fence> fences;
+        std::vector<std::uint64_t> fence_values;
+
+        mutable std::mutex mutex;
+        std::condition_variable_any frame_submitted;
+        std::deque<Watched> watched;
+        std::deque<double> window_ms;
+        LatencyStats stats{};
+
+        // Declared last so the watcher stops before the semaphore goes.
+        std::jthread watcher;
+    };
+} // namespace pngp::vis::rays::pacing
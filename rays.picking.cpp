@@ -0,0 +1,393 @@
+module pngp.vis.rays.picking;
+// ============================================================================
+// Ray picking implementation.
+// ============================================================================
+import std;
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+
+// ============================================================================
+// Translation-unit helpers (vector math, BVH build, cone tests).
+// ============================================================================
+namespace {
+    using pngp::vis::rays::picking::Bvh;
+    using pngp::vis::rays::picking::BvhNode;
+    using pngp::vis::rays::picking::PickRay;
+
+    using Vec3 = std::array<float, 3>;
+    using Mat4 = std::array<float, 16>;
+
+    // Segments tested together in a leaf; also the chunk-level leaf size.
+    constexpr std::uint32_t lanes         = 8;
+    constexpr std::uint32_t top_leaf_size = 4;
+    constexpr std::size_t max_stack_depth = 64;
+
+    struct Aabb {
+        Vec3 lo{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+        Vec3 hi{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+        void grow(const Aabb& b) {
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = std::min(lo[a], b.lo[a]);
+                hi[a] = std::max(hi[a], b.hi[a]);
+            }
+        }
+    };
+
+    float dot(const Vec3& a, const Vec3& b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    Vec3 sub(const Vec3& a, const Vec3& b) {
+        return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+    }
+
+    std::optional<Vec3> normalized(const Vec3& v) {
+        const float len = std::sqrt(dot(v, v));
+        if (!(len > 0.0f)) return std::nullopt;
+        return Vec3{v[0] / len, v[1] / len, v[2] / len};
+    }
+
+    // =========================================================================
+    // Column-major 4x4 inverse by cofactors; empty when singular.
+    // =========================================================================
+    std::optional<Mat4> invert(const Mat4& m) {
+        Mat4 inv{};
+        inv[0]  = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+        inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+        inv[8]  = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+        inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+        inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+        inv[5]  = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+        inv[9]  = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+        inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+        inv[2]  = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+        inv[6]  = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+        inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+        inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+        inv[3]  = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+        inv[7]  = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+        inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+        inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+        const float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+        if (det == 0.0f || !std::isfinite(det)) return std::nullopt;
+        for (float& v : inv) v /= det;
+        return inv;
+    }
+
+    std::array<float, 4> transform(const Mat4& m, const std::array<float, 4>& v) {
+        std::array<float, 4> out{};
+        for (int r = 0; r < 4; ++r) out[r] = m[r] * v[0] + m[4 + r] * v[1] + m[8 + r] * v[2] + m[12 + r] * v[3];
+        return out;
+    }
+
+    // =========================================================================
+    // Window pixel to world point on the depth = z plane. The scene pass
+    // flips the viewport, so NDC y points up.
+    // =========================================================================
+    std::optional<Vec3> unproject(const Mat4& inv_view_proj, const std::array<float, 2> viewport, const float x, const float y, const float z) {
+        const auto p = transform(inv_view_proj, {2.0f * x / viewport[0] - 1.0f, 1.0f - 2.0f * y / viewport[1], z, 1.0f});
+        if (std::abs(p[3]) < 1e-12f) return std::nullopt;
+        return Vec3{p[0] / p[3], p[1] / p[3], p[2] / p[3]};
+    }
+
+    // =========================================================================
+    // Median split on the widest centroid axis. Depth stays ~log2(n / leaf),
+    // well inside the fixed traversal stack.
+    // =========================================================================
+    void build_node(Bvh& bvh, const std::span<const Aabb> boxes, const std::uint32_t begin, const std::uint32_t end, const std::uint32_t leaf_size) {
+        const auto index = static_cast<std::uint32_t>(bvh.nodes.size());
+        bvh.nodes.emplace_back();
+
+        Aabb bounds{};
+        Aabb centroids{};
+        for (std::uint32_t i = begin; i < end; ++i) {
+            const Aabb& b = boxes[bvh.order[i]];
+            bounds.grow(b);
+            const Vec3 c{0.5f * (b.lo[0] + b.hi[0]), 0.5f * (b.lo[1] + b.hi[1]), 0.5f * (b.lo[2] + b.hi[2])};
+            centroids.grow({c, c});
+        }
+        bvh.nodes[index].lo = bounds.lo;
+        bvh.nodes[index].hi = bounds.hi;
+
+        if (end - begin <= leaf_size) {
+            bvh.nodes[index].first = begin;
+            bvh.nodes[index].count = end - begin;
+            return;
+        }
+
+        const Vec3 extent = sub(centroids.hi, centroids.lo);
+        const int axis    = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : (extent[1] >= extent[2] ? 1 : 2);
+        const auto mid    = begin + (end - begin) / 2;
+        std::nth_element(bvh.order.begin() + begin, bvh.order.begin() + mid, bvh.order.begin() + end, [&](const std::uint32_t a, const std::uint32_t b) { return boxes[a].lo[axis] + boxes[a].hi[axis] < boxes[b].lo[axis] + boxes[b].hi[axis]; });
+
+        build_node(bvh, boxes, begin, mid, leaf_size);
+        bvh.nodes[index].first = static_cast<std::uint32_t>(bvh.nodes.size());
+        build_node(bvh, boxes, mid, end, leaf_size);
+    }
+
+    Bvh build_bvh(const std::span<const Aabb> boxes, const std::uint32_t leaf_size) {
+        Bvh bvh{};
+        if (boxes.empty()) return bvh;
+        bvh.order.resize(boxes.size());
+        std::iota(bvh.order.begin(), bvh.order.end(), 0u);
+        bvh.nodes.reserve(2 * (boxes.size() + leaf_size - 1) / leaf_size);
+        build_node(bvh, boxes, 0, static_cast<std::uint32_t>(boxes.size()), leaf_size);
+        return bvh;
+    }
+
+    Bvh build_chunk_bvh(const pngp::vis::rays::dataset::RayFile& file, const std::uint32_t chunk_index) {
+        const auto view       = file.chunk(chunk_index);
+        const std::uint32_t n = view.record->ray_count;
+
+        std::vector<Aabb> boxes(n);
+        for (std::uint32_t i = 0; i < n; ++i) {
+            const Vec3 o{view.origin_x[i], view.origin_y[i], view.origin_z[i]};
+            const Vec3 d{view.dir_x[i], view.dir_y[i], view.dir_z[i]};
+            for (int a = 0; a < 3; ++a) {
+                const float p0 = o[a] + d[a] * view.t_min[i];
+                const float p1 = o[a] + d[a] * view.t_max[i];
+                boxes[i].lo[a] = std::min(p0, p1);
+                boxes[i].hi[a] = std::max(p0, p1);
+            }
+        }
+        return build_bvh(boxes, lanes);
+    }
+
+    // =========================================================================
+    // Conservative cone-vs-box test: any point the cone accepts inside the
+    // box lies within slope * (farthest corner distance) of the axis, so the
+    // axis has to hit the box grown by that radius.
+    // =========================================================================
+    bool cone_hits_box(const PickRay& ray, const Vec3& inv_dir, const BvhNode& node, const float slope) {
+        float far2 = 0.0f;
+        for (int a = 0; a < 3; ++a) {
+            const float d = std::max(std::abs(ray.origin[a] - node.lo[a]), std::abs(ray.origin[a] - node.hi[a]));
+            far2 += d * d;
+        }
+        const float radius = slope * std::sqrt(far2);
+
+        float t_enter = 0.0f;
+        float t_exit  = std::numeric_limits<float>::max();
+        for (int a = 0; a < 3; ++a) {
+            const float t0 = (node.lo[a] - radius - ray.origin[a]) * inv_dir[a];
+            const float t1 = (node.hi[a] + radius - ray.origin[a]) * inv_dir[a];
+            t_enter        = std::max(t_enter, std::min(t0, t1));
+            t_exit         = std::min(t_exit, std::max(t0, t1));
+        }
+        return t_enter <= t_exit;
+    }
+
+    // =========================================================================
+    // Depth-first walk; `best` shrinks the cone as closer hits are found.
+    // =========================================================================
+    template <typename LeafFn>
+    void traverse(const Bvh& bvh, const PickRay& ray, const Vec3& inv_dir, const float& best, LeafFn&& leaf) {
+        if (bvh.nodes.empty()) return;
+        std::array<std::uint32_t, max_stack_depth> stack{};
+        std::size_t top = 0;
+        stack[top++]    = 0;
+        while (top > 0) {
+            const std::uint32_t i = stack[--top];
+            const BvhNode& node   = bvh.nodes[i];
+            if (!cone_hits_box(ray, inv_dir, node, best)) continue;
+            if (node.count > 0) {
+                leaf(std::span{bvh.order}.subspan(node.first, node.count));
+                continue;
+            }
+            stack[top++] = node.first;
+            stack[top++] = i + 1;
+        }
+    }
+
+    // =========================================================================
+    // Closest approach between the cursor ray and up to `lanes` segments at
+    // once. Inputs are gathered into structure-of-arrays form and every lane
+    // runs the same branch-free math, so the loops vectorize.
+    // =========================================================================
+    struct SegmentLanes {
+        std::array<float, lanes> p0x{}, p0y{}, p0z{};
+        std::array<float, lanes> ex{}, ey{}, ez{};
+    };
+
+    void segment_offsets(const PickRay& ray, const SegmentLanes& s, std::array<float, lanes>& offset, std::array<float, lanes>& distance) {
+        const float dx = ray.direction[0];
+        const float dy = ray.direction[1];
+        const float dz = ray.direction[2];
+        for (std::uint32_t l = 0; l < lanes; ++l) {
+            const float wx = s.p0x[l] - ray.origin[0];
+            const float wy = s.p0y[l] - ray.origin[1];
+            const float wz = s.p0z[l] - ray.origin[2];
+            const float a  = s.ex[l] * s.ex[l] + s.ey[l] * s.ey[l] + s.ez[l] * s.ez[l];
+            const float b  = dx * s.ex[l] + dy * s.ey[l] + dz * s.ez[l];
+            const float d  = dx * wx + dy * wy + dz * wz;
+            const float e  = s.ex[l] * wx + s.ey[l] * wy + s.ez[l] * wz;
+
+            // Lines' closest parameters, clamped to the segment and the
+            // forward half of the ray, then the segment side refined.
+            const float denom = a - b * b;
+            float u           = denom > 1e-12f ? (b * d - e) / denom : 0.0f;
+            u                 = std::clamp(u, 0.0f, 1.0f);
+            const float t     = std::max(0.0f, d + u * b);
+            u                 = a > 1e-12f ? std::clamp((t * b - e) / a, 0.0f, 1.0f) : 0.0f;
+
+            const float cx = wx + u * s.ex[l] - t * dx;
+            const float cy = wy + u * s.ey[l] - t * dy;
+            const float cz = wz + u * s.ez[l] - t * dz;
+            const float r  = std::sqrt(cx * cx + cy * cy + cz * cz);
+            offset[l]      = t > 1e-6f ? r / t : std::numeric_limits<float>::max();
+            distance[l]    = t;
+        }
+    }
+} // namespace
+
+std::optional<pngp::vis::rays::picking::PickRay> pngp::vis::rays::picking::cursor_ray(const vk::math::mat4& view_proj, const std::array<float, 2> viewport, const std::array<float, 2> cursor, const float radius_px) {
+    static_assert(sizeof(vk::math::mat4) == sizeof(Mat4));
+    if (!(viewport[0] > 0.0f && viewport[1] > 0.0f)) return std::nullopt;
+    const auto inv = invert(std::bit_cast<Mat4>(view_proj));
+    if (!inv) return std::nullopt;
+
+    // Mid-depth rather than the far plane so infinite projections work too.
+    auto direction_at = [&](const float x, const float y) -> std::optional<std::pair<Vec3, Vec3>> {
+        const auto near_point = unproject(*inv, viewport, x, y, 0.0f);
+        const auto mid_point  = unproject(*inv, viewport, x, y, 0.5f);
+        if (!near_point || !mid_point) return std::nullopt;
+        const auto dir = normalized(sub(*mid_point, *near_point));
+        if (!dir) return std::nullopt;
+        return std::pair{*near_point, *dir};
+    };
+
+    const auto center = direction_at(cursor[0], cursor[1]);
+    const auto edge   = direction_at(cursor[0] + std::max(radius_px, 0.5f), cursor[1]);
+    if (!center || !edge) return std::nullopt;
+
+    const float cos_angle = std::clamp(dot(center->second, edge->second), 1e-6f, 1.0f);
+    PickRay ray{};
+    ray.origin    = center->first;
+    ray.direction = center->second;
+    ray.tolerance = std::sqrt(std::max(0.0f, 1.0f - cos_angle * cos_angle)) / cos_angle;
+    return ray;
+}
+
+std::optional<std::array<float, 2>> pngp::vis::rays::picking::project_point(const vk::math::mat4& view_proj, const std::array<float, 2> viewport, const std::array<float, 3>& point) {
+    const auto clip = transform(std::bit_cast<Mat4>(view_proj), {point[0], point[1], point[2], 1.0f});
+    if (clip[3] <= 1e-6f) return std::nullopt;
+    return std::array{(clip[0] / clip[3] + 1.0f) * 0.5f * viewport[0], (1.0f - clip[1] / clip[3]) * 0.5f * viewport[1]};
+}
+
+pngp::vis::rays::picking::RayAttributes pngp::vis::rays::picking::ray_attributes(const dataset::RayFile& file, const std::uint32_t chunk, const std::uint32_t ray) {
+    const auto view = file.chunk(chunk);
+    if (ray >= view.record->ray_count) throw std::out_of_range("ray_attributes: ray index outside chunk");
+
+    RayAttributes out{};
+    out.id        = view.record->first_ray + ray;
+    out.chunk     = chunk;
+    out.origin    = {view.origin_x[ray], view.origin_y[ray], view.origin_z[ray]};
+    out.direction = {view.dir_x[ray], view.dir_y[ray], view.dir_z[ray]};
+    out.t_min     = view.t_min[ray];
+    out.t_max     = view.t_max[ray];
+    out.color     = view.color[ray];
+    if (!view.pixel.empty()) out.pixel = std::array{view.pixel[ray] & 0xffffu, view.pixel[ray] >> 16};
+    if (!view.camera_id.empty()) out.camera_id = view.camera_id[ray];
+    return out;
+}
+
+// ============================================================================
+// RayPicker: background builder feeding a main-thread two-level index.
+// ============================================================================
+pngp::vis::rays::picking::RayPicker::RayPicker(std::shared_ptr<const dataset::RayFile> file, std::shared_ptr<jobs::ThreadPool> workers) : file(std::move(file)), workers(std::move(workers)) {
+    if (!this->file || !this->workers) throw std::invalid_argument("RayPicker: file and worker pool required");
+    thread = std::jthread([this](const std::stop_token& stop) { builder(stop); });
+}
+
+pngp::vis::rays::picking::RayPicker::~RayPicker() {
+    thread.request_stop();
+    work_available.notify_all();
+}
+
+void pngp::vis::rays::picking::RayPicker::add_chunk(const std::uint32_t chunk_index) {
+    {
+        std::lock_guard lock(mutex);
+        queued.push_back(chunk_index);
+    }
+    work_available.notify_one();
+}
+
+void pngp::vis::rays::picking::RayPicker::builder(const std::stop_token& stop) {
+    while (true) {
+        std::vector<std::uint32_t> batch;
+        {
+            std::unique_lock lock(mutex);
+            if (!work_available.wait(lock, stop, [this] { return !queued.empty(); })) return;
+            batch.swap(queued);
+        }
+
+        std::vector<ChunkBvh> built(batch.size());
+        workers->parallel_for(static_cast<std::uint32_t>(batch.size()), [&](const std::uint32_t i) {
+            built[i].chunk = batch[i];
+            built[i].bvh   = build_chunk_bvh(*file, batch[i]);
+        });
+
+        std::lock_guard lock(mutex);
+        for (auto& b : built) {
+            if (!b.bvh.nodes.empty()) finished.push_back(std::move(b));
+        }
+    }
+}
+
+void pngp::vis::rays::picking::RayPicker::update() {
+    {
+        std::lock_guard lock(mutex);
+        if (finished.empty()) return;
+        for (auto& b : finished) chunks.push_back(std::move(b));
+        finished.clear();
+    }
+
+    std::vector<Aabb> roots(chunks.size());
+    for (std::size_t i = 0; i < chunks.size(); ++i) roots[i] = {chunks[i].bvh.nodes[0].lo, chunks[i].bvh.nodes[0].hi};
+    top = build_bvh(roots, top_leaf_size);
+}
+
+std::optional<pngp::vis::rays::picking::PickHit> pngp::vis::rays::picking::RayPicker::pick(const PickRay& ray, const std::function<bool(const dataset::ChunkView&, std::uint32_t)>& accept) const {
+    if (chunks.empty() || !(ray.tolerance > 0.0f)) return std::nullopt;
+
+    const Vec3 inv_dir{1.0f / ray.direction[0], 1.0f / ray.direction[1], 1.0f / ray.direction[2]};
+    float best = ray.tolerance;
+    std::optional<PickHit> hit;
+
+    traverse(top, ray, inv_dir, best, [&](const std::span<const std::uint32_t> chunk_items) {
+        for (const std::uint32_t c : chunk_items) {
+            const ChunkBvh& chunk = chunks[c];
+            const auto view       = file->chunk(chunk.chunk);
+
+            traverse(chunk.bvh, ray, inv_dir, best, [&](const std::span<const std::uint32_t> rays) {
+                // Gather the leaf (padding repeats the last segment).
+                SegmentLanes s{};
+                for (std::uint32_t l = 0; l < lanes; ++l) {
+                    const std::uint32_t i = rays[std::min<std::size_t>(l, rays.size() - 1)];
+                    const float t0        = view.t_min[i];
+                    const float t1        = view.t_max[i];
+                    s.p0x[l]              = view.origin_x[i] + view.dir_x[i] * t0;
+                    s.p0y[l]              = view.origin_y[i] + view.dir_y[i] * t0;
+                    s.p0z[l]              = view.origin_z[i] + view.dir_z[i] * t0;
+                    s.ex[l]               = view.dir_x[i] * (t1 - t0);
+                    s.ey[l]               = view.dir_y[i] * (t1 - t0);
+                    s.ez[l]               = view.dir_z[i] * (t1 - t0);
+                }
+
+                std::array<float, lanes> offset{};
+                std::array<float, lanes> distance{};
+                segment_offsets(ray, s, offset, distance);
+
+                for (std::uint32_t l = 0; l < rays.size(); ++l) {
+                    if (offset[l] >= best || (accept && !accept(view, rays[l]))) continue;
+                    best = offset[l];
+                    hit  = PickHit{chunk.chunk, rays[l], distance[l], offset[l]};
+                }
+            });
+        }
+    });
+    return hit;
+}
@@ -0,0 +1,129 @@
+export module pngp.vis.rays.picking;
+// ============================================================================
+// Ray picking: a cursor cone is tested against a two-level BVH over the
+// resident ray segments (one BVH per chunk, one over the chunk roots).
+// Chunk BVHs are built on the worker pool as chunks land; segments are read
+// straight from the mapped file, so the index costs ~12 bytes per ray.
+// ============================================================================
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+import std;
+
+namespace pngp::vis::rays::picking {
+    // ========================================================================
+    // World-space cursor ray; a segment is a candidate when its closest
+    // point lies within the cone distance * tolerance of the ray.
+    // ========================================================================
+    export struct PickRay {
+        std::array<float, 3> origin{};
+        std::array<float, 3> direction{};
+        // Tangent of the cone half-angle (the pick radius in pixels).
+        float tolerance = 0.0f;
+    };
+
+    // ========================================================================
+    // Cursor (window pixels, origin top-left) to a pick ray, through the
+    // inverse of view_proj. Empty when the matrix is singular.
+    // ========================================================================
+    export [[nodiscard]] std::optional<PickRay> cursor_ray(const vk::math::mat4& view_proj, std::array<float, 2> viewport, std::array<float, 2> cursor, float radius_px);
+
+    // World point to window pixels; empty when it is behind the eye.
+    export [[nodiscard]] std::optional<std::array<float, 2>> project_point(const vk::math::mat4& view_proj, std::array<float, 2> viewport, const std::array<float, 3>& point);
+
+    export struct PickHit {
+        std::uint32_t chunk = 0;
+        // Index within the chunk's columns.
+        std::uint32_t ray = 0;
+        // Along the cursor ray, and the angular offset (tangent) from it.
+        float distance = 0.0f;
+        float offset   = 0.0f;
+    };
+
+    // ========================================================================
+    // Everything the file stores for one ray; optional columns the file
+    // lacks stay empty.
+    // ========================================================================
+    export struct RayAttributes {
+        std::uint64_t id    = 0;
+        std::uint32_t chunk = 0;
+        std::array<float, 3> origin{};
+        std::array<float, 3> direction{};
+        float t_min         = 0.0f;
+        float t_max         = 0.0f;
+        std::uint32_t color = 0;
+        std::optional<std::array<std::uint32_t, 2>> pixel{};
+        std::optional<std::uint32_t> camera_id{};
+    };
+
+    export [[nodiscard]] RayAttributes ray_attributes(const dataset::RayFile& file, std::uint32_t chunk, std::uint32_t ray);
+
+    // ========================================================================
+    // Flat BVH: interior nodes keep their left child next to them and the
+    // right child at `first`; leaves hold order[first, first + count).
+    // ========================================================================
+    struct BvhNode {
+        std::array<float, 3> lo{};
+        std::uint32_t first = 0;
+        std::array<float, 3> hi{};
+        std::uint32_t count = 0;
+    };
+
+    struct Bvh {
+        std::vector<BvhNode> nodes;
+        std::vector<std::uint32_t> order;
+    };
+
+    export class RayPicker {
+    public:
+        // Chunk has become resident; its BVH is built in the background.
+        void add_chunk(std::uint32_t chunk_index);
+        // ====================================================================
+        // Main thread: adopt finished chunk BVHs and rebuild the top level
+        // over their roots (a few thousand boxes at most).
+        // ====================================================================
+        void update();
+        // ====================================================================
+        // Segment with the smallest angular offset inside the cursor cone;
+        // rays accept() rejects (hidden by a filter) are skipped.
+        // ====================================================================
+        [[nodiscard]] std::optional<PickHit> pick(const PickRay& ray, const std::function<bool(const dataset::ChunkView&, std::uint32_t)>& accept = {}) const;
+
+        [[nodiscard]] std::size_t chunks_indexed() const noexcept {
+            return chunks.size();
+        }
+
+        RayPicker(std::shared_ptr<const dataset::RayFile> file, std::shared_ptr<jobs::ThreadPool> workers);
+        ~RayPicker();
+        RayPicker(const RayPicker&)            = delete;
+        RayPicker& operator=(const RayPicker&) = delete;
+        RayPicker(RayPicker&&)                 = delete;
+        RayPicker& operator=(RayPicker&&)      = delete;
+
+    private:
+        struct ChunkBvh {
+            std::uint32_t chunk = 0;
+            Bvh bvh;
+        };
+
+        void builder(const std::stop_token& stop);
+
+        std::shared_ptr<const dataset::RayFile> file;
+        std::shared_ptr<jobs::ThreadPool> workers;
+        // ====================================================================
+        // Builder hand-off (guarded by mutex).
+        // ====================================================================
+        std::mutex mutex;
+        std::condition_variable_any work_available;
+        std::vector<std::uint32_t> queued;
+        std::vector<ChunkBvh> finished;
+        // ====================================================================
+        // Main-thread index.
+        // ====================================================================
+        std::vector<ChunkBvh> chunks;
+        Bvh top;
+
+        // Declared last so the builder stops before the state above goes.
+        std::jthread thread;
+    };
+} // namespace pngp::vis::rays::picking
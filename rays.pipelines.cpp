@@ -0,0 +1,404 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.pipelines;
+// ============================================================================
+// Pipeline library implementation.
+// ============================================================================
+import std;
+import vk.pipeline;
+import vk.geometry;
+
+// ============================================================================
+// Translation-unit helpers (keys, SPIR-V lookup, cache blob validation).
+// ============================================================================
+namespace {
+    using pngp::vis::rays::pipelines::GraphicsPipelineDesc;
+
+    // =========================================================================
+    // Flatten a description into a byte string usable as a map key.
+    // =========================================================================
+    template <typename T>
+    void key_append(std::string& key, const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void key_append(std::string& key, const std::string& value) {
+        key_append(key, value.size());
+        key.append(value);
+    }
+
+    void key_append(std::string& key, const pngp::vis::rays::pipelines::Specialization& constants) {
+        key_append(key, constants.size());
+        for (const auto& c : constants) {
+            key_append(key, c.id);
+            key_append(key, c.value);
+        }
+    }
+
+    void key_append(std::string& key, const pngp::vis::rays::pipelines::DescriptorBindings& bindings) {
+        key_append(key, bindings.size());
+        for (const auto& b : bindings) {
+            key_append(key, b.binding);
+            key_append(key, b.descriptorType);
+            key_append(key, b.descriptorCount);
+            key_append(key, static_cast<vk::ShaderStageFlags::MaskType>(b.stageFlags));
+        }
+    }
+
+    std::string pipeline_key(const GraphicsPipelineDesc& d) {
+        std::string key;
+        key_append(key, 'G');
+        key_append(key, d.shader);
+        key_append(key, d.vertex_entry);
+        key_append(key, d.fragment_entry);
+        key_append(key, d.vertex_input.bindings.size());
+        for (const auto& b : d.vertex_input.bindings) {
+            key_append(key, b.binding);
+            key_append(key, b.stride);
+            key_append(key, b.inputRate);
+        }
+        key_append(key, d.vertex_input.attributes.size());
+        for (const auto& a : d.vertex_input.attributes) {
+            key_append(key, a.location);
+            key_append(key, a.binding);
+            key_append(key, a.format);
+            key_append(key, a.offset);
+        }
+        key_append(key, d.descriptor_bindings);
+        key_append(key, d.specialization);
+        key_append(key, d.color_format);
+        key_append(key, d.depth_format);
+        key_append(key, d.use_depth);
+        key_append(key, d.depth_write);
+        key_append(key, static_cast<vk::CullModeFlags::MaskType>(d.cull));
+        key_append(key, d.front_face);
+        key_append(key, d.polygon_mode);
+        key_append(key, d.topology);
+        key_append(key, d.enable_blend);
+        key_append(key, d.oit_revealage_format);
+        key_append(key, d.push_constant_bytes);
+        key_append(key, static_cast<vk::ShaderStageFlags::MaskType>(d.push_constant_stages));
+        return key;
+    }
+
+    std::string pipeline_key(const pngp::vis::rays::pipelines::ComputePipelineDesc& d) {
+        std::string key;
+        key_append(key, 'C');
+        key_append(key, d.shader);
+        key_append(key, d.entry);
+        key_append(key, d.descriptor_bindings);
+        key_append(key, d.specialization);
+        key_append(key, d.push_constant_bytes);
+        return key;
+    }
+
+    // =========================================================================
+    // Load SPIR-V from first available path (build dir or repo root).
+    // =========================================================================
+    std::vector<std::byte> read_shader_bytes(const std::string& name) {
+        const std::array paths{std::format("shaders/{}.spv", name), std::format("../shaders/{}.spv", name)};
+        std::exception_ptr last_error;
+        for (const auto& path : paths) {
+            try {
+                return vk::pipeline::read_file_bytes(path.c_str());
+            } catch (...) {
+                last_error = std::current_exception();
+            }
+        }
+        if (last_error) std::rethrow_exception(last_error);
+        throw std::runtime_error(std::format("{}.spv not found", name));
+    }
+
+    // =========================================================================
+    // Drivers reject foreign blobs on their own, but checking the header
+    // ourselves keeps a stale cache from a different GPU out entirely.
+    // =========================================================================
+    bool cache_blob_matches(const std::vector<std::byte>& blob, const vk::PhysicalDeviceProperties& props) {
+        struct Header {
+            std::uint32_t header_size;
+            std::uint32_t header_version;
+            std::uint32_t vendor_id;
+            std::uint32_t device_id;
+            std::array<std::uint8_t, VK_UUID_SIZE> uuid;
+        };
+        if (blob.size() < sizeof(Header)) return false;
+
+        Header h{};
+        std::memcpy(&h, blob.data(), sizeof(Header));
+        return h.header_version == static_cast<std::uint32_t>(vk::PipelineCacheHeaderVersion::eOne) && h.vendor_id == props.vendorID && h.device_id == props.deviceID && std::equal(h.uuid.begin(), h.uuid.end(), props.pipelineCacheUUID.begin());
+    }
+
+    // =========================================================================
+    // Map entries + packed values for a constant list; info points into
+    // the struct, so it must stay where it was built.
+    // =========================================================================
+    struct SpecializationData {
+        std::vector<vk::SpecializationMapEntry> entries;
+        std::vector<std::uint32_t> values;
+        vk::SpecializationInfo info{};
+
+        explicit SpecializationData(const pngp::vis::rays::pipelines::Specialization& constants) {
+            for (const auto& c : constants) {
+                entries.push_back({.constantID = c.id, .offset = static_cast<std::uint32_t>(values.size() * sizeof(std::uint32_t)), .size = sizeof(std::uint32_t)});
+                values.push_back(c.value);
+            }
+            info = vk::SpecializationInfo{
+                .mapEntryCount = static_cast<std::uint32_t>(entries.size()),
+                .pMapEntries   = entries.data(),
+                .dataSize      = values.size() * sizeof(std::uint32_t),
+                .pData         = values.data(),
+            };
+        }
+        SpecializationData(const SpecializationData&)            = delete;
+        SpecializationData& operator=(const SpecializationData&) = delete;
+
+        [[nodiscard]] const vk::SpecializationInfo* get() const noexcept {
+            return entries.empty() ? nullptr : &info;
+        }
+    };
+
+    std::vector<std::byte> read_blob(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return {};
+        std::vector<std::byte> blob(static_cast<std::size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+        if (!in) return {};
+        return blob;
+    }
+} // namespace
+
+template <>
+pngp::vis::rays::pipelines::VertexInput pngp::vis::rays::pipelines::make_vertex_input<vk::geometry::VertexP3C4>() {
+    VertexInput vin{};
+    vin.bindings = {
+        {.binding = 0, .stride = sizeof(vk::geometry::VertexP3C4), .inputRate = vk::VertexInputRate::eVertex},
+    };
+    vin.attributes = {
+        {.location = 0, .binding = 0, .format = vk::Format::eR32G32B32Sfloat, .offset = 0},
+        {.location = 1, .binding = 0, .format = vk::Format::eR32G32B32A32Sfloat, .offset = sizeof(vk::geometry::VertexP3C4) / 2},
+    };
+    return vin;
+}
+
+// ============================================================================
+// PipelineLibrary: seed the driver cache from disk when the blob matches.
+// ============================================================================
+pngp::vis::rays::pipelines::PipelineLibrary::PipelineLibrary(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, std::filesystem::path cache_path)
+    : device(&device), cache_path(std::move(cache_path)) {
+    std::vector<std::byte> blob;
+    if (!this->cache_path.empty()) blob = read_blob(this->cache_path);
+    if (!blob.empty() && !cache_blob_matches(blob, physical_device.getProperties())) blob.clear();
+
+    warm_start = !blob.empty();
+    cache      = vk::raii::PipelineCache(device, vk::PipelineCacheCreateInfo{
+                                                .initialDataSize = blob.size(),
+                                                .pInitialData    = blob.empty() ? nullptr : blob.data(),
+                                            });
+}
+
+pngp::vis::rays::pipelines::PipelineLibrary::~PipelineLibrary() {
+    try {
+        save();
+    } catch (...) {
+        // Losing the cache only costs compile time on the next launch.
+    }
+}
+
+void pngp::vis::rays::pipelines::PipelineLibrary::save() {
+    if (!dirty || cache_path.empty()) return;
+
+    const auto data = cache.getData();
+    // Write then rename so a crash never leaves a truncated blob behind.
+    auto tmp = cache_path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return;
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!out) return;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, cache_path, ec);
+    if (!ec) dirty = false;
+}
+
+const std::vector<std::byte>& pngp::vis::rays::pipelines::PipelineLibrary::shader_bytes(const std::string& name) {
+    if (const auto it = spirv.find(name); it != spirv.end()) return it->second;
+    return spirv.emplace(name, read_shader_bytes(name)).first->second;
+}
+
+const vk::raii::ShaderModule& pngp::vis::rays::pipelines::PipelineLibrary::shader_module(const std::string& name) {
+    if (const auto it = modules.find(name); it != modules.end()) return it->second;
+
+    const auto& bytes = shader_bytes(name);
+    vk::raii::ShaderModule shader(*device, vk::ShaderModuleCreateInfo{
+                                               .codeSize = bytes.size(),
+                                               .pCode    = reinterpret_cast<const std::uint32_t*>(bytes.data()),
+                                           });
+    return modules.emplace(name, std::move(shader)).first->second;
+}
+
+const pngp::vis::rays::pipelines::Pipeline& pngp::vis::rays::pipelines::PipelineLibrary::get(const GraphicsPipelineDesc& desc) {
+    auto key = pipeline_key(desc);
+    if (const auto it = pipelines.find(key); it != pipelines.end()) return it->second;
+
+    const auto& shader = shader_module(desc.shader);
+    Pipeline out       = make_layout(desc.descriptor_bindings, desc.push_constant_bytes, desc.push_constant_stages);
+
+    const SpecializationData specialization{desc.specialization};
+    const std::array stages{
+        vk::PipelineShaderStageCreateInfo{
+            .stage               = vk::ShaderStageFlagBits::eVertex,
+            .module              = *shader,
+            .pName               = desc.vertex_entry.c_str(),
+            .pSpecializationInfo = specialization.get(),
+        },
+        vk::PipelineShaderStageCreateInfo{
+            .stage               = vk::ShaderStageFlagBits::eFragment,
+            .module              = *shader,
+            .pName               = desc.fragment_entry.c_str(),
+            .pSpecializationInfo = specialization.get(),
+        },
+    };
+
+    const vk::PipelineVertexInputStateCreateInfo vertex_input{
+        .vertexBindingDescriptionCount   = static_cast<std::uint32_t>(desc.vertex_input.bindings.size()),
+        .pVertexBindingDescriptions      = desc.vertex_input.bindings.data(),
+        .vertexAttributeDescriptionCount = static_cast<std::uint32_t>(desc.vertex_input.attributes.size()),
+        .pVertexAttributeDescriptions    = desc.vertex_input.attributes.data(),
+    };
+    const vk::PipelineInputAssemblyStateCreateInfo input_assembly{.topology = desc.topology};
+    const vk::PipelineViewportStateCreateInfo viewport{.viewportCount = 1, .scissorCount = 1};
+    const vk::PipelineRasterizationStateCreateInfo raster{
+        .polygonMode = desc.polygon_mode,
+        .cullMode    = desc.cull,
+        .frontFace   = desc.front_face,
+        .lineWidth   = 1.0f,
+    };
+    const vk::PipelineMultisampleStateCreateInfo multisample{.rasterizationSamples = vk::SampleCountFlagBits::e1};
+    const vk::PipelineDepthStencilStateCreateInfo depth{
+        .depthTestEnable  = desc.use_depth,
+        .depthWriteEnable = desc.use_depth && desc.depth_write,
+        .depthCompareOp   = vk::CompareOp::eLessOrEqual,
+    };
+    std::array<vk::PipelineColorBlendAttachmentState, 2> blend_attachments{};
+    blend_attachments[0] = vk::PipelineColorBlendAttachmentState{
+        .blendEnable         = desc.enable_blend,
+        .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+        .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .colorBlendOp        = vk::BlendOp::eAdd,
+        .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+        .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .alphaBlendOp        = vk::BlendOp::eAdd,
+        .colorWriteMask      = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    };
+
+    // ========================================================================
+    // WBOIT: weighted premultiplied color and weight sum add up; revealage
+    // is multiplied by (1 - alpha), the fragment writing alpha into red.
+    // ========================================================================
+    const bool oit = desc.oit_revealage_format != vk::Format::eUndefined;
+    if (oit) {
+        blend_attachments[0].blendEnable         = true;
+        blend_attachments[0].srcColorBlendFactor = vk::BlendFactor::eOne;
+        blend_attachments[0].dstColorBlendFactor = vk::BlendFactor::eOne;
+        blend_attachments[0].dstAlphaBlendFactor = vk::BlendFactor::eOne;
+
+        const vk::PipelineColorBlendAttachmentState revealage{
+            .blendEnable         = true,
+            .srcColorBlendFactor = vk::BlendFactor::eZero,
+            .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcColor,
+            .colorBlendOp        = vk::BlendOp::eAdd,
+            .srcAlphaBlendFactor = vk::BlendFactor::eZero,
+            .dstAlphaBlendFactor = vk::BlendFactor::eOne,
+            .alphaBlendOp        = vk::BlendOp::eAdd,
+            .colorWriteMask      = vk::ColorComponentFlagBits::eR,
+        };
+        blend_attachments[1] = revealage;
+    }
+    const std::uint32_t color_count = oit ? 2 : 1;
+    const vk::PipelineColorBlendStateCreateInfo blend{
+        .attachmentCount = color_count,
+        .pAttachments    = blend_attachments.data(),
+    };
+    constexpr std::array dynamic_states{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    const vk::PipelineDynamicStateCreateInfo dynamic{
+        .dynamicStateCount = static_cast<std::uint32_t>(dynamic_states.size()),
+        .pDynamicStates    = dynamic_states.data(),
+    };
+    const std::array color_formats{desc.color_format, desc.oit_revealage_format};
+    const vk::PipelineRenderingCreateInfo rendering{
+        .colorAttachmentCount    = color_count,
+        .pColorAttachmentFormats = color_formats.data(),
+        .depthAttachmentFormat   = desc.use_depth ? desc.depth_format : vk::Format::eUndefined,
+    };
+
+    const vk::GraphicsPipelineCreateInfo info{
+        .pNext               = &rendering,
+        .stageCount          = static_cast<std::uint32_t>(stages.size()),
+        .pStages             = stages.data(),
+        .pVertexInputState   = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState      = &viewport,
+        .pRasterizationState = &raster,
+        .pMultisampleState   = &multisample,
+        .pDepthStencilState  = &depth,
+        .pColorBlendState    = &blend,
+        .pDynamicState       = &dynamic,
+        .layout              = *out.layout,
+    };
+    out.pipeline = vk::raii::Pipeline(*device, cache, info);
+    dirty        = true;
+
+    return pipelines.emplace(std::move(key), std::move(out)).first->second;
+}
+
+const pngp::vis::rays::pipelines::Pipeline& pngp::vis::rays::pipelines::PipelineLibrary::get(const ComputePipelineDesc& desc) {
+    auto key = pipeline_key(desc);
+    if (const auto it = pipelines.find(key); it != pipelines.end()) return it->second;
+
+    const auto& shader = shader_module(desc.shader);
+    Pipeline out       = make_layout(desc.descriptor_bindings, desc.push_constant_bytes, vk::ShaderStageFlagBits::eCompute);
+
+    const SpecializationData specialization{desc.specialization};
+    const vk::ComputePipelineCreateInfo info{
+        .stage =
+            vk::PipelineShaderStageCreateInfo{
+                .stage               = vk::ShaderStageFlagBits::eCompute,
+                .module              = *shader,
+                .pName               = desc.entry.c_str(),
+                .pSpecializationInfo = specialization.get(),
+            },
+        .layout = *out.layout,
+    };
+    out.pipeline = vk::raii::Pipeline(*device, cache, info);
+    dirty        = true;
+
+    return pipelines.emplace(std::move(key), std::move(out)).first->second;
+}
+
+pngp::vis::rays::pipelines::Pipeline pngp::vis::rays::pipelines::PipelineLibrary::make_layout(const DescriptorBindings& bindings, const std::uint32_t push_constant_bytes, const vk::ShaderStageFlags push_constant_stages) const {
+    Pipeline out{};
+    if (!bindings.empty()) {
+        out.set_layout = vk::raii::DescriptorSetLayout(*device, vk::DescriptorSetLayoutCreateInfo{
+                                                                    .bindingCount = static_cast<std::uint32_t>(bindings.size()),
+                                                                    .pBindings    = bindings.data(),
+                                                                });
+    }
+
+    const vk::DescriptorSetLayout set_layout = *out.set_layout;
+    const vk::PushConstantRange push_range{
+        .stageFlags = push_constant_stages,
+        .offset     = 0,
+        .size       = push_constant_bytes,
+    };
+    out.layout = vk::raii::PipelineLayout(*device, vk::PipelineLayoutCreateInfo{
+                                                       .setLayoutCount         = bindings.empty() ? 0u : 1u,
+                                                       .pSetLayouts            = bindings.empty() ? nullptr : &set_layout,
+                                                       .pushConstantRangeCount = push_constant_bytes > 0 ? 1u : 0u,
+                                                       .pPushConstantRanges    = push_constant_bytes > 0 ? &push_range : nullptr,
+                                                   });
+    return out;
+}
@@ -0,0 +1,137 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.pipelines;
+// ============================================================================
+// Pipeline library: cached SPIR-V, pipelines keyed by description, and a
+// VkPipelineCache persisted between runs.
+// ============================================================================
+import vk.geometry;
+import std;
+
+namespace pngp::vis::rays::pipelines {
+    // ========================================================================
+    // Vertex layout description (bindings + attributes).
+    // ========================================================================
+    export struct VertexInput {
+        std::vector<vk::VertexInputBindingDescription> bindings;
+        std::vector<vk::VertexInputAttributeDescription> attributes;
+    };
+
+    export template <typename V>
+    VertexInput make_vertex_input();
+
+    // vec4 position (xyz read) + vec4 color, one binding per vertex.
+    template <>
+    VertexInput make_vertex_input<vk::geometry::VertexP3C4>();
+
+    // ========================================================================
+    // Bindings of descriptor set 0; empty means no set layout.
+    // ========================================================================
+    export using DescriptorBindings = std::vector<vk::DescriptorSetLayoutBinding>;
+
+    // ========================================================================
+    // Specialization constants, 32-bit each ([vk::constant_id(id)] in
+    // Slang; bools are 0/1). Every stage gets the whole list; ids a stage
+    // does not declare are ignored. Each distinct list is its own pipeline.
+    // ========================================================================
+    export struct SpecializationConstant {
+        std::uint32_t id    = 0;
+        std::uint32_t value = 0;
+    };
+    export using Specialization = std::vector<SpecializationConstant>;
+
+    // ========================================================================
+    // Everything that affects the compiled pipeline. Viewport and scissor
+    // are dynamic and rendering is dynamic, so the swapchain extent is not
+    // part of the description; only attachment formats are.
+    // ========================================================================
+    export struct GraphicsPipelineDesc {
+        std::string shader{};
+        std::string vertex_entry   = "vertMain";
+        std::string fragment_entry = "fragMain";
+        VertexInput vertex_input{};
+        DescriptorBindings descriptor_bindings{};
+        Specialization specialization{};
+
+        vk::Format color_format = vk::Format::eUndefined;
+        vk::Format depth_format = vk::Format::eUndefined;
+        bool use_depth          = true;
+        bool depth_write        = true;
+
+        vk::CullModeFlags cull         = vk::CullModeFlagBits::eNone;
+        vk::FrontFace front_face       = vk::FrontFace::eCounterClockwise;
+        vk::PolygonMode polygon_mode   = vk::PolygonMode::eFill;
+        vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+        bool enable_blend              = false;
+        // ====================================================================
+        // Weighted blended OIT accumulation: color_format is the additive
+        // accumulation target and a second attachment of this format keeps
+        // the product of (1 - alpha). Replaces enable_blend when set.
+        // ====================================================================
+        vk::Format oit_revealage_format = vk::Format::eUndefined;
+
+        std::uint32_t push_constant_bytes         = 0;
+        vk::ShaderStageFlags push_constant_stages = vk::ShaderStageFlagBits::eVertex;
+    };
+
+    // ========================================================================
+    // Compute pipelines: one entry point, set 0 + push constants.
+    // ========================================================================
+    export struct ComputePipelineDesc {
+        std::string shader{};
+        std::string entry = "computeMain";
+        DescriptorBindings descriptor_bindings{};
+        Specialization specialization{};
+        std::uint32_t push_constant_bytes = 0;
+    };
+
+    export struct Pipeline {
+        // Set 0 layout, null when the description has no bindings.
+        vk::raii::DescriptorSetLayout set_layout{nullptr};
+        vk::raii::PipelineLayout layout{nullptr};
+        vk::raii::Pipeline pipeline{nullptr};
+    };
+
+    export class PipelineLibrary {
+    public:
+        // Built on first request (so only variants actually used are ever
+        // compiled), then served from memory. References stay valid for the
+        // library's lifetime.
+        const Pipeline& get(const GraphicsPipelineDesc& desc);
+        const Pipeline& get(const ComputePipelineDesc& desc);
+        // SPIR-V for a shader name, loaded from disk at most once.
+        const std::vector<std::byte>& shader_bytes(const std::string& name);
+        // Write the driver cache blob if new pipelines were compiled.
+        void save();
+
+        [[nodiscard]] std::size_t pipeline_count() const noexcept {
+            return pipelines.size();
+        }
+        [[nodiscard]] bool loaded_from_disk() const noexcept {
+            return warm_start;
+        }
+
+        PipelineLibrary(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, std::filesystem::path cache_path);
+        ~PipelineLibrary();
+        PipelineLibrary(const PipelineLibrary&)            = delete;
+        PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+        PipelineLibrary(PipelineLibrary&&)                 = delete;
+        PipelineLibrary& operator=(PipelineLibrary&&)      = delete;
+
+    private:
+        const vk::raii::ShaderModule& shader_module(const std::string& name);
+        // Set layout + pipeline layout shared by both pipeline kinds.
+        Pipeline make_layout(const DescriptorBindings& bindings, std::uint32_t push_constant_bytes, vk::ShaderStageFlags push_constant_stages) const;
+
+        const vk::raii::Device* device = nullptr;
+        std::filesystem::path cache_path;
+
+        vk::raii::PipelineCache cache{nullptr};
+        bool warm_start = false;
+        bool dirty      = false;
+
+        std::unordered_map<std::string, std::vector<std::byte>> spirv;
+        std::unordered_map<std::string, vk::raii::ShaderModule> modules;
+        std::unordered_map<std::string, Pipeline> pipelines;
+    };
+} // namespace pngp::vis::rays::pipelines
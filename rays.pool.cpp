@@ -0,0 +1,307 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.pool;
+// ============================================================================
+// Ray pool implementation.
+// ============================================================================
+import std;
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+
+// ============================================================================
+// Translation-unit helpers.
+// ============================================================================
+namespace {
+    constexpr std::uint32_t cull_group_size = 64;
+    constexpr vk::DeviceSize command_stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+    static_assert(sizeof(pngp::vis::rays::pool::ChunkInfo) == 32);
+    static_assert(sizeof(pngp::vis::rays::pool::CullPush) == 80);
+    static_assert(command_stride == 20);
+
+    void write_storage_buffers(const vk::raii::Device& device, const vk::DescriptorSet set, const std::span<const vk::DescriptorBufferInfo> buffers) {
+        std::vector<vk::WriteDescriptorSet> writes(buffers.size());
+        for (std::uint32_t b = 0; b < buffers.size(); ++b) {
+            writes[b] = vk::WriteDescriptorSet{
+                .dstSet          = set,
+                .dstBinding      = b,
+                .descriptorCount = 1,
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo     = &buffers[b],
+            };
+        }
+        device.updateDescriptorSets(writes, {});
+    }
+} // namespace
+
+pngp::vis::rays::pipelines::DescriptorBindings pngp::vis::rays::pool::cull_bindings() {
+    return {
+        {.binding = 0, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eCompute},
+        {.binding = 1, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eCompute},
+        {.binding = 2, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eCompute},
+    };
+}
+
+pngp::vis::rays::pipelines::DescriptorBindings pngp::vis::rays::pool::draw_bindings() {
+    return {
+        {.binding = 0, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eVertex},
+        {.binding = 1, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eVertex},
+        {.binding = 2, .descriptorType = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1, .stageFlags = vk::ShaderStageFlagBits::eVertex},
+    };
+}
+
+vk::DeviceSize pngp::vis::rays::pool::slot_bytes(const std::uint32_t slot_rays, const std::uint32_t frames_in_flight) {
+    const auto rays = static_cast<vk::DeviceSize>(slot_rays);
+    return rays * (sizeof(dataset::RayRecord) + sizeof(std::uint32_t)) + sizeof(ChunkInfo) + frames_in_flight * command_stride;
+}
+
+std::uint32_t pngp::vis::rays::pool::max_slots(const vk::raii::PhysicalDevice& physical_device, const std::uint32_t slot_rays) {
+    const auto chain = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceMaintenance3Properties>();
+
+    // The record buffer is the largest; one descriptor covers all of it.
+    const vk::DeviceSize record_bytes = std::max<vk::DeviceSize>(1, static_cast<vk::DeviceSize>(slot_rays) * sizeof(dataset::RayRecord));
+    const vk::DeviceSize range        = chain.get<vk::PhysicalDeviceProperties2>().properties.limits.maxStorageBufferRange;
+    const vk::DeviceSize allocation   = chain.get<vk::PhysicalDeviceMaintenance3Properties>().maxMemoryAllocationSize;
+    // vertexOffset (two per ray) must stay within int32 as well.
+    const vk::DeviceSize vertices = static_cast<vk::DeviceSize>(std::numeric_limits<std::int32_t>::max()) / std::max<vk::DeviceSize>(1, 2 * static_cast<vk::DeviceSize>(slot_rays));
+    return static_cast<std::uint32_t>(std::min({std::min(range, allocation) / record_bytes, vertices, vk::DeviceSize{std::numeric_limits<std::uint32_t>::max()}}));
+}
+
+// ============================================================================
+// Constructor: size everything for the slot count up front; the shared
+// index buffer goes out through the uploader like any other copy.
+// ============================================================================
+pngp::vis::rays::pool::RayPool::RayPool(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, upload::Uploader& uploader, const vk::DescriptorSetLayout cull_layout, const PoolInfo& info) : info(info) {
+    const vk::DeviceSize slot_vertices = 2 * static_cast<vk::DeviceSize>(info.slot_rays);
+    if (info.slot_count * slot_vertices > static_cast<vk::DeviceSize>(std::numeric_limits<std::int32_t>::max())) throw std::runtime_error("ray pool exceeds indirect vertexOffset range");
+
+    records    = upload::create_buffer(physical_device, device, info.slot_count * static_cast<vk::DeviceSize>(info.slot_rays) * sizeof(dataset::RayRecord), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    selection  = upload::create_buffer(physical_device, device, info.slot_count * static_cast<vk::DeviceSize>(info.slot_rays) * sizeof(std::uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    indices    = upload::create_buffer(physical_device, device, slot_vertices * sizeof(std::uint32_t), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    chunk_info = upload::create_buffer(physical_device, device, info.slot_count * sizeof(ChunkInfo), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    slot_info.resize(info.slot_count);
+    identity.resize(info.slot_rays);
+    std::iota(identity.begin(), identity.end(), 0u);
+
+    std::vector<std::uint32_t> iota(slot_vertices);
+    std::iota(iota.begin(), iota.end(), 0u);
+    const std::array copies{upload::BufferCopy{&indices, std::as_bytes(std::span{iota}), 0}};
+    if (!uploader.upload(copies)) throw std::runtime_error("ray pool index upload did not fit the staging ring");
+
+    // ========================================================================
+    // One cull set per frame in flight (chunk info + that frame's commands
+    // and count), plus the draw set (records, chunk info, selection).
+    // ========================================================================
+    const vk::DescriptorPoolSize pool_size{
+        .type            = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = 3 * info.frames_in_flight + 3,
+    };
+    descriptor_pool = vk::raii::DescriptorPool(device, vk::DescriptorPoolCreateInfo{
+                                                           .flags         = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                                                           .maxSets       = info.frames_in_flight + 1,
+                                                           .poolSizeCount = 1,
+                                                           .pPoolSizes    = &pool_size,
+                                                       });
+
+    const std::vector layouts(info.frames_in_flight, cull_layout);
+    auto sets = vk::raii::DescriptorSets(device, vk::DescriptorSetAllocateInfo{
+                                                     .descriptorPool     = *descriptor_pool,
+                                                     .descriptorSetCount = info.frames_in_flight,
+                                                     .pSetLayouts        = layouts.data(),
+                                                 });
+
+    const auto indirect_usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    for (auto& set : sets) {
+        FrameBuffers f{};
+        f.commands = upload::create_buffer(physical_device, device, info.slot_count * command_stride, indirect_usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        f.count    = upload::create_buffer(physical_device, device, sizeof(std::uint32_t), indirect_usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        f.set      = std::move(set);
+
+        const std::array buffers{
+            vk::DescriptorBufferInfo{.buffer = *chunk_info.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            vk::DescriptorBufferInfo{.buffer = *f.commands.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            vk::DescriptorBufferInfo{.buffer = *f.count.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        };
+        write_storage_buffers(device, *f.set, buffers);
+        frames.push_back(std::move(f));
+    }
+
+    // ========================================================================
+    // Draw set: layout-compatible with the ray pipeline's set 0, so the pool
+    // owns it and needs no pipeline at construction time.
+    // ========================================================================
+    const auto bindings = draw_bindings();
+    draw_layout         = vk::raii::DescriptorSetLayout(device, vk::DescriptorSetLayoutCreateInfo{
+                                                                    .bindingCount = static_cast<std::uint32_t>(bindings.size()),
+                                                                    .pBindings    = bindings.data(),
+                                                                });
+
+    const vk::DescriptorSetLayout draw_layout_handle = *draw_layout;
+    auto draw_sets                                   = vk::raii::DescriptorSets(device, vk::DescriptorSetAllocateInfo{
+                                                                                            .descriptorPool     = *descriptor_pool,
+                                                                                            .descriptorSetCount = 1,
+                                                                                            .pSetLayouts        = &draw_layout_handle,
+                                                                                        });
+    draw_set                                         = std::move(draw_sets.front());
+
+    write_storage_buffers(device, *draw_set, ray_buffers());
+}
+
+std::optional<std::uint64_t> pngp::vis::rays::pool::RayPool::upload_chunk(upload::Uploader& uploader, const dataset::StreamedChunk& chunk, const dataset::ChunkRecord& record) {
+    if (full()) return std::nullopt;
+    if (holds(chunk.index)) throw std::runtime_error("ray chunk already has a pool slot");
+
+    const vk::DeviceSize slot_rays = info.slot_rays;
+    if (chunk.records.size() > slot_rays) throw std::runtime_error("ray chunk larger than its pool slot");
+
+    // Two indices per record; vertexOffset is in records * 2 as well, so the
+    // shader recovers the record index from the vertex index alone.
+    const bool reuse         = !free_slots.empty();
+    const std::uint32_t slot = reuse ? free_slots.back() : allocated;
+    const ChunkInfo ci{
+        .bounds_min    = record.bounds_min,
+        .index_count   = static_cast<std::uint32_t>(2 * chunk.records.size()),
+        .bounds_max    = record.bounds_max,
+        .vertex_offset = static_cast<std::int32_t>(2 * slot * slot_rays),
+    };
+
+    const std::array copies{
+        upload::BufferCopy{&records, std::as_bytes(std::span{chunk.records}), slot * slot_rays * sizeof(dataset::RayRecord)},
+        upload::BufferCopy{&selection, std::as_bytes(std::span{identity}.first(chunk.records.size())), slot * slot_rays * sizeof(std::uint32_t)},
+        upload::BufferCopy{&chunk_info, std::as_bytes(std::span{&ci, 1}), slot * sizeof(ChunkInfo)},
+    };
+    // A reused slot may still be read by frames in flight.
+    const auto ticket = uploader.upload(copies, reuse);
+    if (!ticket) return std::nullopt;
+
+    if (chunk.index >= chunk_slots.size()) chunk_slots.resize(chunk.index + 1, no_slot);
+    chunk_slots[chunk.index] = slot;
+    slot_info[slot]          = ci;
+    if (reuse) free_slots.pop_back();
+    else ++allocated;
+    return ticket;
+}
+
+void pngp::vis::rays::pool::RayPool::mark_resident(const std::uint32_t chunk_index) {
+    if (!holds(chunk_index)) throw std::runtime_error("landed ray chunk without a pool slot");
+    range = std::max(range, chunk_slots[chunk_index] + 1);
+    ++resident;
+}
+
+// ============================================================================
+// Only the draw count goes to zero; the records stay until the slot is
+// overwritten, and frames in flight may still draw them meanwhile.
+// ============================================================================
+std::optional<std::uint64_t> pngp::vis::rays::pool::RayPool::evict(upload::Uploader& uploader, const std::uint32_t chunk_index) {
+    if (!holds(chunk_index)) throw std::runtime_error("evicting a ray chunk without a pool slot");
+    const std::uint32_t slot = chunk_slots[chunk_index];
+
+    ChunkInfo ci   = slot_info[slot];
+    ci.index_count = 0;
+
+    const std::array copies{upload::BufferCopy{&chunk_info, std::as_bytes(std::span{&ci, 1}), slot * sizeof(ChunkInfo)}};
+    const auto ticket = uploader.upload(copies, true);
+    if (!ticket) return std::nullopt;
+
+    slot_info[slot]          = ci;
+    chunk_slots[chunk_index] = no_slot;
+    free_slots.push_back(slot);
+    --resident;
+    return ticket;
+}
+
+// ============================================================================
+// Only the selection prefix and the draw count change; both may be in use
+// by frames still in flight, hence the write-after-read wait.
+// ============================================================================
+std::optional<std::uint64_t> pngp::vis::rays::pool::RayPool::upload_selection(upload::Uploader& uploader, const std::uint32_t chunk_index, const std::span<const std::uint32_t> records) {
+    if (!holds(chunk_index)) throw std::runtime_error("ray selection for a chunk without a pool slot");
+    const std::uint32_t slot = chunk_slots[chunk_index];
+    if (records.size() > info.slot_rays) throw std::runtime_error("ray selection larger than its pool slot");
+
+    ChunkInfo ci   = slot_info[slot];
+    ci.index_count = static_cast<std::uint32_t>(2 * records.size());
+
+    const std::array copies{
+        upload::BufferCopy{&selection, std::as_bytes(records), slot * static_cast<vk::DeviceSize>(info.slot_rays) * sizeof(std::uint32_t)},
+        upload::BufferCopy{&chunk_info, std::as_bytes(std::span{&ci, 1}), slot * sizeof(ChunkInfo)},
+    };
+    const auto ticket = uploader.upload(copies, true);
+    if (ticket) slot_info[slot] = ci;
+    return ticket;
+}
+
+std::uint64_t pngp::vis::rays::pool::RayPool::rays_selected() const noexcept {
+    std::uint64_t total = 0;
+    for (std::uint32_t slot = 0; slot < range; ++slot) total += slot_info[slot].index_count / 2;
+    return total;
+}
+
+std::array<vk::DescriptorBufferInfo, 3> pngp::vis::rays::pool::RayPool::ray_buffers() const noexcept {
+    return {
+        vk::DescriptorBufferInfo{.buffer = *records.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{.buffer = *chunk_info.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{.buffer = *selection.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+    };
+}
+
+void pngp::vis::rays::pool::RayPool::cull(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& cull_pipeline, const std::uint32_t frame_index, const vk::math::mat4& view_proj, const vk::Extent2D viewport, const float rays_per_pixel) const {
+    const FrameBuffers& f = frames[frame_index];
+
+    // ========================================================================
+    // Zero the count; without an indirect count the whole command array is
+    // zeroed too, so entries past the survivors draw nothing.
+    // ========================================================================
+    cmd.fillBuffer(*f.count.buffer, 0, VK_WHOLE_SIZE, 0);
+    if (!info.features.draw_indirect_count) cmd.fillBuffer(*f.commands.buffer, 0, VK_WHOLE_SIZE, 0);
+    {
+        const vk::MemoryBarrier2 barrier{
+            .srcStageMask  = vk::PipelineStageFlagBits2::eClear,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect,
+            .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eIndirectCommandRead,
+        };
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers    = &barrier,
+        });
+    }
+
+    if (range > 0) {
+        const CullPush push{view_proj, range, std::max(0.0f, rays_per_pixel), {static_cast<float>(viewport.width), static_cast<float>(viewport.height)}};
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *cull_pipeline.pipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *cull_pipeline.layout, 0, {*f.set}, {});
+        cmd.pushConstants(*cull_pipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, vk::ArrayProxy<const CullPush>{push});
+        cmd.dispatch((range + cull_group_size - 1) / cull_group_size, 1, 1);
+    }
+
+    const vk::MemoryBarrier2 barrier{
+        .srcStageMask  = vk::PipelineStageFlagBits2::eComputeShader,
+        .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+        .dstStageMask  = vk::PipelineStageFlagBits2::eDrawIndirect,
+        .dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead,
+    };
+    cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers    = &barrier,
+    });
+}
+
+void pngp::vis::rays::pool::RayPool::draw(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& ray_pipeline, const std::uint32_t frame_index) const {
+    if (range == 0) return;
+    const FrameBuffers& f = frames[frame_index];
+
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *ray_pipeline.layout, 0, {*draw_set}, {});
+    cmd.bindIndexBuffer(*indices.buffer, 0, vk::IndexType::eUint32);
+
+    if (info.features.draw_indirect_count) {
+        cmd.drawIndexedIndirectCount(*f.commands.buffer, 0, *f.count.buffer, 0, range, command_stride);
+    } else if (info.features.multi_draw_indirect) {
+        cmd.drawIndexedIndirect(*f.commands.buffer, 0, range, command_stride);
+    } else {
+        for (std::uint32_t i = 0; i < range; ++i) cmd.drawIndexedIndirect(*f.commands.buffer, i * command_stride, 1, command_stride);
+    }
+}
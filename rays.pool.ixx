@@ -0,0 +1,187 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.pool;
+// ============================================================================
+// Ray pool: every resident chunk lives in a fixed-size slot of one record
+// buffer, so a compute pass can cull chunks against the frustum and feed a
+// single indirect draw instead of one drawIndexed per chunk. The buffers
+// are a few large allocations suballocated by slot; when the dataset has
+// more chunks than slots, evicted slots go on a free list for reuse.
+// ============================================================================
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+import std;
+
+namespace pngp::vis::rays::pool {
+    // ========================================================================
+    // Per-slot cull input; mirrors ChunkInfo in ray_cull.slang (std430).
+    // ========================================================================
+    export struct ChunkInfo {
+        std::array<float, 3> bounds_min{};
+        std::uint32_t index_count = 0;
+        std::array<float, 3> bounds_max{};
+        std::int32_t vertex_offset = 0;
+    };
+
+    // ========================================================================
+    // Push constants consumed by ray_cull.slang.
+    // ========================================================================
+    export struct CullPush {
+        vk::math::mat4 view_proj{};
+        std::uint32_t chunk_count = 0;
+        // Rays drawn per covered pixel; 0 draws every ray.
+        float rays_per_pixel = 0.0f;
+        std::array<float, 2> viewport{};
+    };
+
+    // Storage buffers bound by ray_cull.slang (set 0).
+    export [[nodiscard]] pipelines::DescriptorBindings cull_bindings();
+    // Storage buffers read by ray_segments.slang (set 0): records, chunk
+    // info, selection.
+    export [[nodiscard]] pipelines::DescriptorBindings draw_bindings();
+
+    // ========================================================================
+    // Optional device features the draw path can use. Without either, each
+    // command is drawn separately (culled ones have instanceCount = 0).
+    // ========================================================================
+    export struct IndirectFeatures {
+        bool draw_indirect_count = false;
+        bool multi_draw_indirect = false;
+    };
+
+    // ========================================================================
+    // Device memory one slot takes across the pool's buffers, and the most
+    // slots the device can address (storage buffer range and allocation
+    // size limits of the largest buffer).
+    // ========================================================================
+    export [[nodiscard]] vk::DeviceSize slot_bytes(std::uint32_t slot_rays, std::uint32_t frames_in_flight);
+    export [[nodiscard]] std::uint32_t max_slots(const vk::raii::PhysicalDevice& physical_device, std::uint32_t slot_rays);
+
+    export struct PoolInfo {
+        std::uint32_t slot_count       = 0;
+        std::uint32_t slot_rays        = 0;
+        std::uint32_t frames_in_flight = 2;
+        IndirectFeatures features{};
+    };
+
+    export class RayPool {
+    public:
+        // ====================================================================
+        // Copy a decoded chunk into a free slot (an evicted one first).
+        // Returns the upload ticket, or nullopt when the staging ring is
+        // full (retry later).
+        // ====================================================================
+        [[nodiscard]] std::optional<std::uint64_t> upload_chunk(upload::Uploader& uploader, const dataset::StreamedChunk& chunk, const dataset::ChunkRecord& record);
+        // ====================================================================
+        // Free a landed chunk's slot: its draw count is zeroed on the GPU so
+        // cull skips it until the slot is reused. Returns the upload ticket,
+        // or nullopt when the ring is full (the chunk stays).
+        // ====================================================================
+        [[nodiscard]] std::optional<std::uint64_t> evict(upload::Uploader& uploader, std::uint32_t chunk_index);
+        // ====================================================================
+        // Replace an uploaded chunk's selection (ascending record positions;
+        // every record is selected after upload_chunk) and its draw count.
+        // Returns the upload ticket, or nullopt when the ring is full.
+        // ====================================================================
+        [[nodiscard]] std::optional<std::uint64_t> upload_selection(upload::Uploader& uploader, std::uint32_t chunk_index, std::span<const std::uint32_t> records);
+        // ====================================================================
+        // Chunk's upload has landed: cull and draw cover its slot from now
+        // on. Slots below the range that hold no chunk draw nothing.
+        // ====================================================================
+        void mark_resident(std::uint32_t chunk_index);
+        // ====================================================================
+        // Outside rendering: reset this slot's draw count, cull resident
+        // chunks, pick each survivor's LOD prefix from its projected area
+        // (rays_per_pixel = 0 disables LOD), and make the commands visible
+        // to the indirect stage.
+        // ====================================================================
+        void cull(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& cull_pipeline, std::uint32_t frame_index, const vk::math::mat4& view_proj, vk::Extent2D viewport, float rays_per_pixel) const;
+        // ====================================================================
+        // Inside rendering with the ray pipeline bound: bind the record
+        // buffers and draw the survivors.
+        // ====================================================================
+        void draw(const vk::raii::CommandBuffer& cmd, const pipelines::Pipeline& ray_pipeline, std::uint32_t frame_index) const;
+
+        [[nodiscard]] bool full() const noexcept {
+            return free_slots.empty() && allocated >= info.slot_count;
+        }
+        [[nodiscard]] std::uint32_t slots_free() const noexcept {
+            return static_cast<std::uint32_t>(free_slots.size()) + info.slot_count - allocated;
+        }
+        [[nodiscard]] bool holds(const std::uint32_t chunk_index) const noexcept {
+            return chunk_index < chunk_slots.size() && chunk_slots[chunk_index] != no_slot;
+        }
+        // Chunks landed and not evicted.
+        [[nodiscard]] std::uint32_t chunks_resident() const noexcept {
+            return resident;
+        }
+        // Slots the cull, draw and splat passes walk: [0, slot_range).
+        [[nodiscard]] std::uint32_t slot_range() const noexcept {
+            return range;
+        }
+        [[nodiscard]] std::uint32_t slot_count() const noexcept {
+            return info.slot_count;
+        }
+        [[nodiscard]] std::uint32_t slot_rays() const noexcept {
+            return info.slot_rays;
+        }
+        // Rays drawn at full detail across resident slots (after filtering).
+        [[nodiscard]] std::uint64_t rays_selected() const noexcept;
+        // ====================================================================
+        // Records, chunk info and selection, in draw_bindings() order, for
+        // other passes that read resident rays.
+        // ====================================================================
+        [[nodiscard]] std::array<vk::DescriptorBufferInfo, 3> ray_buffers() const noexcept;
+
+        RayPool(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, upload::Uploader& uploader, vk::DescriptorSetLayout cull_layout, const PoolInfo& info);
+        ~RayPool()                         = default;
+        RayPool(const RayPool&)            = delete;
+        RayPool& operator=(const RayPool&) = delete;
+        RayPool(RayPool&&)                 = delete;
+        RayPool& operator=(RayPool&&)      = delete;
+
+    private:
+        // ====================================================================
+        // Indirect commands + draw count, rewritten by the cull pass each
+        // frame, so one copy per frame in flight.
+        // ====================================================================
+        struct FrameBuffers {
+            upload::GpuBuffer commands;
+            upload::GpuBuffer count;
+            vk::raii::DescriptorSet set{nullptr};
+        };
+
+        static constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+        PoolInfo info{};
+        // Slots handed out at least once, landed chunks, and the landed
+        // high-water mark.
+        std::uint32_t allocated = 0;
+        std::uint32_t resident  = 0;
+        std::uint32_t range     = 0;
+        // Evicted slots, reused before new ones.
+        std::vector<std::uint32_t> free_slots;
+
+        // dataset::RayRecord per ray, pulled by the vertex shader.
+        upload::GpuBuffer records;
+        // Per slot: positions of the selected records, front-packed; the
+        // vertex shader draws selection entries, not records directly.
+        upload::GpuBuffer selection;
+        // 0, 1, 2, ... shared by every slot (vertexOffset picks the slot).
+        upload::GpuBuffer indices;
+        upload::GpuBuffer chunk_info;
+        // CPU mirror of chunk_info, chunk index -> slot, and 0, 1, 2, ...
+        // (the selection of a freshly uploaded slot).
+        std::vector<ChunkInfo> slot_info;
+        std::vector<std::uint32_t> chunk_slots;
+        std::vector<std::uint32_t> identity;
+
+        vk::raii::DescriptorPool descriptor_pool{nullptr};
+        std::vector<FrameBuffers> frames;
+        // Matches the ray pipeline's set 0 (draw_bindings), so it binds there.
+        vk::raii::DescriptorSetLayout draw_layout{nullptr};
+        vk::raii::DescriptorSet draw_set{nullptr};
+    };
+} // namespace pngp::vis::rays::pool
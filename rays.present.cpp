@@ -0,0 +1,177 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.present;
+// ============================================================================
+// Viewer swapchain implementation.
+// ============================================================================
+import std;
+import pngp.vis.rays.upload;
+
+// ============================================================================
+// Translation-unit helpers (format and mode selection).
+// ============================================================================
+namespace {
+    // An sRGB target matches the sRGB-aware ImGui textures and the scene's
+    // linear shading; anything else falls back to the first offered.
+    vk::SurfaceFormatKHR pick_surface_format(const std::span<const vk::SurfaceFormatKHR> formats) {
+        if (formats.empty()) throw std::runtime_error("surface offers no formats");
+        for (const vk::Format preferred : {vk::Format::eB8G8R8A8Srgb, vk::Format::eR8G8B8A8Srgb}) {
+            const auto it = std::ranges::find_if(formats, [&](const vk::SurfaceFormatKHR& f) { return f.format == preferred && f.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear; });
+            if (it != formats.end()) return *it;
+        }
+        return formats.front();
+    }
+
+    vk::Format pick_depth_format(const vk::raii::PhysicalDevice& physical_device) {
+        for (const vk::Format format : {vk::Format::eD32Sfloat, vk::Format::eD24UnormS8Uint, vk::Format::eD32SfloatS8Uint}) {
+            if (physical_device.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment) return format;
+        }
+        throw std::runtime_error("no depth attachment format");
+    }
+
+    vk::CompositeAlphaFlagBitsKHR pick_composite_alpha(const vk::CompositeAlphaFlagsKHR supported) {
+        for (const auto alpha : {vk::CompositeAlphaFlagBitsKHR::eOpaque, vk::CompositeAlphaFlagBitsKHR::eInherit, vk::CompositeAlphaFlagBitsKHR::ePreMultiplied, vk::CompositeAlphaFlagBitsKHR::ePostMultiplied}) {
+            if (supported & alpha) return alpha;
+        }
+        return vk::CompositeAlphaFlagBitsKHR::eOpaque;
+    }
+} // namespace
+
+std::optional<vk::PresentModeKHR> pngp::vis::rays::present::parse_present_mode(const std::string_view name) {
+    if (name == "fifo") return vk::PresentModeKHR::eFifo;
+    if (name == "mailbox") return vk::PresentModeKHR::eMailbox;
+    if (name == "immediate") return vk::PresentModeKHR::eImmediate;
+    return std::nullopt;
+}
+
+// ============================================================================
+// Constructor: formats and present mode are fixed for the surface; the
+// images are (re)built by recreate().
+// ============================================================================
+pngp::vis::rays::present::Swapchain::Swapchain(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const vk::SurfaceKHR surface, const std::uint32_t queue_family, const vk::Extent2D framebuffer, const SwapchainInfo& info)
+    : physical_device(&physical_device), device(&device), surface(surface), info(info) {
+    if (info.frames_in_flight == 0) throw std::invalid_argument("Swapchain: at least one frame in flight");
+    if (!physical_device.getSurfaceSupportKHR(queue_family, surface)) throw std::runtime_error(std::format("queue family {} cannot present to the surface", queue_family));
+
+    surface_format      = pick_surface_format(physical_device.getSurfaceFormatsKHR(surface));
+    depth_target_format = pick_depth_format(physical_device);
+
+    // FIFO is the one mode every surface has.
+    const auto modes = physical_device.getSurfacePresentModesKHR(surface);
+    mode             = std::ranges::contains(modes, info.present_mode) ? info.present_mode : vk::PresentModeKHR::eFifo;
+
+    for (std::uint32_t i = 0; i < info.frames_in_flight; ++i) image_acquired.emplace_back(device, vk::SemaphoreCreateInfo{});
+    if (!recreate(framebuffer, 0)) throw std::runtime_error("window has no framebuffer to present to");
+}
+
+// ============================================================================
+// One image more than the frames in flight, so a full pipeline of frames
+// never waits in acquire for the display to release one.
+// ============================================================================
+bool pngp::vis::rays::present::Swapchain::recreate(const vk::Extent2D framebuffer, const std::uint64_t release_value) {
+    const auto caps = physical_device->getSurfaceCapabilitiesKHR(surface);
+
+    vk::Extent2D extent = caps.currentExtent;
+    if (extent.width == std::numeric_limits<std::uint32_t>::max()) {
+        extent.width  = std::clamp(framebuffer.width, caps.minImageExtent.width, caps.maxImageExtent.width);
+        extent.height = std::clamp(framebuffer.height, caps.minImageExtent.height, caps.maxImageExtent.height);
+    }
+    if (extent.width == 0 || extent.height == 0) return false;
+
+    std::uint32_t count = std::max(caps.minImageCount + 1, info.frames_in_flight + 1);
+    if (caps.maxImageCount > 0) count = std::min(count, caps.maxImageCount);
+
+    // Only color attachment usage is guaranteed; transfer source feeds
+    // screenshots and frame captures where the surface offers it.
+    const bool next_transfer_src = static_cast<bool>(caps.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc);
+    vk::ImageUsageFlags usage    = vk::ImageUsageFlagBits::eColorAttachment;
+    if (next_transfer_src) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+    vk::raii::SwapchainKHR next(*device, vk::SwapchainCreateInfoKHR{
+                                             .surface          = surface,
+                                             .minImageCount    = count,
+                                             .imageFormat      = surface_format.format,
+                                             .imageColorSpace  = surface_format.colorSpace,
+                                             .imageExtent      = extent,
+                                             .imageArrayLayers = 1,
+                                             .imageUsage       = usage,
+                                             .imageSharingMode = vk::SharingMode::eExclusive,
+                                             .preTransform     = caps.currentTransform,
+                                             .compositeAlpha   = pick_composite_alpha(caps.supportedCompositeAlpha),
+                                             .presentMode      = mode,
+                                             .clipped          = true,
+                                             .oldSwapchain     = *swapchain,
+                                         });
+
+    // ========================================================================
+    // Frames in flight still render to the old images and its presents may
+    // still wait on its semaphores, so the whole generation is retired; the
+    // new one gets fresh present semaphores.
+    // ========================================================================
+    if (*swapchain) retired.push_back({release_value, std::move(swapchain), std::move(views), std::move(depth), std::move(present_ready)});
+    views.clear();
+    present_ready.clear();
+    swapchain    = std::move(next);
+    images       = swapchain.getImages();
+    image_extent = extent;
+    transfer_src = next_transfer_src;
+    layouts.assign(images.size(), vk::ImageLayout::eUndefined);
+    for (const vk::Image image : images) {
+        views.emplace_back(*device, vk::ImageViewCreateInfo{
+                                        .image            = image,
+                                        .viewType         = vk::ImageViewType::e2D,
+                                        .format           = surface_format.format,
+                                        .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
+                                    });
+    }
+
+    depth              = upload::create_image(*physical_device, *device, extent, depth_target_format, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth);
+    depth_image_layout = vk::ImageLayout::eUndefined;
+
+    for (std::size_t i = 0; i < images.size(); ++i) present_ready.emplace_back(*device, vk::SemaphoreCreateInfo{});
+    return true;
+}
+
+void pngp::vis::rays::present::Swapchain::collect(const std::uint64_t completed) {
+    while (!retired.empty() && retired.front().release_value <= completed) retired.pop_front();
+}
+
+std::optional<std::uint32_t> pngp::vis::rays::present::Swapchain::acquire(const std::uint32_t frame_slot) {
+    try {
+        const auto [result, image_index] = swapchain.acquireNextImage(std::numeric_limits<std::uint64_t>::max(), *image_acquired[frame_slot]);
+        return image_index;
+    } catch (const vk::OutOfDateKHRError&) {
+        return std::nullopt;
+    }
+}
+
+vk::SemaphoreSubmitInfo pngp::vis::rays::present::Swapchain::acquire_wait(const std::uint32_t frame_slot) const {
+    return vk::SemaphoreSubmitInfo{
+        .semaphore = *image_acquired[frame_slot],
+        .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+    };
+}
+
+vk::SemaphoreSubmitInfo pngp::vis::rays::present::Swapchain::present_signal(const std::uint32_t image_index) const {
+    return vk::SemaphoreSubmitInfo{
+        .semaphore = *present_ready[image_index],
+        .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    };
+}
+
+bool pngp::vis::rays::present::Swapchain::present(const vk::raii::Queue& queue, const std::uint32_t image_index) {
+    const vk::Semaphore wait      = *present_ready[image_index];
+    const vk::SwapchainKHR handle = *swapchain;
+    try {
+        const vk::Result result = queue.presentKHR(vk::PresentInfoKHR{
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores    = &wait,
+            .swapchainCount     = 1,
+            .pSwapchains        = &handle,
+            .pImageIndices      = &image_index,
+        });
+        return result == vk::Result::eSuccess;
+    } catch (const vk::OutOfDateKHRError&) {
+        return false;
+    }
+}
@@ -0,0 +1,127 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.present;
+// ============================================================================
+// Viewer swapchain: the present mode is chosen per deployment (mailbox,
+// FIFO or immediate; FIFO when the surface lacks the one asked for), with
+// a depth target and per-image layout tracking. Acquire waits use one
+// binary semaphore per frame slot, present waits one per image: an image's
+// last present may still hold its semaphore when another slot acquires.
+// A rebuild retires the old images, views, depth target and present
+// semaphores together, keyed on a frame timeline value, instead of idling.
+// ============================================================================
+import pngp.vis.rays.upload;
+import std;
+
+namespace pngp::vis::rays::present {
+    // "fifo", "mailbox" or "immediate" (command-line spelling).
+    export [[nodiscard]] std::optional<vk::PresentModeKHR> parse_present_mode(std::string_view name);
+
+    export struct SwapchainInfo {
+        vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+        std::uint32_t frames_in_flight  = 2;
+    };
+
+    export class Swapchain {
+    public:
+        // ====================================================================
+        // Next image for this frame slot, or nullopt when the swapchain is
+        // out of date (recreate, then try again). A suboptimal image is
+        // still handed out; present() reports it afterwards.
+        // ====================================================================
+        [[nodiscard]] std::optional<std::uint32_t> acquire(std::uint32_t frame_slot);
+        // The frame's submit waits acquire_wait and signals present_signal.
+        [[nodiscard]] vk::SemaphoreSubmitInfo acquire_wait(std::uint32_t frame_slot) const;
+        [[nodiscard]] vk::SemaphoreSubmitInfo present_signal(std::uint32_t image_index) const;
+        // Queue the image for display; false when the swapchain needs to be
+        // recreated.
+        [[nodiscard]] bool present(const vk::raii::Queue& queue, std::uint32_t image_index);
+        // ====================================================================
+        // Rebuild for the window's framebuffer size; false (nothing changed)
+        // while it is zero, e.g. minimized. The old generation is kept until
+        // collect() sees release_value completed.
+        // ====================================================================
+        bool recreate(vk::Extent2D framebuffer, std::uint64_t release_value);
+        // Free retired generations once the timeline reaches their value.
+        void collect(std::uint64_t completed);
+
+        [[nodiscard]] vk::Format format() const noexcept {
+            return surface_format.format;
+        }
+        [[nodiscard]] vk::Format depth_format() const noexcept {
+            return depth_target_format;
+        }
+        [[nodiscard]] vk::Extent2D extent() const noexcept {
+            return image_extent;
+        }
+        // What the surface granted, which may differ from what was asked.
+        [[nodiscard]] vk::PresentModeKHR present_mode() const noexcept {
+            return mode;
+        }
+        // Images can be copied from (screenshots, frame captures); only when
+        // the surface supports transfer-src usage.
+        [[nodiscard]] bool transfer_source() const noexcept {
+            return transfer_src;
+        }
+        [[nodiscard]] std::uint32_t image_count() const noexcept {
+            return static_cast<std::uint32_t>(images.size());
+        }
+        [[nodiscard]] vk::Image image(const std::uint32_t image_index) const {
+            return images[image_index];
+        }
+        [[nodiscard]] vk::ImageView view(const std::uint32_t image_index) const {
+            return *views[image_index];
+        }
+        [[nodiscard]] vk::ImageLayout& layout(const std::uint32_t image_index) {
+            return layouts[image_index];
+        }
+        [[nodiscard]] vk::Image depth_image() const noexcept {
+            return *depth.image;
+        }
+        [[nodiscard]] vk::ImageView depth_view() const noexcept {
+            return *depth.view;
+        }
+        [[nodiscard]] vk::ImageLayout& depth_layout() noexcept {
+            return depth_image_layout;
+        }
+
+        Swapchain(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, vk::SurfaceKHR surface, std::uint32_t queue_family, vk::Extent2D framebuffer, const SwapchainInfo& info);
+        ~Swapchain()                           = default;
+        Swapchain(const Swapchain&)            = delete;
+        Swapchain& operator=(const Swapchain&) = delete;
+        Swapchain(Swapchain&&)                 = delete;
+        Swapchain& operator=(Swapchain&&)      = delete;
+
+    private:
+        // Swapchain first: its views go before it.
+        struct Generation {
+            std::uint64_t release_value = 0;
+            vk::raii::SwapchainKHR swapchain{nullptr};
+            std::vector<vk::raii::ImageView> views;
+            upload::GpuImage depth;
+            std::vector<vk::raii::Semaphore> present_ready;
+        };
+
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        const vk::raii::Device* device                  = nullptr;
+        vk::SurfaceKHR surface{};
+        SwapchainInfo info{};
+
+        vk::SurfaceFormatKHR surface_format{};
+        vk::Format depth_target_format = vk::Format::eUndefined;
+        vk::PresentModeKHR mode        = vk::PresentModeKHR::eFifo;
+        vk::Extent2D image_extent{};
+        bool transfer_src = false;
+
+        vk::raii::SwapchainKHR swapchain{nullptr};
+        std::vector<vk::Image> images;
+        std::vector<vk::raii::ImageView> views;
+        std::vector<vk::ImageLayout> layouts;
+        upload::GpuImage depth;
+        vk::ImageLayout depth_image_layout = vk::ImageLayout::eUndefined;
+
+        std::vector<vk::raii::Semaphore> image_acquired;
+        std::vector<vk::raii::Semaphore> present_ready;
+        std::deque<Generation> retired;
+    };
+} // namespace pngp::vis::rays::present
@@ -0,0 +1,238 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.profiler;
+// ============================================================================
+// Frame profiler implementation.
+// ============================================================================
+import std;
+
+// ============================================================================
+// Translation-unit helpers.
+// ============================================================================
+namespace {
+    constexpr std::uint32_t no_query = std::numeric_limits<std::uint32_t>::max();
+    constexpr int cpu_track          = 1;
+    constexpr int gpu_track          = 2;
+} // namespace
+
+// ============================================================================
+// Scopes.
+// ============================================================================
+pngp::vis::rays::profiler::CpuScope::CpuScope(Profiler* profiler, const char* name) : profiler(profiler && profiler->in_frame ? profiler : nullptr), name(name) {
+    if (!this->profiler) return;
+    start_us = this->profiler->now_us();
+    depth    = this->profiler->cpu_depth++;
+}
+
+pngp::vis::rays::profiler::CpuScope::~CpuScope() {
+    if (!profiler) return;
+    --profiler->cpu_depth;
+    profiler->current.cpu.push_back({name, start_us, profiler->now_us() - start_us, depth});
+}
+
+pngp::vis::rays::profiler::GpuScope::GpuScope(Profiler* profiler, const vk::raii::CommandBuffer& cmd, const char* name) : profiler(profiler), cmd(&cmd) {
+    if (profiler) query = profiler->gpu_scope_begin(cmd, name);
+}
+
+pngp::vis::rays::profiler::GpuScope::GpuScope(Profiler* profiler, const vk::raii::CommandBuffer& cmd, const ReservedGpuScope reserved) : profiler(profiler), cmd(&cmd), query(reserved.query), reserved(true) {
+    if (profiler && query != no_query) profiler->write_timestamp(cmd, query, false);
+}
+
+pngp::vis::rays::profiler::GpuScope::~GpuScope() {
+    if (!profiler || query == no_query) return;
+    if (reserved) profiler->write_timestamp(*cmd, query, true);
+    else profiler->gpu_scope_end(*cmd, query);
+}
+
+// ============================================================================
+// Profiler: one query range of 2 * max_gpu_scopes timestamps per slot.
+// ============================================================================
+pngp::vis::rays::profiler::Profiler::Profiler(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const std::uint32_t queue_family, const ProfilerInfo& info)
+    : info(info), epoch(std::chrono::steady_clock::now()) {
+    slots.resize(info.frames_in_flight);
+
+    const auto families = physical_device.getQueueFamilyProperties();
+    const auto bits     = families[queue_family].timestampValidBits;
+    if (bits == 0 || info.max_gpu_scopes == 0) return;
+
+    timestamp_period_ns = physical_device.getProperties().limits.timestampPeriod;
+    timestamp_mask      = bits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << bits) - 1;
+    queries             = vk::raii::QueryPool(device, vk::QueryPoolCreateInfo{
+                                                      .queryType  = vk::QueryType::eTimestamp,
+                                                      .queryCount = 2 * info.max_gpu_scopes * info.frames_in_flight,
+                                                  });
+}
+
+double pngp::vis::rays::profiler::Profiler::now_us() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void pngp::vis::rays::profiler::Profiler::begin_frame() {
+    // A frame abandoned before submit (swapchain recreate) still closes here.
+    if (in_frame) end_frame();
+
+    current        = FrameTrace{.frame = frame_number++};
+    frame_start_us = now_us();
+    cpu_depth      = 1;
+    in_frame       = true;
+}
+
+void pngp::vis::rays::profiler::Profiler::begin_commands(const vk::raii::CommandBuffer& cmd, const std::uint32_t frame_index) {
+    collect_gpu(frame_index);
+
+    Slot& slot     = slots[frame_index];
+    slot.frame     = current.frame;
+    gpu_depth      = 0;
+    recording_slot = frame_index;
+    if (*queries) cmd.resetQueryPool(*queries, 2 * info.max_gpu_scopes * frame_index, 2 * info.max_gpu_scopes);
+}
+
+void pngp::vis::rays::profiler::Profiler::end_frame() {
+    if (!in_frame) return;
+    const double end_us = now_us();
+
+    if (recording_slot) slots[*recording_slot].submit_us = end_us;
+    recording_slot.reset();
+
+    current.cpu.push_back({"frame", frame_start_us, end_us - frame_start_us, 0});
+    in_frame = false;
+
+    // ========================================================================
+    // Same-named scopes within a frame add up before entering the history.
+    // ========================================================================
+    std::vector<std::pair<const char*, double>> totals;
+    for (const TraceEvent& e : current.cpu) {
+        const auto it = std::ranges::find_if(totals, [&](const auto& t) { return std::string_view(t.first) == e.name; });
+        if (it == totals.end()) totals.emplace_back(e.name, e.duration_us);
+        else it->second += e.duration_us;
+    }
+    for (const auto& [name, us] : totals) push_sample(cpu_rolling, name, us * 1e-3);
+
+    trace.push_back(std::move(current));
+    while (trace.size() > info.trace_frames) trace.pop_front();
+    current = FrameTrace{};
+}
+
+std::uint32_t pngp::vis::rays::profiler::Profiler::gpu_scope_begin(const vk::raii::CommandBuffer& cmd, const char* name) {
+    if (!*queries || !recording_slot) return no_query;
+    Slot& slot = slots[*recording_slot];
+    if (slot.scopes.size() >= info.max_gpu_scopes) return no_query;
+
+    const auto local = static_cast<std::uint32_t>(slot.scopes.size());
+    slot.scopes.push_back({name, gpu_depth++});
+    write_timestamp(cmd, local, false);
+    return local;
+}
+
+void pngp::vis::rays::profiler::Profiler::gpu_scope_end(const vk::raii::CommandBuffer& cmd, const std::uint32_t query) {
+    if (!recording_slot) return;
+    --gpu_depth;
+    write_timestamp(cmd, query, true);
+}
+
+pngp::vis::rays::profiler::ReservedGpuScope pngp::vis::rays::profiler::Profiler::reserve_gpu_scope(const char* name) {
+    if (!*queries || !recording_slot) return {};
+    Slot& slot = slots[*recording_slot];
+    if (slot.scopes.size() >= info.max_gpu_scopes) return {};
+
+    slot.scopes.push_back({name, gpu_depth});
+    return {static_cast<std::uint32_t>(slot.scopes.size() - 1)};
+}
+
+void pngp::vis::rays::profiler::Profiler::write_timestamp(const vk::raii::CommandBuffer& cmd, const std::uint32_t query, const bool end) const {
+    if (!recording_slot) return;
+    const std::uint32_t index = 2 * info.max_gpu_scopes * *recording_slot + 2 * query + (end ? 1 : 0);
+    cmd.writeTimestamp2(end ? vk::PipelineStageFlagBits2::eBottomOfPipe : vk::PipelineStageFlagBits2::eTopOfPipe, *queries, index);
+}
+
+// ============================================================================
+// The slot's last frame is done, so its timestamps are final: read them
+// without eWait and drop the frame if the driver disagrees.
+// ============================================================================
+void pngp::vis::rays::profiler::Profiler::collect_gpu(const std::uint32_t slot_index) {
+    Slot& slot = slots[slot_index];
+    if (!*queries || slot.scopes.empty()) return;
+
+    const auto count           = static_cast<std::uint32_t>(2 * slot.scopes.size());
+    const auto [result, ticks] = queries.getResults<std::uint64_t>(2 * info.max_gpu_scopes * slot_index, count, count * sizeof(std::uint64_t), sizeof(std::uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        slot.scopes.clear();
+        return;
+    }
+
+    const auto trace_it = std::ranges::find_if(trace, [&](const FrameTrace& f) { return f.frame == slot.frame; });
+    const auto to_us    = [&](const std::uint64_t delta) { return static_cast<double>(delta & timestamp_mask) * timestamp_period_ns * 1e-3; };
+
+    std::vector<std::pair<const char*, double>> totals;
+    for (std::size_t i = 0; i < slot.scopes.size(); ++i) {
+        const double start_us    = to_us(ticks[2 * i] - ticks[0]);
+        const double duration_us = to_us(ticks[2 * i + 1] - ticks[2 * i]);
+        const PendingScope& s    = slot.scopes[i];
+
+        if (trace_it != trace.end()) trace_it->gpu.push_back({s.name, slot.submit_us + start_us, duration_us, s.depth});
+
+        const auto it = std::ranges::find_if(totals, [&](const auto& t) { return std::string_view(t.first) == s.name; });
+        if (it == totals.end()) totals.emplace_back(s.name, duration_us);
+        else it->second += duration_us;
+    }
+    for (const auto& [name, us] : totals) push_sample(gpu_rolling, name, us * 1e-3);
+    slot.scopes.clear();
+}
+
+void pngp::vis::rays::profiler::Profiler::push_sample(std::vector<Rolling>& table, const char* name, const double ms) const {
+    auto it = std::ranges::find_if(table, [&](const Rolling& r) { return std::string_view(r.name) == name; });
+    if (it == table.end()) {
+        table.push_back({.name = name});
+        it = std::prev(table.end());
+    }
+    if (it->samples.size() < info.history) {
+        it->samples.push_back(ms);
+    } else {
+        it->samples[it->next] = ms;
+        it->next              = (it->next + 1) % it->samples.size();
+    }
+}
+
+std::vector<pngp::vis::rays::profiler::ScopeStats> pngp::vis::rays::profiler::Profiler::summarize(const std::vector<Rolling>& table) {
+    std::vector<ScopeStats> out;
+    out.reserve(table.size());
+    for (const Rolling& r : table) {
+        if (r.samples.empty()) continue;
+        ScopeStats s{.name = r.name};
+        s.avg_ms = std::accumulate(r.samples.begin(), r.samples.end(), 0.0) / static_cast<double>(r.samples.size());
+        s.max_ms = std::ranges::max(r.samples);
+        out.push_back(s);
+    }
+    return out;
+}
+
+std::vector<pngp::vis::rays::profiler::ScopeStats> pngp::vis::rays::profiler::Profiler::cpu_stats() const {
+    return summarize(cpu_rolling);
+}
+
+std::vector<pngp::vis::rays::profiler::ScopeStats> pngp::vis::rays::profiler::Profiler::gpu_stats() const {
+    return summarize(gpu_rolling);
+}
+
+// ============================================================================
+// Chrome trace: complete ("X") events in microseconds, one track each for
+// the main thread and the graphics queue.
+// ============================================================================
+bool pngp::vis::rays::profiler::Profiler::export_chrome_trace(const std::filesystem::path& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out << std::format(R"(  {{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, "args": {{"name": "CPU main"}}}},)", cpu_track) << '\n';
+    out << std::format(R"(  {{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, "args": {{"name": "GPU queue"}}}})", gpu_track);
+
+    const auto write_event = [&](const TraceEvent& e, const int track, const char* category, const std::uint64_t frame) {
+        out << std::format(",\n  {{\"name\": \"{}\", \"cat\": \"{}\", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, \"pid\": 1, \"tid\": {}, \"args\": {{\"frame\": {}}}}}", e.name, category, e.start_us, e.duration_us, track, frame);
+    };
+    for (const FrameTrace& f : trace) {
+        for (const TraceEvent& e : f.cpu) write_event(e, cpu_track, "cpu", f.frame);
+        for (const TraceEvent& e : f.gpu) write_event(e, gpu_track, "gpu", f.frame);
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
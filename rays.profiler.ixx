@@ -0,0 +1,186 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.profiler;
+// ============================================================================
+// Frame profiler: CPU scoped timers, GPU timestamp scopes per frame slot, a
+// rolling per-scope breakdown, and Chrome trace export.
+// ============================================================================
+import std;
+
+namespace pngp::vis::rays::profiler {
+    // ========================================================================
+    // Rolling average/max over the last `history` frames, in milliseconds.
+    // ========================================================================
+    export struct ScopeStats {
+        const char* name = "";
+        double avg_ms    = 0.0;
+        double max_ms    = 0.0;
+    };
+
+    export struct ProfilerInfo {
+        std::uint32_t frames_in_flight = 2;
+        // GPU scopes per frame; extra scopes are dropped silently.
+        std::uint32_t max_gpu_scopes = 32;
+        // Frames kept for the rolling breakdown.
+        std::uint32_t history = 120;
+        // Frames kept for trace export.
+        std::uint32_t trace_frames = 300;
+    };
+
+    export class Profiler;
+
+    // ========================================================================
+    // Host-side timer; names must outlive the profiler (use literals).
+    // A null profiler makes the scope a no-op.
+    // ========================================================================
+    export class CpuScope {
+    public:
+        CpuScope(Profiler* profiler, const char* name);
+        ~CpuScope();
+        CpuScope(const CpuScope&)            = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+        CpuScope(CpuScope&&)                 = delete;
+        CpuScope& operator=(CpuScope&&)      = delete;
+
+    private:
+        Profiler* profiler  = nullptr;
+        const char* name    = "";
+        double start_us     = 0.0;
+        std::uint32_t depth = 0;
+    };
+
+    // ========================================================================
+    // GPU scope claimed on the main thread for commands that another thread
+    // records (secondary command buffers); see Profiler::reserve_gpu_scope.
+    // ========================================================================
+    export struct ReservedGpuScope {
+        std::uint32_t query = std::numeric_limits<std::uint32_t>::max();
+    };
+
+    // ========================================================================
+    // Pair of timestamps around commands recorded while the scope is alive.
+    // The reserved form touches no profiler state, so any thread may use it.
+    // ========================================================================
+    export class GpuScope {
+    public:
+        GpuScope(Profiler* profiler, const vk::raii::CommandBuffer& cmd, const char* name);
+        GpuScope(Profiler* profiler, const vk::raii::CommandBuffer& cmd, ReservedGpuScope reserved);
+        ~GpuScope();
+        GpuScope(const GpuScope&)            = delete;
+        GpuScope& operator=(const GpuScope&) = delete;
+        GpuScope(GpuScope&&)                 = delete;
+        GpuScope& operator=(GpuScope&&)      = delete;
+
+    private:
+        Profiler* profiler                 = nullptr;
+        const vk::raii::CommandBuffer* cmd = nullptr;
+        std::uint32_t query                = std::numeric_limits<std::uint32_t>::max();
+        bool reserved                      = false;
+    };
+
+    // ========================================================================
+    // Main-thread profiler. Per frame:
+    //   begin_frame() -> [acquire] -> begin_commands(cmd, slot) -> scopes
+    //   -> submit/present -> end_frame()
+    // GPU results for a slot are read in the next begin_commands() for that
+    // slot, after its last frame is done, so reads never wait.
+    // ========================================================================
+    export class Profiler {
+    public:
+        void begin_frame();
+        // Collects the slot's previous results and resets its query range.
+        void begin_commands(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index);
+        void end_frame();
+        // ====================================================================
+        // Claim a GPU scope at the current nesting depth for a command buffer
+        // recorded elsewhere; it runs within this slot's primary submission.
+        // ====================================================================
+        [[nodiscard]] ReservedGpuScope reserve_gpu_scope(const char* name);
+
+        [[nodiscard]] std::vector<ScopeStats> cpu_stats() const;
+        [[nodiscard]] std::vector<ScopeStats> gpu_stats() const;
+        [[nodiscard]] bool gpu_supported() const noexcept {
+            return static_cast<bool>(*queries);
+        }
+        // Write the retained frames as Chrome trace JSON (chrome://tracing,
+        // Perfetto). GPU events sit on their own track, anchored at the
+        // frame's submit time since host and device clocks are not calibrated.
+        bool export_chrome_trace(const std::filesystem::path& path) const;
+
+        Profiler(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, std::uint32_t queue_family, const ProfilerInfo& info);
+        ~Profiler()                          = default;
+        Profiler(const Profiler&)            = delete;
+        Profiler& operator=(const Profiler&) = delete;
+        Profiler(Profiler&&)                 = delete;
+        Profiler& operator=(Profiler&&)      = delete;
+
+    private:
+        friend class CpuScope;
+        friend class GpuScope;
+
+        struct TraceEvent {
+            const char* name    = "";
+            double start_us     = 0.0;
+            double duration_us  = 0.0;
+            std::uint32_t depth = 0;
+        };
+
+        struct FrameTrace {
+            std::uint64_t frame = 0;
+            std::vector<TraceEvent> cpu;
+            std::vector<TraceEvent> gpu;
+        };
+
+        struct PendingScope {
+            const char* name    = "";
+            std::uint32_t depth = 0;
+        };
+
+        // Query range [slot * max_gpu_scopes * 2, ...) belongs to one slot.
+        struct Slot {
+            std::vector<PendingScope> scopes;
+            std::uint64_t frame = 0;
+            double submit_us    = 0.0;
+        };
+
+        struct Rolling {
+            const char* name = "";
+            std::vector<double> samples;
+            std::size_t next = 0;
+        };
+
+        [[nodiscard]] double now_us() const;
+        std::uint32_t gpu_scope_begin(const vk::raii::CommandBuffer& cmd, const char* name);
+        void gpu_scope_end(const vk::raii::CommandBuffer& cmd, std::uint32_t query);
+        void write_timestamp(const vk::raii::CommandBuffer& cmd, std::uint32_t query, bool end) const;
+        void collect_gpu(std::uint32_t slot_index);
+        void push_sample(std::vector<Rolling>& table, const char* name, double ms) const;
+        [[nodiscard]] static std::vector<ScopeStats> summarize(const std::vector<Rolling>& table);
+
+        ProfilerInfo info{};
+        std::chrono::steady_clock::time_point epoch{};
+        // ====================================================================
+        // GPU timestamps.
+        // ====================================================================
+        vk::raii::QueryPool queries{nullptr};
+        double timestamp_period_ns   = 0.0;
+        std::uint64_t timestamp_mask = ~std::uint64_t{0};
+        std::vector<Slot> slots;
+        std::optional<std::uint32_t> recording_slot{};
+        std::uint32_t gpu_depth = 0;
+        // ====================================================================
+        // CPU frame state.
+        // ====================================================================
+        std::uint64_t frame_number = 0;
+        double frame_start_us      = 0.0;
+        std::uint32_t cpu_depth    = 0;
+        FrameTrace current{};
+        bool in_frame = false;
+        // ====================================================================
+        // Rolling breakdown + trace history.
+        // ====================================================================
+        std::vector<Rolling> cpu_rolling;
+        std::vector<Rolling> gpu_rolling;
+        std::deque<FrameTrace> trace;
+    };
+} // namespace pngp::vis::rays::profiler
@@ -0,0 +1,167 @@
+module pngp.vis.rays.replay;
+// ============================================================================
+// Input recording implementation.
+// ============================================================================
+import std;
+import vk.camera;
+import pngp.vis.rays.scene;
+
+// ============================================================================
+// Translation-unit helpers (field tables, byte packing).
+// ============================================================================
+namespace {
+    using CameraInput  = vk::camera::CameraInput;
+    using GridSettings = pngp::vis::rays::GridSettings;
+
+    // Bit i of the button mask is button_fields[i]; append only, the order is
+    // part of the file format.
+    constexpr std::array<bool CameraInput::*, 13> button_fields{
+        &CameraInput::lmb,
+        &CameraInput::mmb,
+        &CameraInput::rmb,
+        &CameraInput::shift,
+        &CameraInput::ctrl,
+        &CameraInput::alt,
+        &CameraInput::space,
+        &CameraInput::forward,
+        &CameraInput::backward,
+        &CameraInput::left,
+        &CameraInput::right,
+        &CameraInput::down,
+        &CameraInput::up,
+    };
+
+    constexpr std::array<bool GridSettings::*, 5> grid_toggles{
+        &GridSettings::show_grid,
+        &GridSettings::show_axes,
+        &GridSettings::show_origin,
+        &GridSettings::fly_mode,
+        &GridSettings::infinite,
+    };
+
+    // Flags byte: which optional payloads follow dt.
+    constexpr std::uint8_t has_mouse  = 1u << 0;
+    constexpr std::uint8_t has_scroll = 1u << 1;
+    constexpr std::uint8_t has_grid   = 1u << 2;
+
+    template <typename T>
+    void put(std::vector<std::byte>& out, const T& value) {
+        const auto bytes = std::as_bytes(std::span{&value, 1});
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    // ========================================================================
+    // Bounds-checked cursor over the file; running off the end throws.
+    // ========================================================================
+    struct Reader {
+        std::span<const std::byte> bytes;
+        std::size_t offset = 0;
+
+        template <typename T>
+        T get() {
+            if (bytes.size() - offset < sizeof(T)) throw std::runtime_error("input recording: truncated");
+            T value{};
+            std::memcpy(&value, bytes.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return value;
+        }
+    };
+
+    void put_grid(std::vector<std::byte>& out, const GridSettings& grid) {
+        std::uint8_t toggles = 0;
+        for (std::size_t i = 0; i < grid_toggles.size(); ++i) toggles |= static_cast<std::uint8_t>(grid.*grid_toggles[i] ? 1u << i : 0u);
+        put(out, toggles);
+        put(out, grid.grid_extent);
+        put(out, grid.grid_step);
+        put(out, static_cast<std::int32_t>(grid.major_every));
+        put(out, grid.axis_length);
+        put(out, grid.origin_scale);
+        put(out, grid.fade_distance);
+    }
+
+    GridSettings get_grid(Reader& in, const std::uint32_t version) {
+        GridSettings grid{};
+        const auto toggles = in.get<std::uint8_t>();
+        for (std::size_t i = 0; i < grid_toggles.size(); ++i) grid.*grid_toggles[i] = (toggles >> i & 1u) != 0;
+        grid.grid_extent  = in.get<float>();
+        grid.grid_step    = in.get<float>();
+        grid.major_every  = in.get<std::int32_t>();
+        grid.axis_length  = in.get<float>();
+        grid.origin_scale = in.get<float>();
+        if (version >= 2) grid.fade_distance = in.get<float>();
+        return grid;
+    }
+} // namespace
+
+void pngp::vis::rays::replay::write_recording(const std::filesystem::path& path, const std::span<const InputFrame> frames) {
+    std::vector<std::byte> out;
+    out.reserve(16 + frames.size() * 8);
+    put(out, recording_magic);
+    put(out, recording_version);
+    put(out, static_cast<std::uint32_t>(frames.size()));
+
+    for (const InputFrame& f : frames) {
+        std::uint16_t buttons = 0;
+        for (std::size_t i = 0; i < button_fields.size(); ++i) buttons |= static_cast<std::uint16_t>(f.input.*button_fields[i] ? 1u << i : 0u);
+
+        std::uint8_t flags = 0;
+        if (f.input.mouse_dx != 0.0f || f.input.mouse_dy != 0.0f) flags |= has_mouse;
+        if (f.input.scroll != 0.0f) flags |= has_scroll;
+        if (f.grid) flags |= has_grid;
+
+        put(out, buttons);
+        put(out, flags);
+        put(out, f.dt);
+        if (flags & has_mouse) {
+            put(out, f.input.mouse_dx);
+            put(out, f.input.mouse_dy);
+        }
+        if (flags & has_scroll) put(out, f.input.scroll);
+        if (f.grid) put_grid(out, *f.grid);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error(std::format("cannot create input recording: {}", path.string()));
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    if (!file) throw std::runtime_error(std::format("failed writing input recording: {}", path.string()));
+}
+
+std::vector<pngp::vis::rays::replay::InputFrame> pngp::vis::rays::replay::read_recording(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error(std::format("cannot open input recording: {}", path.string()));
+    const std::vector<char> raw{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    Reader in{std::as_bytes(std::span{raw})};
+    if (in.get<std::array<char, 8>>() != recording_magic) throw std::runtime_error("input recording: bad magic");
+    const auto version = in.get<std::uint32_t>();
+    if (version < 1 || version > recording_version) throw std::runtime_error(std::format("input recording: unsupported version {}", version));
+    const auto count = in.get<std::uint32_t>();
+
+    // Every frame takes at least 7 bytes, so a corrupt count cannot force a
+    // huge allocation.
+    if (count > raw.size() / 7) throw std::runtime_error("input recording: frame count out of range");
+    std::vector<InputFrame> frames(count);
+    for (InputFrame& f : frames) {
+        const auto buttons = in.get<std::uint16_t>();
+        const auto flags   = in.get<std::uint8_t>();
+        f.dt               = in.get<float>();
+        for (std::size_t i = 0; i < button_fields.size(); ++i) f.input.*button_fields[i] = (buttons >> i & 1u) != 0;
+        if (flags & has_mouse) {
+            f.input.mouse_dx = in.get<float>();
+            f.input.mouse_dy = in.get<float>();
+        }
+        if (flags & has_scroll) f.input.scroll = in.get<float>();
+        if (flags & has_grid) f.grid = get_grid(in, version);
+    }
+    return frames;
+}
+
+void pngp::vis::rays::replay::InputRecorder::record(const float dt, const vk::camera::CameraInput& input, const GridSettings& grid) {
+    InputFrame& f = recorded.emplace_back();
+    f.dt          = dt;
+    f.input       = input;
+    if (recorded.size() == 1 || grid != last_grid) {
+        f.grid    = grid;
+        last_grid = grid;
+    }
+}
@@ -0,0 +1,51 @@
+export module pngp.vis.rays.replay;
+// ============================================================================
+// Input recording: the per-frame camera input and dt the viewer feeds its
+// camera, plus ground-plane settings edits, stored compactly so a session's
+// camera path can be replayed frame for frame (viewer or headless bench)
+// and timed against other builds.
+// ============================================================================
+import vk.camera;
+import pngp.vis.rays.scene;
+import std;
+
+namespace pngp::vis::rays::replay {
+    export inline constexpr std::array<char, 8> recording_magic{'P', 'N', 'G', 'P', 'I', 'N', 'P', 'T'};
+    // Version 2 added the infinite-grid settings; version 1 files still load.
+    export inline constexpr std::uint32_t recording_version = 2;
+
+    // ========================================================================
+    // One rendered frame's camera update. dt is the value the camera saw
+    // (already clamped), so playback never consults the clock.
+    // ========================================================================
+    export struct InputFrame {
+        float dt = 0.0f;
+        vk::camera::CameraInput input{};
+        // Present on the first frame and on frames where the settings changed.
+        std::optional<GridSettings> grid{};
+    };
+
+    // ========================================================================
+    // File layout (host endianness, like ray files): magic, version, frame
+    // count, then per frame a button mask, a flags byte, dt, and only the
+    // payloads the flags announce. An idle frame takes 7 bytes.
+    // ========================================================================
+    export void write_recording(const std::filesystem::path& path, std::span<const InputFrame> frames);
+    export [[nodiscard]] std::vector<InputFrame> read_recording(const std::filesystem::path& path);
+
+    // ========================================================================
+    // Main-thread recorder: keeps grid settings only when they differ from
+    // the last frame that stored them.
+    // ========================================================================
+    export class InputRecorder {
+    public:
+        void record(float dt, const vk::camera::CameraInput& input, const GridSettings& grid);
+        [[nodiscard]] std::span<const InputFrame> frames() const noexcept {
+            return recorded;
+        }
+
+    private:
+        std::vector<InputFrame> recorded;
+        GridSettings last_grid{};
+    };
+} // namespace pngp::vis::rays::replay
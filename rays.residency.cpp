@@ -0,0 +1,165 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.residency;
+// ============================================================================
+// Residency implementation.
+// ============================================================================
+import std;
+import vk.math;
+import pngp.vis.rays.dataset;
+
+// ============================================================================
+// Memory budget: the extension struct is a physical-device query, so it
+// only needs the extension to be supported, not enabled on the device.
+// ============================================================================
+pngp::vis::rays::residency::MemoryBudget::MemoryBudget(const vk::raii::PhysicalDevice& physical_device) : physical_device(&physical_device) {
+    const auto extensions = physical_device.enumerateDeviceExtensionProperties();
+    supported             = std::ranges::any_of(extensions, [](const vk::ExtensionProperties& e) { return std::string_view(e.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME; });
+    update();
+}
+
+void pngp::vis::rays::residency::MemoryBudget::update() {
+    vk::PhysicalDeviceMemoryProperties props{};
+    std::optional<vk::PhysicalDeviceMemoryBudgetPropertiesEXT> budget;
+    if (supported) {
+        const auto chain = physical_device->getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        props            = chain.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+        budget           = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    } else {
+        props = physical_device->getMemoryProperties();
+    }
+
+    heap_budgets.resize(props.memoryHeapCount);
+    for (std::uint32_t i = 0; i < props.memoryHeapCount; ++i) {
+        HeapBudget& h  = heap_budgets[i];
+        h.size         = props.memoryHeaps[i].size;
+        h.device_local = static_cast<bool>(props.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        h.budget       = budget ? std::min(budget->heapBudget[i], h.size) : h.size;
+        h.usage        = budget ? budget->heapUsage[i] : 0;
+    }
+}
+
+vk::DeviceSize pngp::vis::rays::residency::MemoryBudget::device_local_budget() const noexcept {
+    vk::DeviceSize total = 0;
+    for (const HeapBudget& h : heap_budgets) total += h.device_local ? h.budget : 0;
+    return total;
+}
+
+vk::DeviceSize pngp::vis::rays::residency::MemoryBudget::device_local_usage() const noexcept {
+    vk::DeviceSize total = 0;
+    for (const HeapBudget& h : heap_budgets) total += h.device_local ? h.usage : 0;
+    return total;
+}
+
+pngp::vis::rays::residency::ChunkScreen pngp::vis::rays::residency::project_bounds(const vk::math::mat4& view_proj, const std::array<float, 3>& bounds_min, const std::array<float, 3>& bounds_max) {
+    const auto m = std::bit_cast<std::array<float, 16>>(view_proj);
+
+    std::uint32_t outside = 0x3F;
+    std::array ndc_lo{1.0f, 1.0f};
+    std::array ndc_hi{-1.0f, -1.0f};
+    bool straddles_eye = false;
+    for (std::uint32_t i = 0; i < 8; ++i) {
+        const std::array p{(i & 1) != 0 ? bounds_max[0] : bounds_min[0], (i & 2) != 0 ? bounds_max[1] : bounds_min[1], (i & 4) != 0 ? bounds_max[2] : bounds_min[2]};
+        std::array<float, 4> c{};
+        for (std::size_t r = 0; r < 4; ++r) c[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+
+        std::uint32_t mask = 0;
+        mask |= c[0] < -c[3] ? 0x01u : 0u;
+        mask |= c[0] > c[3] ? 0x02u : 0u;
+        mask |= c[1] < -c[3] ? 0x04u : 0u;
+        mask |= c[1] > c[3] ? 0x08u : 0u;
+        mask |= c[2] < 0.0f ? 0x10u : 0u;
+        mask |= c[2] > c[3] ? 0x20u : 0u;
+        outside &= mask;
+
+        if (c[3] <= 1e-6f) {
+            straddles_eye = true;
+            continue;
+        }
+        for (std::size_t a = 0; a < 2; ++a) {
+            const float ndc = std::clamp(c[a] / c[3], -1.0f, 1.0f);
+            ndc_lo[a]       = std::min(ndc_lo[a], ndc);
+            ndc_hi[a]       = std::max(ndc_hi[a], ndc);
+        }
+    }
+
+    ChunkScreen out{};
+    out.visible  = outside == 0;
+    out.coverage = straddles_eye ? 1.0f : std::max(0.0f, ndc_hi[0] - ndc_lo[0]) * std::max(0.0f, ndc_hi[1] - ndc_lo[1]) * 0.25f;
+    return out;
+}
+
+pngp::vis::rays::residency::ResidencyTracker::ResidencyTracker(const std::uint32_t chunk_count) : chunks(chunk_count) {}
+
+// Off-screen before on-screen; then least recently seen, or smallest.
+bool pngp::vis::rays::residency::ResidencyTracker::evict_first(const Chunk& a, const Chunk& b) noexcept {
+    if (a.visible != b.visible) return !a.visible;
+    return a.visible ? a.coverage < b.coverage : a.last_visible < b.last_visible;
+}
+
+void pngp::vis::rays::residency::ResidencyTracker::update(const vk::math::mat4& view_proj, const std::span<const dataset::ChunkRecord> records) {
+    ++frame;
+    const std::size_t count = std::min(chunks.size(), records.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        const ChunkScreen screen = project_bounds(view_proj, records[i].bounds_min, records[i].bounds_max);
+        Chunk& c                 = chunks[i];
+        // Empty chunks are never streamed, so never wanted.
+        c.visible  = screen.visible && records[i].ray_count > 0;
+        c.coverage = screen.coverage;
+        if (c.visible) c.last_visible = frame;
+    }
+}
+
+// ============================================================================
+// Requests are matched against the slots they would take, in the order
+// pick_victim hands them out, so a chunk that would lose the comparison on
+// arrival is never decoded (and a still camera stops requesting).
+// ============================================================================
+std::vector<std::uint32_t> pngp::vis::rays::residency::ResidencyTracker::take_wanted(const std::uint32_t max_outstanding, const std::uint32_t free_slots) {
+    std::vector<std::uint32_t> wanted;
+    std::vector<std::uint32_t> victims;
+    std::uint32_t outstanding = 0;
+    for (std::uint32_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].state == ChunkState::requested) ++outstanding;
+        if (chunks[i].state == ChunkState::resident) victims.push_back(i);
+        if (chunks[i].visible && chunks[i].state == ChunkState::absent) wanted.push_back(i);
+    }
+    if (outstanding >= max_outstanding) return {};
+
+    std::ranges::sort(wanted, [this](const std::uint32_t a, const std::uint32_t b) { return chunks[a].coverage > chunks[b].coverage; });
+    std::ranges::sort(victims, [this](const std::uint32_t a, const std::uint32_t b) { return evict_first(chunks[a], chunks[b]); });
+
+    // Requests already in flight claim the first slots.
+    std::size_t next_slot = outstanding;
+    std::vector<std::uint32_t> taken;
+    for (const std::uint32_t i : wanted) {
+        if (outstanding + taken.size() >= max_outstanding) break;
+        if (next_slot >= free_slots) {
+            const std::size_t v = next_slot - free_slots;
+            if (v >= victims.size()) break;
+            const Chunk& victim = chunks[victims[v]];
+            if (victim.visible && victim.coverage >= chunks[i].coverage) break;
+        }
+        ++next_slot;
+        chunks[i].state = ChunkState::requested;
+        taken.push_back(i);
+    }
+    return taken;
+}
+
+// ============================================================================
+// Only chunks in view displace others, so streaming the rest of the file
+// in the background never churns the pool.
+// ============================================================================
+std::optional<std::uint32_t> pngp::vis::rays::residency::ResidencyTracker::pick_victim(const std::uint32_t incoming) const {
+    const Chunk& in = chunks[incoming];
+    if (!in.visible) return std::nullopt;
+
+    std::optional<std::uint32_t> victim;
+    for (std::uint32_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].state != ChunkState::resident) continue;
+        if (!victim || evict_first(chunks[i], chunks[*victim])) victim = i;
+    }
+    if (victim && chunks[*victim].visible && chunks[*victim].coverage >= in.coverage) return std::nullopt;
+    return victim;
+}
@@ -0,0 +1,120 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.residency;
+// ============================================================================
+// Residency: the device-local memory budget (VK_EXT_memory_budget when the
+// device has it), and which ray chunks keep a pool slot when the dataset
+// has more chunks than fit. Chunks in view are requested back; slots go to
+// them from the least recently visible chunks first.
+// ============================================================================
+import vk.math;
+import pngp.vis.rays.dataset;
+import std;
+
+namespace pngp::vis::rays::residency {
+    // ========================================================================
+    // One memory heap. Without the extension, budget is the heap size and
+    // usage is unknown (0).
+    // ========================================================================
+    export struct HeapBudget {
+        vk::DeviceSize size   = 0;
+        vk::DeviceSize budget = 0;
+        vk::DeviceSize usage  = 0;
+        bool device_local     = false;
+    };
+
+    export class MemoryBudget {
+    public:
+        // Re-query the driver; other processes move these numbers.
+        void update();
+
+        // VK_EXT_memory_budget numbers rather than heap sizes.
+        [[nodiscard]] bool tracked() const noexcept {
+            return supported;
+        }
+        [[nodiscard]] std::span<const HeapBudget> heaps() const noexcept {
+            return heap_budgets;
+        }
+        // Summed over device-local heaps.
+        [[nodiscard]] vk::DeviceSize device_local_budget() const noexcept;
+        [[nodiscard]] vk::DeviceSize device_local_usage() const noexcept;
+
+        explicit MemoryBudget(const vk::raii::PhysicalDevice& physical_device);
+
+    private:
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        bool supported                                  = false;
+        std::vector<HeapBudget> heap_budgets;
+    };
+
+    // ========================================================================
+    // Screen footprint of a chunk's bounds, the CPU twin of project_bounds
+    // in ray_cull.slang: outside when all corners lie beyond one clip plane,
+    // otherwise the share of the viewport the clamped rectangle covers (1
+    // when a corner is behind the eye).
+    // ========================================================================
+    export struct ChunkScreen {
+        bool visible   = false;
+        float coverage = 0.0f;
+    };
+    export [[nodiscard]] ChunkScreen project_bounds(const vk::math::mat4& view_proj, const std::array<float, 3>& bounds_min, const std::array<float, 3>& bounds_max);
+
+    // ========================================================================
+    // Main-thread LRU bookkeeping over every chunk of the file. The scene
+    // moves each chunk through requested -> uploading -> resident and back
+    // to absent on eviction (or when a decoded chunk is dropped).
+    // ========================================================================
+    export enum class ChunkState : std::uint8_t { absent, requested, uploading, resident };
+
+    export class ResidencyTracker {
+    public:
+        // ====================================================================
+        // Once per frame: advance the clock, re-project every chunk, and
+        // stamp the ones in view.
+        // ====================================================================
+        void update(const vk::math::mat4& view_proj, std::span<const dataset::ChunkRecord> chunks);
+        // ====================================================================
+        // Absent chunks in view, largest footprint first, that would get a
+        // slot (one of free_slots, or pick_victim's) on arrival; at most
+        // max_outstanding stay requested. They move to requested.
+        // ====================================================================
+        [[nodiscard]] std::vector<std::uint32_t> take_wanted(std::uint32_t max_outstanding, std::uint32_t free_slots);
+        // ====================================================================
+        // Resident chunk to give its slot to incoming: the least recently
+        // visible one, or while everything resident is in view the one with
+        // the smallest footprint (fewest rays drawn at LOD) if incoming's is
+        // larger. nullopt: incoming is not worth a slot.
+        // ====================================================================
+        [[nodiscard]] std::optional<std::uint32_t> pick_victim(std::uint32_t incoming) const;
+
+        void set_state(const std::uint32_t chunk_index, const ChunkState state) {
+            chunks[chunk_index].state = state;
+        }
+        [[nodiscard]] ChunkState state(const std::uint32_t chunk_index) const {
+            return chunks[chunk_index].state;
+        }
+        [[nodiscard]] std::uint64_t evictions() const noexcept {
+            return evicted;
+        }
+        void count_eviction() noexcept {
+            ++evicted;
+        }
+
+        explicit ResidencyTracker(std::uint32_t chunk_count);
+
+    private:
+        struct Chunk {
+            std::uint64_t last_visible = 0;
+            float coverage             = 0.0f;
+            bool visible               = false;
+            ChunkState state           = ChunkState::absent;
+        };
+
+        static bool evict_first(const Chunk& a, const Chunk& b) noexcept;
+
+        std::vector<Chunk> chunks;
+        // Starts at 1 so a chunk never seen (last_visible 0) is oldest.
+        std::uint64_t frame   = 1;
+        std::uint64_t evicted = 0;
+    };
+} // namespace pngp::vis::rays::residency
@@ -0,0 +1,694 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.scene;
+// ============================================================================
+// Scene renderer implementation.
+// ============================================================================
+import std;
+import vk.memory;
+import vk.geometry;
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+import pngp.vis.rays.pool;
+import pngp.vis.rays.picking;
+import pngp.vis.rays.filter;
+import pngp.vis.rays.profiler;
+import pngp.vis.rays.layers;
+import pngp.vis.rays.density;
+import pngp.vis.rays.oit;
+import pngp.vis.rays.residency;
+
+// ============================================================================
+// Translation-unit helpers (grid geometry, push constants, pipeline descs).
+// ============================================================================
+namespace {
+    using pngp::vis::rays::GridSettings;
+    using pngp::vis::rays::pipelines::GraphicsPipelineDesc;
+
+    // =========================================================================
+    // Push constants consumed by ground_grid.slang.
+    // =========================================================================
+    struct GridPush {
+        vk::math::mat4 mvp{};
+        vk::math::vec4 grid{};
+        vk::math::vec4 toggles{};
+    };
+
+    // =========================================================================
+    // Push constants consumed by ray_segments.slang.
+    // =========================================================================
+    struct RayPush {
+        vk::math::mat4 mvp{};
+        vk::math::vec4 tint{};
+        // Records per pool slot; maps a vertex index to its slot's bounds.
+        std::uint32_t slot_rays = 0;
+        std::array<std::uint32_t, 3> pad{};
+    };
+    static_assert(sizeof(RayPush) == 96);
+
+    // =========================================================================
+    // Single quad for the grid surface; shader draws the lines procedurally.
+    // =========================================================================
+    vk::memory::MeshCPU<vk::geometry::VertexP3C4> build_ground_plane(const float extent) {
+        vk::memory::MeshCPU<vk::geometry::VertexP3C4> mesh{};
+        const float clamped_extent = std::max(0.1f, extent);
+        constexpr vk::math::vec4 color{1.0f, 1.0f, 1.0f, 1.0f};
+
+        mesh.vertices = {
+            {{-clamped_extent, 0.0f, -clamped_extent, 0.0f}, color},
+            {{clamped_extent, 0.0f, -clamped_extent, 0.0f}, color},
+            {{clamped_extent, 0.0f, clamped_extent, 0.0f}, color},
+            {{-clamped_extent, 0.0f, clamped_extent, 0.0f}, color},
+        };
+
+        mesh.indices = {0, 1, 2, 0, 2, 3};
+        return mesh;
+    }
+
+    // =========================================================================
+    // Grid variant index: bits 0-2 are the layer toggles (specialization
+    // constant i of ground_grid.slang), bit 3 the infinite permutation.
+    // =========================================================================
+    constexpr std::uint32_t grid_infinite_bit = 8u;
+
+    std::uint32_t grid_variant(const GridSettings& grid) {
+        return (grid.show_grid ? 1u : 0u) | (grid.show_axes ? 2u : 0u) | (grid.show_origin ? 4u : 0u) | (grid.infinite ? grid_infinite_bit : 0u);
+    }
+
+    // =========================================================================
+    // Convert UI settings to shader-friendly constants; the toggles select
+    // the pipeline variant instead (see grid_variant). The infinite grid is
+    // centered on the camera.
+    // =========================================================================
+    GridPush make_grid_push(const GridSettings& grid, const vk::math::mat4& mvp, const std::array<float, 3>& eye) {
+        const float step   = std::max(0.001f, grid.grid_step);
+        const float extent = std::max(0.1f, grid.grid_extent);
+        const float major  = static_cast<float>(std::max(1, grid.major_every));
+
+        GridPush push{};
+        push.mvp     = mvp;
+        push.grid    = {step, step * major, extent, std::max(0.001f, grid.axis_length)};
+        push.toggles = {std::max(0.001f, grid.origin_scale), eye[0], eye[2], std::max(step, grid.fade_distance)};
+        return push;
+    }
+
+    // =========================================================================
+    // Minimal pipeline for a transparent grid surface with depth testing.
+    // Neither variant writes depth: the grid is blended over the scene, and
+    // its depth would cut translucent (OIT) rays behind every grid line.
+    // =========================================================================
+    GraphicsPipelineDesc grid_pipeline_desc(const vk::Format color_format, const vk::Format depth_format, const std::uint32_t variant) {
+        GraphicsPipelineDesc desc{};
+        const bool infinite       = (variant & grid_infinite_bit) != 0;
+        desc.shader               = infinite ? "ground_grid.infinite" : "ground_grid";
+        desc.specialization       = {{0, variant & 1u}, {1, (variant >> 1) & 1u}, {2, (variant >> 2) & 1u}};
+        desc.vertex_input         = infinite ? pngp::vis::rays::pipelines::VertexInput{} : pngp::vis::rays::pipelines::make_vertex_input<vk::geometry::VertexP3C4>();
+        desc.color_format         = color_format;
+        desc.depth_format         = depth_format;
+        desc.use_depth            = true;
+        desc.depth_write          = false;
+        desc.cull                 = vk::CullModeFlagBits::eNone;
+        desc.front_face           = vk::FrontFace::eCounterClockwise;
+        desc.polygon_mode         = vk::PolygonMode::eFill;
+        desc.topology             = vk::PrimitiveTopology::eTriangleList;
+        desc.enable_blend         = true;
+        desc.push_constant_bytes  = sizeof(GridPush);
+        desc.push_constant_stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+        return desc;
+    }
+
+    // =========================================================================
+    // Frustum cull over resident chunks; writes the indirect draws.
+    // =========================================================================
+    pngp::vis::rays::pipelines::ComputePipelineDesc cull_pipeline_desc() {
+        pngp::vis::rays::pipelines::ComputePipelineDesc desc{};
+        desc.shader              = "ray_cull";
+        desc.descriptor_bindings = pngp::vis::rays::pool::cull_bindings();
+        desc.push_constant_bytes = sizeof(pngp::vis::rays::pool::CullPush);
+        return desc;
+    }
+
+    // =========================================================================
+    // Depth-tested line list for ray segments; drawn before the grid. No
+    // vertex input: the shader pulls quantized records from the pool.
+    // =========================================================================
+    GraphicsPipelineDesc ray_pipeline_desc(const vk::Format color_format, const vk::Format depth_format) {
+        GraphicsPipelineDesc desc{};
+        desc.shader               = "ray_segments";
+        desc.descriptor_bindings  = pngp::vis::rays::pool::draw_bindings();
+        desc.color_format         = color_format;
+        desc.depth_format         = depth_format;
+        desc.use_depth            = true;
+        desc.cull                 = vk::CullModeFlagBits::eNone;
+        desc.front_face           = vk::FrontFace::eCounterClockwise;
+        desc.polygon_mode         = vk::PolygonMode::eFill;
+        desc.topology             = vk::PrimitiveTopology::eLineList;
+        desc.enable_blend         = true;
+        desc.push_constant_bytes  = sizeof(RayPush);
+        desc.push_constant_stages = vk::ShaderStageFlagBits::eVertex;
+        return desc;
+    }
+
+    // =========================================================================
+    // Translucent ray segments into the WBOIT targets: depth-tested against
+    // the scene pass, no depth writes, no ordering.
+    // =========================================================================
+    GraphicsPipelineDesc oit_pipeline_desc(const vk::Format depth_format) {
+        GraphicsPipelineDesc desc = ray_pipeline_desc(pngp::vis::rays::oit::accum_format, depth_format);
+        desc.shader               = "ray_segments.oit";
+        desc.depth_write          = false;
+        desc.enable_blend         = false;
+        desc.oit_revealage_format = pngp::vis::rays::oit::revealage_format;
+        return desc;
+    }
+
+    // =========================================================================
+    // WBOIT resolve: fullscreen triangle alpha-blended over the color
+    // target, in a pass of its own without depth.
+    // =========================================================================
+    GraphicsPipelineDesc oit_composite_pipeline_desc(const vk::Format color_format) {
+        GraphicsPipelineDesc desc{};
+        desc.shader              = "ray_oit";
+        desc.descriptor_bindings = pngp::vis::rays::oit::bindings();
+        desc.color_format        = color_format;
+        desc.use_depth           = false;
+        desc.cull                = vk::CullModeFlagBits::eNone;
+        desc.topology            = vk::PrimitiveTopology::eTriangleList;
+        desc.enable_blend        = true;
+        return desc;
+    }
+
+    // =========================================================================
+    // Density splat: one thread per selected ray of this frame's share.
+    // =========================================================================
+    pngp::vis::rays::pipelines::ComputePipelineDesc splat_pipeline_desc() {
+        pngp::vis::rays::pipelines::ComputePipelineDesc desc{};
+        desc.shader              = "ray_splat";
+        desc.descriptor_bindings = pngp::vis::rays::density::bindings();
+        desc.push_constant_bytes = sizeof(pngp::vis::rays::density::SplatPush);
+        return desc;
+    }
+
+    // =========================================================================
+    // Fullscreen density composite at the far plane, drawn where the ray
+    // segments would be; depth-tested so the attachment formats match the
+    // pass, but it writes no depth. Mean ray color is the "radiance"
+    // permutation of ray_density.slang.
+    // =========================================================================
+    GraphicsPipelineDesc density_pipeline_desc(const vk::Format color_format, const vk::Format depth_format, const bool radiance) {
+        GraphicsPipelineDesc desc{};
+        desc.shader               = radiance ? "ray_density.radiance" : "ray_density";
+        desc.descriptor_bindings  = pngp::vis::rays::density::bindings();
+        desc.color_format         = color_format;
+        desc.depth_format         = depth_format;
+        desc.use_depth            = true;
+        desc.depth_write          = false;
+        desc.cull                 = vk::CullModeFlagBits::eNone;
+        desc.topology             = vk::PrimitiveTopology::eTriangleList;
+        desc.enable_blend         = true;
+        desc.push_constant_bytes  = sizeof(pngp::vis::rays::density::CompositePush);
+        desc.push_constant_stages = vk::ShaderStageFlagBits::eFragment;
+        return desc;
+    }
+} // namespace
+
+// ============================================================================
+// Constructor: upload path, pipeline library, and optional dataset.
+// ============================================================================
+pngp::vis::rays::Scene::Scene(const GpuDevice& gpu, const SceneInfo& info) : gpu(gpu), retire(info.frames_in_flight) {
+    uploader         = std::make_unique<upload::Uploader>(*gpu.physical_device, *gpu.device, *gpu.queue, gpu.queue_family);
+    pipeline_library = std::make_unique<pipelines::PipelineLibrary>(*gpu.physical_device, *gpu.device, info.pipeline_cache);
+    workers          = std::make_shared<jobs::ThreadPool>();
+    layer_recorder   = std::make_unique<layers::LayerRecorder>(*gpu.device, gpu.queue_family, workers, info.frames_in_flight);
+    memory_budget    = std::make_unique<residency::MemoryBudget>(*gpu.physical_device);
+
+    // ========================================================================
+    // Map the ray dump and start decoding; chunks arrive over later frames.
+    // ========================================================================
+    if (!info.dataset.empty()) {
+        rays_file    = std::make_shared<const dataset::RayFile>(info.dataset);
+        ray_streamer = std::make_unique<dataset::ChunkStreamer>(rays_file, workers, dataset::StreamerConfig{});
+        if (info.picking) ray_picker = std::make_unique<picking::RayPicker>(rays_file, workers);
+
+        // ====================================================================
+        // Pool slots are sized for the file's largest chunk: one per chunk
+        // when the budget allows, else as many as the share of the free
+        // device-local budget buys, and chunks take turns by visibility.
+        // ====================================================================
+        const auto& h = rays_file->header();
+        if (h.chunk_count > 0) {
+            const vk::DeviceSize budget = memory_budget->device_local_budget();
+            const vk::DeviceSize in_use = std::min(memory_budget->device_local_usage(), budget);
+            const auto affordable       = static_cast<vk::DeviceSize>(static_cast<double>(budget - in_use) * std::clamp(info.ray_memory_share, 0.0f, 1.0f)) / pool::slot_bytes(h.chunk_capacity, info.frames_in_flight);
+            const std::uint32_t slots   = static_cast<std::uint32_t>(std::max<vk::DeviceSize>(1, std::min<vk::DeviceSize>({h.chunk_count, pool::max_slots(*gpu.physical_device, h.chunk_capacity), affordable})));
+            if (slots < h.chunk_count) ray_residency = std::make_unique<residency::ResidencyTracker>(h.chunk_count);
+            ray_indexed.assign(h.chunk_count, false);
+
+            ray_filter     = std::make_unique<filter::RayFilter>(rays_file, workers);
+            cull_pipeline  = &pipeline_library->get(cull_pipeline_desc());
+            splat_pipeline = &pipeline_library->get(splat_pipeline_desc());
+            ray_pool       = std::make_unique<pool::RayPool>(*gpu.physical_device, *gpu.device, *uploader, *cull_pipeline->set_layout,
+                                                             pool::PoolInfo{.slot_count = slots, .slot_rays = h.chunk_capacity, .frames_in_flight = info.frames_in_flight, .features = gpu.indirect});
+            ray_density    = std::make_unique<density::DensityAccumulator>(*gpu.physical_device, *gpu.device, gpu.queue_family, info.frames_in_flight);
+            ray_oit        = std::make_unique<oit::OitTargets>(*gpu.physical_device, *gpu.device, info.frames_in_flight);
+        }
+    }
+}
+
+std::optional<pngp::vis::rays::picking::PickHit> pngp::vis::rays::Scene::pick(const picking::PickRay& ray) const {
+    if (!ray_picker) return std::nullopt;
+    // Evicted chunks keep their BVH but are not drawn.
+    if (!filters.enabled && !ray_residency) return ray_picker->pick(ray);
+    return ray_picker->pick(ray, [this](const dataset::ChunkView& view, const std::uint32_t i) { return ray_pool->holds(view.index) && (!filters.enabled || filter::matches(filters, view, i)); });
+}
+
+std::optional<float> pngp::vis::rays::Scene::dataset_radius() const {
+    if (!rays_file || rays_file->header().ray_count == 0) return std::nullopt;
+    const auto& h      = rays_file->header();
+    const float radius = std::max({h.bounds_max[0] - h.bounds_min[0], h.bounds_max[1] - h.bounds_min[1], h.bounds_max[2] - h.bounds_min[2]}) * 0.5f;
+    if (!std::isfinite(radius)) return std::nullopt;
+    return radius;
+}
+
+void pngp::vis::rays::Scene::begin_frame(const std::uint32_t frame_index) {
+    retire.collect(frame_index);
+    uploader->poll();
+    memory_budget->update();
+    if (ray_density) ray_density->begin_frame(frame_index);
+    if (ray_oit) ray_oit->begin_frame(frame_index);
+}
+
+void pngp::vis::rays::Scene::update(const std::uint32_t frame_index) {
+    update_grid_mesh(frame_index);
+    stream_ray_chunks();
+    upload_selections();
+    uploader->submit();
+    if (ray_picker) ray_picker->update();
+}
+
+void pngp::vis::rays::Scene::shutdown() {
+    retire.clear();
+    pipeline_library->save();
+}
+
+// ============================================================================
+// Pipelines only depend on attachment formats (extent is dynamic state), so
+// a resize that keeps the formats reuses the existing objects untouched.
+// Format changes look up new variants; old ones stay cached, never freed
+// under an in-flight frame. Grid and density variants are only looked up
+// when first drawn, so unused toggle combinations are never compiled.
+// ============================================================================
+void pngp::vis::rays::Scene::set_formats(const vk::Format color_format, const vk::Format depth_format) {
+    if (ray_pipeline && pipeline_formats == std::pair{color_format, depth_format}) return;
+    ray_pipeline           = &pipeline_library->get(ray_pipeline_desc(color_format, depth_format));
+    oit_pipeline           = &pipeline_library->get(oit_pipeline_desc(depth_format));
+    oit_composite_pipeline = &pipeline_library->get(oit_composite_pipeline_desc(color_format));
+    pipeline_formats       = {color_format, depth_format};
+    grid_pipelines.fill(nullptr);
+    density_pipelines.fill(nullptr);
+}
+
+const pngp::vis::rays::pipelines::Pipeline& pngp::vis::rays::Scene::grid_pipeline(const GridSettings& settings) {
+    const std::uint32_t variant = grid_variant(settings);
+    if (!grid_pipelines[variant]) grid_pipelines[variant] = &pipeline_library->get(grid_pipeline_desc(pipeline_formats.first, pipeline_formats.second, variant));
+    return *grid_pipelines[variant];
+}
+
+const pngp::vis::rays::pipelines::Pipeline& pngp::vis::rays::Scene::density_pipeline(const bool radiance) {
+    const std::size_t variant = radiance ? 1 : 0;
+    if (!density_pipelines[variant]) density_pipelines[variant] = &pipeline_library->get(density_pipeline_desc(pipeline_formats.first, pipeline_formats.second, radiance));
+    return *density_pipelines[variant];
+}
+
+// ============================================================================
+// Grid rebuild: keep drawing the old mesh until the new copy has landed.
+// The infinite grid has no mesh; a pending rebuild waits for finite mode.
+// ============================================================================
+void pngp::vis::rays::Scene::update_grid_mesh(const std::uint32_t frame_index) {
+    if (grid_dirty && !grid.infinite) {
+        if (auto up = uploader->upload_mesh(build_ground_plane(grid.grid_extent))) {
+            // A newer extent supersedes an upload that has not landed yet.
+            if (grid_pending) retire.retire(frame_index, std::move(grid_pending->mesh));
+            grid_pending = std::move(*up);
+            grid_dirty   = false;
+        }
+    }
+
+    if (grid_pending && uploader->complete(grid_pending->ticket)) {
+        retire.retire(frame_index, std::move(grid_mesh));
+        grid_mesh = std::move(grid_pending->mesh);
+        grid_pending.reset();
+    }
+}
+
+// ============================================================================
+// Streaming: each decoded chunk is copied into a free pool slot. A full
+// staging ring defers the chunk to the next frame instead of blocking.
+// Landed chunks are queued for the picker's BVH build (once) and the
+// filter, and restart the density image.
+// ============================================================================
+void pngp::vis::rays::Scene::stream_ray_chunks() {
+    while (!ray_pending.empty() && uploader->complete(ray_pending.front().ticket)) {
+        PendingChunk& landed = ray_pending.front();
+        ray_count_resident += landed.ray_count;
+        ray_pool->mark_resident(landed.index);
+        if (ray_residency) ray_residency->set_state(landed.index, residency::ChunkState::resident);
+        if (ray_picker && !ray_indexed[landed.index]) ray_picker->add_chunk(landed.index);
+        ray_indexed[landed.index] = true;
+        if (ray_filter) ray_filter->add_chunk(landed.index, std::move(landed.order));
+        if (ray_density) ray_density->invalidate();
+        ray_pending.pop_front();
+    }
+
+    if (!ray_streamer) return;
+    // ========================================================================
+    // Over budget: chunks that came into view are decoded again, biggest on
+    // screen first, a few at a time so the camera can outrun the queue.
+    // ========================================================================
+    if (ray_residency) {
+        ray_residency->update(residency_view_proj, rays_file->chunks());
+        for (const std::uint32_t chunk : ray_residency->take_wanted(static_cast<std::uint32_t>(std::max(1, rays.chunks_per_frame)) * 2, ray_pool->slots_free())) ray_streamer->request(chunk);
+    }
+
+    for (int i = 0; i < rays.chunks_per_frame; ++i) {
+        if (!ray_deferred) ray_deferred = ray_streamer->try_pop();
+        if (!ray_deferred) break;
+        if (ray_deferred->records.empty()) {
+            ray_deferred.reset();
+            continue;
+        }
+
+        const std::uint32_t index = ray_deferred->index;
+        if (ray_residency && !make_room(index)) {
+            // Ring full while evicting: retry the same chunk next frame.
+            if (ray_deferred) break;
+            continue;
+        }
+
+        const auto ticket = ray_pool->upload_chunk(*uploader, *ray_deferred, rays_file->chunks()[index]);
+        if (!ticket) break;
+        if (ray_residency) ray_residency->set_state(index, residency::ChunkState::uploading);
+        ray_pending.push_back({*ticket, index, ray_deferred->ray_count, std::move(ray_deferred->order)});
+        ray_deferred.reset();
+    }
+    // Over budget the streamer stays up to serve re-requests.
+    if (!ray_residency && !ray_deferred && ray_streamer->finished()) ray_streamer.reset();
+}
+
+// ============================================================================
+// Eviction: a decoded chunk already on the GPU (or on its way) is dropped;
+// otherwise a full pool gives up the tracker's victim, whose unsent
+// selection and filter state go with it. Returns false when the chunk
+// should not be uploaded now: dropped (ray_deferred reset), or the ring
+// could not take the eviction (ray_deferred kept).
+// ============================================================================
+bool pngp::vis::rays::Scene::make_room(const std::uint32_t chunk_index) {
+    const residency::ChunkState state = ray_residency->state(chunk_index);
+    if (state == residency::ChunkState::uploading || state == residency::ChunkState::resident) {
+        ray_deferred.reset();
+        return false;
+    }
+    if (!ray_pool->full()) return true;
+
+    const auto victim = ray_residency->pick_victim(chunk_index);
+    if (!victim) {
+        ray_residency->set_state(chunk_index, residency::ChunkState::absent);
+        ray_deferred.reset();
+        return false;
+    }
+    if (!ray_pool->evict(*uploader, *victim)) return false;
+
+    ray_residency->set_state(*victim, residency::ChunkState::absent);
+    ray_residency->count_eviction();
+    ray_count_resident -= rays_file->chunks()[*victim].ray_count;
+    if (ray_filter) ray_filter->remove_chunk(*victim);
+    selection_pending.erase(*victim);
+    if (ray_density) ray_density->invalidate();
+    return true;
+}
+
+// ============================================================================
+// Filtering: hand the current settings to the scanner and upload changed
+// selections, as many as the staging ring takes this frame (the rest keep
+// the newest list per chunk and go out next frame).
+// ============================================================================
+void pngp::vis::rays::Scene::upload_selections() {
+    if (!ray_filter) return;
+    ray_filter->set_settings(filters);
+    for (auto& selection : ray_filter->take_changes()) selection_pending[selection.chunk] = std::move(selection.records);
+
+    while (!selection_pending.empty()) {
+        const auto it = selection_pending.begin();
+        // Evicted after the scan published it.
+        if (!ray_pool->holds(it->first)) {
+            selection_pending.erase(it);
+            continue;
+        }
+        if (!ray_pool->upload_selection(*uploader, it->first, it->second)) break;
+        selection_pending.erase(it);
+        ray_density->invalidate();
+    }
+}
+
+// ============================================================================
+// Record the scene pass: ray culling (or the density splat), layout
+// transitions, then the clear and the draw layers (rays or density, grid)
+// recorded in parallel, and for translucent rays the OIT accumulation and
+// composite passes.
+// ============================================================================
+void pngp::vis::rays::Scene::record(const vk::raii::CommandBuffer& cmd, const std::uint32_t frame_index, const RenderTargets& targets, const vk::math::mat4& view_proj, const std::array<float, 3>& eye, profiler::Profiler* frame_profiler) {
+    profiler::GpuScope pass_scope{frame_profiler, cmd, "scene"};
+
+    // ========================================================================
+    // Compute culling (and LOD selection) and the density splat have to run
+    // outside the rendering scope.
+    // ========================================================================
+    residency_view_proj   = view_proj;
+    const bool show_rays  = rays.show_rays && ray_pool && ray_pool->slot_range() > 0;
+    const bool draw_rays  = show_rays && !rays.density;
+    const bool splat_rays = show_rays && rays.density;
+    // Opaque segments are resolved exactly by the depth test alone.
+    const bool oit_rays = draw_rays && rays.oit && rays.opacity < 1.0f;
+    if (draw_rays) {
+        profiler::GpuScope scope{frame_profiler, cmd, "ray cull"};
+        ray_pool->cull(cmd, *cull_pipeline, frame_index, view_proj, targets.extent, rays.lod ? rays.rays_per_pixel : 0.0f);
+    }
+    if (splat_rays) {
+        profiler::GpuScope scope{frame_profiler, cmd, "ray splat"};
+        ray_density->splat(cmd, *splat_pipeline, frame_index, *ray_pool, view_proj, targets.extent, rays.density_budget_ms);
+    }
+
+    {
+        profiler::GpuScope scope{frame_profiler, cmd, "layout barriers"};
+
+        // ====================================================================
+        // Transition color image for rendering. The source stage matches the
+        // swapchain acquire wait, so the transition runs after it.
+        // ====================================================================
+        {
+            const vk::ImageMemoryBarrier2 barrier{
+                .srcStageMask     = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                .srcAccessMask    = vk::AccessFlagBits2::eColorAttachmentWrite,
+                .dstStageMask     = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                .dstAccessMask    = vk::AccessFlagBits2::eColorAttachmentWrite,
+                .oldLayout        = *targets.color_layout,
+                .newLayout        = vk::ImageLayout::eColorAttachmentOptimal,
+                .image            = targets.color,
+                .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1},
+            };
+
+            const vk::DependencyInfo dep{
+                .imageMemoryBarrierCount = 1,
+                .pImageMemoryBarriers    = &barrier,
+            };
+
+            cmd.pipelineBarrier2(dep);
+            *targets.color_layout = vk::ImageLayout::eColorAttachmentOptimal;
+        }
+
+        // ====================================================================
+        // Transition depth image for depth testing. One depth image serves
+        // every frame in flight, so the previous frame's tests finish first.
+        // ====================================================================
+        {
+            const vk::ImageMemoryBarrier2 barrier{
+                .srcStageMask     = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                .srcAccessMask    = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                .dstStageMask     = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                .dstAccessMask    = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                .oldLayout        = *targets.depth_layout,
+                .newLayout        = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                .image            = targets.depth,
+                .subresourceRange = {vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1},
+            };
+
+            const vk::DependencyInfo dep{
+                .imageMemoryBarrierCount = 1,
+                .pImageMemoryBarriers    = &barrier,
+            };
+
+            cmd.pipelineBarrier2(dep);
+            *targets.depth_layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        }
+    }
+
+    // ========================================================================
+    // Clear targets: black background + default depth.
+    // ========================================================================
+    vk::ClearValue clear_color{};
+    clear_color.color = vk::ClearColorValue{std::array{0.f, 0.f, 0.f, 1.0f}};
+
+    vk::ClearValue clear_depth{};
+    clear_depth.depthStencil = vk::ClearDepthStencilValue{1.0f, 0};
+
+    const vk::RenderingAttachmentInfo color{
+        .imageView   = targets.color_view,
+        .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .loadOp      = vk::AttachmentLoadOp::eClear,
+        .storeOp     = vk::AttachmentStoreOp::eStore,
+        .clearValue  = clear_color,
+    };
+
+    const vk::RenderingAttachmentInfo depth{
+        .imageView   = targets.depth_view,
+        .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        .loadOp      = vk::AttachmentLoadOp::eClear,
+        .storeOp     = vk::AttachmentStoreOp::eStore,
+        .clearValue  = clear_depth,
+    };
+
+    const vk::RenderingInfo rendering{
+        .renderArea           = {{0, 0}, targets.extent},
+        .layerCount           = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments    = &color,
+        .pDepthAttachment     = &depth,
+    };
+
+    const vk::Viewport vp{
+        .x        = 0.f,
+        .y        = static_cast<float>(targets.extent.height),
+        .width    = static_cast<float>(targets.extent.width),
+        .height   = -static_cast<float>(targets.extent.height),
+        .minDepth = 0.f,
+        .maxDepth = 1.f,
+    };
+
+    const vk::Rect2D scissor{{0, 0}, targets.extent};
+
+    // ========================================================================
+    // Draw layers in order; each is recorded into its own secondary command
+    // buffer on the worker pool. Push constants are built here so the
+    // workers only read immutable per-frame values.
+    // ========================================================================
+    std::vector<layers::Layer> frame_layers;
+
+    // ========================================================================
+    // Ray segments: indirect line-list draws for the chunks that survived
+    // culling. Translucent ones go through the OIT passes below instead.
+    // ========================================================================
+    if (draw_rays && !oit_rays) {
+        const RayPush push{view_proj, {1.0f, 1.0f, 1.0f, rays.opacity}, ray_pool->slot_rays()};
+        frame_layers.push_back({"rays", [this, push, frame_index](const vk::raii::CommandBuffer& layer_cmd) {
+                                    layer_cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *ray_pipeline->pipeline);
+                                    layer_cmd.pushConstants(*ray_pipeline->layout, vk::ShaderStageFlagBits::eVertex, 0, vk::ArrayProxy<const RayPush>{push});
+                                    ray_pool->draw(layer_cmd, *ray_pipeline, frame_index);
+                                }});
+    }
+
+    // ========================================================================
+    // Density composite: one fullscreen triangle over what has been
+    // splatted so far.
+    // ========================================================================
+    if (splat_rays) {
+        const pipelines::Pipeline* composite = &density_pipeline(rays.density_radiance);
+        frame_layers.push_back({"density", [this, composite, settings = rays](const vk::raii::CommandBuffer& layer_cmd) {
+                                    layer_cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *composite->pipeline);
+                                    ray_density->composite(layer_cmd, *composite, settings.density_exposure, settings.opacity);
+                                }});
+    }
+
+    // ========================================================================
+    // Grid draw: one quad + procedural shader, or for the infinite grid six
+    // vertices generated around the camera.
+    // ========================================================================
+    const bool grid_visible = grid.show_grid || grid.show_axes || grid.show_origin;
+    if ((grid.infinite || grid_mesh.index_count > 0) && grid_visible) {
+        const GridPush push                 = make_grid_push(grid, view_proj, eye);
+        const pipelines::Pipeline* pipeline = &grid_pipeline(grid);
+        frame_layers.push_back({"grid", [this, push, pipeline, infinite = grid.infinite](const vk::raii::CommandBuffer& layer_cmd) {
+                                    layer_cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline->pipeline);
+                                    layer_cmd.pushConstants(*pipeline->layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, vk::ArrayProxy<const GridPush>{push});
+                                    if (infinite) {
+                                        layer_cmd.draw(6, 1, 0, 0);
+                                        return;
+                                    }
+
+                                    vk::DeviceSize offset = 0;
+                                    layer_cmd.bindVertexBuffers(0, {*grid_mesh.vertex_buffer.buffer}, {offset});
+                                    layer_cmd.bindIndexBuffer(*grid_mesh.index_buffer.buffer, 0, vk::IndexType::eUint32);
+                                    layer_cmd.drawIndexed(grid_mesh.index_count, 1, 0, 0, 0);
+                                }});
+    }
+
+    const layers::LayerPass pass{
+        .rendering    = rendering,
+        .color_format = pipeline_formats.first,
+        .depth_format = pipeline_formats.second,
+        .viewport     = vp,
+        .scissor      = scissor,
+    };
+    layer_recorder->execute(cmd, frame_index, pass, frame_layers, frame_profiler);
+    if (!oit_rays) return;
+
+    // ========================================================================
+    // Translucent rays: accumulate against the depth the layers left, then
+    // resolve over the color target. Both passes are single draws, recorded
+    // on the primary; viewport and scissor carry over between them.
+    // ========================================================================
+    cmd.setViewport(0, {vp});
+    cmd.setScissor(0, {scissor});
+    {
+        profiler::GpuScope scope{frame_profiler, cmd, "rays (oit)"};
+        const RayPush push{view_proj, {1.0f, 1.0f, 1.0f, rays.opacity}, ray_pool->slot_rays()};
+        ray_oit->begin_accumulate(cmd, frame_index, targets.extent, targets.depth_view);
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *oit_pipeline->pipeline);
+        cmd.pushConstants(*oit_pipeline->layout, vk::ShaderStageFlagBits::eVertex, 0, vk::ArrayProxy<const RayPush>{push});
+        ray_pool->draw(cmd, *oit_pipeline, frame_index);
+        ray_oit->end_accumulate(cmd);
+    }
+    {
+        profiler::GpuScope scope{frame_profiler, cmd, "oit composite"};
+
+        // Blending reads what the layers wrote in the earlier scope.
+        const vk::MemoryBarrier2 color_barrier{
+            .srcStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .dstAccessMask = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+        };
+        cmd.pipelineBarrier2(vk::DependencyInfo{
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers    = &color_barrier,
+        });
+
+        const vk::RenderingAttachmentInfo resolve_color{
+            .imageView   = targets.color_view,
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp      = vk::AttachmentLoadOp::eLoad,
+            .storeOp     = vk::AttachmentStoreOp::eStore,
+        };
+        cmd.beginRendering(vk::RenderingInfo{
+            .renderArea           = {{0, 0}, targets.extent},
+            .layerCount           = 1,
+            .colorAttachmentCount = 1,
+            .pColorAttachments    = &resolve_color,
+        });
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, *oit_composite_pipeline->pipeline);
+        ray_oit->composite(cmd, *oit_composite_pipeline);
+        cmd.endRendering();
+    }
+}
@@ -0,0 +1,314 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.scene;
+// ============================================================================
+// Scene renderer shared by the windowed viewer and the headless benchmark:
+// grid + ray resources, async uploads, and the scene pass recording.
+// ============================================================================
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+import pngp.vis.rays.upload;
+import pngp.vis.rays.pipelines;
+import pngp.vis.rays.pool;
+import pngp.vis.rays.picking;
+import pngp.vis.rays.filter;
+import pngp.vis.rays.profiler;
+import pngp.vis.rays.layers;
+import pngp.vis.rays.density;
+import pngp.vis.rays.oit;
+import pngp.vis.rays.residency;
+import std;
+
+namespace pngp::vis::rays {
+    // ========================================================================
+    // Ground grid UI + render settings.
+    // These values are mirrored into shader push constants each frame, so only
+    // geometry-dependent knobs should trigger mesh rebuilds.
+    // ========================================================================
+    export struct GridSettings {
+        bool show_grid   = true;
+        bool show_axes   = true;
+        bool show_origin = true;
+        bool fly_mode    = false;
+
+        float grid_extent = 30.0f;
+        float grid_step   = 1.0f;
+        int major_every   = 5;
+
+        float axis_length  = 4.0f;
+        float origin_scale = 0.25f;
+
+        // Infinite grid: drawn around the camera out to fade_distance with no
+        // mesh, so grid_extent is ignored and never triggers a rebuild.
+        bool infinite       = false;
+        float fade_distance = 150.0f;
+
+        bool operator==(const GridSettings&) const = default;
+    };
+
+    // ========================================================================
+    // Ray dataset display + streaming knobs.
+    // ========================================================================
+    export struct RaySettings {
+        bool show_rays = true;
+        // Decoded chunks uploaded per frame; bounds the upload cost per frame.
+        int chunks_per_frame = 2;
+        float opacity        = 1.0f;
+        // Translucent segments (opacity < 1) through weighted blended OIT:
+        // one unsorted pass that resolves overlap independent of draw order.
+        // Off blends them in submission order.
+        bool oit = true;
+        // Screen-density level of detail: each visible chunk draws about
+        // this many rays per pixel it covers, full detail once zoomed in.
+        bool lod             = true;
+        float rays_per_pixel = 0.5f;
+        // Progressive density heatmap instead of segments: a share of the
+        // rays is splatted each frame within the GPU budget, and the image
+        // restarts when the view or the selection changes.
+        bool density            = false;
+        float density_budget_ms = 2.0f;
+        float density_exposure  = 0.02f;
+        // Mean ray color scaled by density instead of the heat colormap.
+        bool density_radiance = false;
+
+        bool operator==(const RaySettings&) const = default;
+    };
+
+    // ========================================================================
+    // Device handles the scene renders with (not owned).
+    // ========================================================================
+    export struct GpuDevice {
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        const vk::raii::Device* device                  = nullptr;
+        const vk::raii::Queue* queue                    = nullptr;
+        std::uint32_t queue_family                      = 0;
+        // Optional indirect-draw features the device was created with.
+        pool::IndirectFeatures indirect{};
+    };
+
+    // ========================================================================
+    // Color + depth images the scene pass draws into. Layout pointers are
+    // the caller's layout trackers; record() updates them.
+    // ========================================================================
+    export struct RenderTargets {
+        vk::Extent2D extent{};
+        vk::Image color{};
+        vk::ImageView color_view{};
+        vk::ImageLayout* color_layout = nullptr;
+        vk::Image depth{};
+        vk::ImageView depth_view{};
+        vk::ImageLayout* depth_layout = nullptr;
+    };
+
+    // World-space camera position: the translation column of camera-to-world.
+    export [[nodiscard]] inline std::array<float, 3> camera_eye(const vk::math::mat4& camera_to_world) {
+        const auto m = std::bit_cast<std::array<float, 16>>(camera_to_world);
+        return {m[12], m[13], m[14]};
+    }
+
+    export struct SceneInfo {
+        std::uint32_t frames_in_flight = 2;
+        std::filesystem::path dataset{};
+        std::filesystem::path pipeline_cache{};
+        // Index landed chunks for cursor picking (CPU BVH builds).
+        bool picking = true;
+        // Share of the device-local budget still free at load the ray pool
+        // may take; a dataset that needs more keeps the chunks in view.
+        float ray_memory_share = 0.5f;
+    };
+
+    export class Scene {
+    public:
+        // ====================================================================
+        // Frame slot's last frame is done: free retired resources and read
+        // back the density splat timing.
+        // ====================================================================
+        void begin_frame(std::uint32_t frame_index);
+        // ====================================================================
+        // Async grid rebuild + chunk streaming; flushes this frame's copies,
+        // so call it before the frame's own queue submit.
+        // ====================================================================
+        void update(std::uint32_t frame_index);
+        // ====================================================================
+        // Record the scene pass (ray culling, then rendering) with this frame
+        // slot's indirect buffers. Draw layers are recorded on the worker
+        // pool into secondary command buffers; the calling thread joins in.
+        // Color ends in eColorAttachmentOptimal. eye is the camera position
+        // (the infinite grid follows it). A profiler, when given, gets one
+        // GPU scope per stage.
+        // ====================================================================
+        void record(const vk::raii::CommandBuffer& cmd, std::uint32_t frame_index, const RenderTargets& targets, const vk::math::mat4& view_proj, const std::array<float, 3>& eye, profiler::Profiler* frame_profiler = nullptr);
+        // ====================================================================
+        // Point at pipelines matching the attachment formats.
+        // ====================================================================
+        void set_formats(vk::Format color_format, vk::Format depth_format);
+        // ====================================================================
+        // Device must be idle: drop retired resources, persist caches.
+        // ====================================================================
+        void shutdown();
+
+        void mark_grid_dirty() noexcept {
+            grid_dirty = true;
+        }
+        [[nodiscard]] GridSettings& grid_settings() noexcept {
+            return grid;
+        }
+        [[nodiscard]] RaySettings& ray_settings() noexcept {
+            return rays;
+        }
+        // Applied in update(); chunks rescan in the background.
+        [[nodiscard]] filter::FilterSettings& filter_settings() noexcept {
+            return filters;
+        }
+        [[nodiscard]] const dataset::RayFile* ray_file() const noexcept {
+            return rays_file.get();
+        }
+        [[nodiscard]] std::size_t chunks_resident() const noexcept {
+            return ray_pool ? ray_pool->chunks_resident() : 0;
+        }
+        [[nodiscard]] std::size_t pool_slots() const noexcept {
+            return ray_pool ? ray_pool->slot_count() : 0;
+        }
+        // Chunks that gave up their slot to one in view (over budget only).
+        [[nodiscard]] std::uint64_t chunks_evicted() const noexcept {
+            return ray_residency ? ray_residency->evictions() : 0;
+        }
+        [[nodiscard]] const residency::MemoryBudget& memory() const noexcept {
+            return *memory_budget;
+        }
+        [[nodiscard]] std::uint64_t rays_resident() const noexcept {
+            return ray_count_resident;
+        }
+        [[nodiscard]] std::uint64_t rays_selected() const noexcept {
+            return ray_pool ? ray_pool->rays_selected() : 0;
+        }
+        // Share of the selected rays in the density image (1 = converged).
+        [[nodiscard]] float density_progress() const noexcept {
+            return ray_density ? ray_density->progress() : 0.0f;
+        }
+        [[nodiscard]] std::uint64_t density_rays_per_frame() const noexcept {
+            return ray_density ? ray_density->rays_per_frame() : 0;
+        }
+        [[nodiscard]] bool streaming() const noexcept {
+            return (ray_streamer && !ray_streamer->finished()) || ray_deferred || !ray_pending.empty();
+        }
+        // ====================================================================
+        // Work that changes the next frame without any input: grid or chunk
+        // uploads in flight, picking BVHs still being built, filter scans
+        // running or their selections waiting for upload, and a density
+        // image still converging.
+        // ====================================================================
+        [[nodiscard]] bool has_pending_work() const {
+            const bool density_pending = rays.show_rays && rays.density && ray_density && !ray_density->converged();
+            return (grid_dirty && !grid.infinite) || grid_pending || streaming() || (ray_picker && ray_picker->chunks_indexed() < chunks_resident()) || (ray_filter && ray_filter->busy()) || !selection_pending.empty() || density_pending;
+        }
+        // Half the largest extent of the dataset bounds, if one is loaded.
+        [[nodiscard]] std::optional<float> dataset_radius() const;
+        // ====================================================================
+        // Closest resident ray to a cursor ray (chunks whose BVH is still
+        // being built and rays hidden by the filter are skipped).
+        // ====================================================================
+        [[nodiscard]] std::optional<picking::PickHit> pick(const picking::PickRay& ray) const;
+        [[nodiscard]] std::size_t chunks_pickable() const noexcept {
+            return ray_picker ? ray_picker->chunks_indexed() : 0;
+        }
+
+        Scene(const GpuDevice& gpu, const SceneInfo& info);
+        ~Scene()                       = default;
+        Scene(const Scene&)            = delete;
+        Scene& operator=(const Scene&) = delete;
+        Scene(Scene&&)                 = delete;
+        Scene& operator=(Scene&&)      = delete;
+
+    private:
+        // Chunk copy in flight; it joins the pool and picker once landed.
+        struct PendingChunk {
+            std::uint64_t ticket    = 0;
+            std::uint32_t index     = 0;
+            std::uint32_t ray_count = 0;
+            std::vector<std::uint32_t> order;
+        };
+
+        const pipelines::Pipeline& grid_pipeline(const GridSettings& settings);
+        const pipelines::Pipeline& density_pipeline(bool radiance);
+        void update_grid_mesh(std::uint32_t frame_index);
+        void stream_ray_chunks();
+        bool make_room(std::uint32_t chunk_index);
+        void upload_selections();
+
+        GpuDevice gpu{};
+        // ====================================================================
+        // Async uploads + deferred destruction keyed by frame slot.
+        // ====================================================================
+        std::unique_ptr<upload::Uploader> uploader;
+        upload::RetireQueue retire;
+        // ====================================================================
+        // Worker pool shared by draw-layer recording, the chunk decoder and
+        // the picking BVH builds.
+        // ====================================================================
+        std::shared_ptr<jobs::ThreadPool> workers;
+        std::unique_ptr<layers::LayerRecorder> layer_recorder;
+        // ====================================================================
+        // Pipelines keyed by description + on-disk VkPipelineCache.
+        // ====================================================================
+        std::unique_ptr<pipelines::PipelineLibrary> pipeline_library;
+        std::pair<vk::Format, vk::Format> pipeline_formats{};
+        const pipelines::Pipeline* ray_pipeline   = nullptr;
+        const pipelines::Pipeline* cull_pipeline  = nullptr;
+        const pipelines::Pipeline* splat_pipeline = nullptr;
+        // WBOIT accumulation (ray_segments.oit) and its composite.
+        const pipelines::Pipeline* oit_pipeline           = nullptr;
+        const pipelines::Pipeline* oit_composite_pipeline = nullptr;
+        // ====================================================================
+        // Shader variants, built on first use for the current formats: the
+        // grid by its layer toggles (specialization constants) and mode
+        // (finite / infinite permutation), the density composite by color
+        // mode (build-time permutation).
+        // ====================================================================
+        std::array<const pipelines::Pipeline*, 16> grid_pipelines{};
+        std::array<const pipelines::Pipeline*, 2> density_pipelines{};
+        // ====================================================================
+        // Grid GPU resources.
+        // ====================================================================
+        upload::GpuMesh grid_mesh;
+        std::optional<upload::MeshUpload> grid_pending;
+        bool grid_dirty = true;
+        // ====================================================================
+        // Ray dataset: mapped file, decoder, GPU slot pool, and the picking
+        // index.
+        // ====================================================================
+        std::shared_ptr<const dataset::RayFile> rays_file;
+        std::unique_ptr<dataset::ChunkStreamer> ray_streamer;
+        std::optional<dataset::StreamedChunk> ray_deferred;
+        std::deque<PendingChunk> ray_pending;
+        std::unique_ptr<pool::RayPool> ray_pool;
+        std::unique_ptr<picking::RayPicker> ray_picker;
+        std::uint64_t ray_count_resident = 0;
+        // Chunks handed to the picker (evicted ones keep their BVH).
+        std::vector<bool> ray_indexed;
+        // ====================================================================
+        // Device-local budget, and when the pool has fewer slots than the
+        // file has chunks, which chunks hold one (last frame's view).
+        // ====================================================================
+        std::unique_ptr<residency::MemoryBudget> memory_budget;
+        std::unique_ptr<residency::ResidencyTracker> ray_residency;
+        vk::math::mat4 residency_view_proj{};
+        // ====================================================================
+        // Attribute filter: background scans, and changed selections not
+        // yet uploaded (newest per chunk).
+        // ====================================================================
+        std::unique_ptr<filter::RayFilter> ray_filter;
+        std::map<std::uint32_t, std::vector<std::uint32_t>> selection_pending;
+        // Progressive density accumulation (density mode).
+        std::unique_ptr<density::DensityAccumulator> ray_density;
+        // Accumulation + revealage targets for translucent rays.
+        std::unique_ptr<oit::OitTargets> ray_oit;
+        // ====================================================================
+        // Settings edited by the UI (or a benchmark script).
+        // ====================================================================
+        GridSettings grid{};
+        RaySettings rays{};
+        filter::FilterSettings filters{};
+    };
+} // namespace pngp::vis::rays
@@ -0,0 +1,528 @@
+// ============================================================================
+// CPU-side checks: each case drives a module over seeded random or
+// hand-built data and compares it against a plain reference or the known
+// answer. Run one case by name (ctest does).
+// ============================================================================
+import std;
+import vk.camera;
+import vk.math;
+import pngp.vis.rays.dataset;
+import pngp.vis.rays.jobs;
+import pngp.vis.rays.picking;
+import pngp.vis.rays.filter;
+import pngp.vis.rays.scene;
+import pngp.vis.rays.replay;
+import pngp.vis.rays.residency;
+
+namespace {
+    namespace dataset = pngp::vis::rays::dataset;
+    namespace picking = pngp::vis::rays::picking;
+    namespace filter  = pngp::vis::rays::filter;
+    namespace jobs    = pngp::vis::rays::jobs;
+    namespace replay    = pngp::vis::rays::replay;
+    namespace residency = pngp::vis::rays::residency;
+
+    using Vec3 = std::array<double, 3>;
+
+    // Failures are counted, not fatal, so one run reports every mismatch
+    // (the first few in full).
+    struct Checker {
+        std::string_view name;
+        std::uint32_t failures = 0;
+
+        void fail(const std::string_view what) {
+            if (++failures <= 10) std::println(stderr, "{}: {}", name, what);
+        }
+    };
+
+    // ========================================================================
+    // Ray file written to the temp directory, removed with the object.
+    // ========================================================================
+    struct TempRayFile {
+        std::filesystem::path path;
+
+        TempRayFile(const std::string_view stem, const std::span<const dataset::Ray> rays, const std::uint32_t chunk_capacity, const std::uint32_t columns = dataset::required_columns)
+            : path(std::filesystem::temp_directory_path() / std::format("{}-{}.rays", stem, std::random_device{}())) {
+            dataset::write_ray_file(path, rays, chunk_capacity, columns);
+        }
+        ~TempRayFile() {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+        TempRayFile(const TempRayFile&)            = delete;
+        TempRayFile& operator=(const TempRayFile&) = delete;
+    };
+
+    // Any other file in the temp directory, removed with the object.
+    struct TempPath {
+        std::filesystem::path path;
+
+        explicit TempPath(const std::string_view name) : path(std::filesystem::temp_directory_path() / std::format("{}-{}", std::random_device{}(), name)) {}
+        ~TempPath() {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+        TempPath(const TempPath&)            = delete;
+        TempPath& operator=(const TempPath&) = delete;
+    };
+
+    float uniform(std::mt19937& rng, const float lo, const float hi) {
+        return std::uniform_real_distribution<float>(lo, hi)(rng);
+    }
+
+    std::array<float, 3> unit_vector(std::mt19937& rng) {
+        std::normal_distribution<float> n;
+        while (true) {
+            const std::array v{n(rng), n(rng), n(rng)};
+            const float len = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (len > 1e-3f) return {v[0] / len, v[1] / len, v[2] / len};
+        }
+    }
+
+    double dot(const Vec3& a, const Vec3& b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // ========================================================================
+    // Reference pick metric, one segment at a time in double precision:
+    // closest approach of the cursor ray to the segment, then the offset
+    // from the ray at that point over the distance along it.
+    // ========================================================================
+    double segment_offset(const picking::PickRay& ray, const dataset::ChunkView& view, const std::uint32_t i) {
+        const Vec3 o{ray.origin[0], ray.origin[1], ray.origin[2]};
+        const Vec3 d{ray.direction[0], ray.direction[1], ray.direction[2]};
+        const double t0 = view.t_min[i];
+        const double t1 = view.t_max[i];
+        const Vec3 p0{view.origin_x[i] + view.dir_x[i] * t0, view.origin_y[i] + view.dir_y[i] * t0, view.origin_z[i] + view.dir_z[i] * t0};
+        const Vec3 e{view.dir_x[i] * (t1 - t0), view.dir_y[i] * (t1 - t0), view.dir_z[i] * (t1 - t0)};
+        const Vec3 w{p0[0] - o[0], p0[1] - o[1], p0[2] - o[2]};
+
+        const double a     = dot(e, e);
+        const double b     = dot(d, e);
+        const double dw    = dot(d, w);
+        const double ew    = dot(e, w);
+        const double denom = a - b * b;
+        double u           = std::clamp(denom > 1e-12 ? (b * dw - ew) / denom : 0.0, 0.0, 1.0);
+        const double t     = std::max(0.0, dw + u * b);
+        u                  = a > 1e-12 ? std::clamp((t * b - ew) / a, 0.0, 1.0) : 0.0;
+
+        const Vec3 c{w[0] + u * e[0] - t * d[0], w[1] + u * e[1] - t * d[1], w[2] + u * e[2] - t * d[2]};
+        return t > 1e-6 ? std::sqrt(dot(c, c)) / t : std::numeric_limits<double>::max();
+    }
+
+    // ========================================================================
+    // RayPicker against a brute-force scan of every segment, with and
+    // without an accept filter. The picker works in float, so offsets agree
+    // to 1e-3; queries whose best offset sits that close to the cone edge
+    // are left out, since either answer is right.
+    // ========================================================================
+    std::uint32_t picking_matches_brute_force() {
+        Checker check{"picking"};
+        std::mt19937 rng(8);
+
+        std::vector<dataset::Ray> rays(200'000);
+        for (auto& r : rays) {
+            r.origin    = {uniform(rng, -10.0f, 10.0f), uniform(rng, -10.0f, 10.0f), uniform(rng, -10.0f, 10.0f)};
+            r.direction = unit_vector(rng);
+            r.t_min     = uniform(rng, 0.0f, 0.5f);
+            r.t_max     = r.t_min + uniform(rng, 0.05f, 2.0f);
+        }
+        const TempRayFile temp("picking", rays, 16384);
+        const auto file    = std::make_shared<const dataset::RayFile>(temp.path);
+        const auto workers = std::make_shared<jobs::ThreadPool>();
+
+        picking::RayPicker picker(file, workers);
+        const auto chunk_count = static_cast<std::uint32_t>(file->chunks().size());
+        for (std::uint32_t c = 0; c < chunk_count; ++c) picker.add_chunk(c);
+        for (const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60); picker.chunks_indexed() < chunk_count;) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                check.fail("chunk BVHs not built within 60 s");
+                return check.failures;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            picker.update();
+        }
+
+        // Every other ray hidden, as a filter would.
+        const auto odd_only = [](const dataset::ChunkView&, const std::uint32_t ray) { return (ray & 1u) != 0; };
+
+        std::uint32_t compared = 0;
+        for (std::uint32_t q = 0; q < 200; ++q) {
+            // From a random point outside the volume towards one inside it.
+            const auto eye    = unit_vector(rng);
+            const auto target = std::array{uniform(rng, -8.0f, 8.0f), uniform(rng, -8.0f, 8.0f), uniform(rng, -8.0f, 8.0f)};
+            const Vec3 v{target[0] - 30.0 * eye[0], target[1] - 30.0 * eye[1], target[2] - 30.0 * eye[2]};
+            const double len = std::sqrt(dot(v, v));
+
+            picking::PickRay ray{};
+            ray.origin    = {30.0f * eye[0], 30.0f * eye[1], 30.0f * eye[2]};
+            ray.direction = {static_cast<float>(v[0] / len), static_cast<float>(v[1] / len), static_cast<float>(v[2] / len)};
+            ray.tolerance = uniform(rng, 0.002f, 0.02f);
+
+            const bool filtered = (q & 1u) != 0;
+            double best         = std::numeric_limits<double>::max();
+            for (std::uint32_t c = 0; c < chunk_count; ++c) {
+                const auto view = file->chunk(c);
+                for (std::uint32_t i = 0; i < view.record->ray_count; ++i) {
+                    if (filtered && !odd_only(view, i)) continue;
+                    best = std::min(best, segment_offset(ray, view, i));
+                }
+            }
+            if (std::abs(best - ray.tolerance) <= 1e-3 * ray.tolerance) continue;
+
+            const auto hit = filtered ? picker.pick(ray, odd_only) : picker.pick(ray);
+            ++compared;
+            if (best > ray.tolerance) {
+                if (hit) check.fail(std::format("query {}: picked a ray outside the cone", q));
+                continue;
+            }
+            if (!hit) {
+                check.fail(std::format("query {}: missed a ray at offset {}", q, best));
+                continue;
+            }
+            const double picked = segment_offset(ray, file->chunk(hit->chunk), hit->ray);
+            if (filtered && (hit->ray & 1u) == 0) check.fail(std::format("query {}: picked a rejected ray", q));
+            if (picked > best * (1.0 + 1e-3)) check.fail(std::format("query {}: picked offset {}, brute force {}", q, picked, best));
+        }
+        if (compared < 150) check.fail(std::format("only {} of 200 queries compared", compared));
+        return check.failures;
+    }
+
+    // ========================================================================
+    // encode_ray -> decode_ray over random chunks: start and end points stay
+    // within 1e-4 of the chunk diagonal, colors come back exact. Axis and
+    // fold-edge directions are covered on top of the random ones.
+    // ========================================================================
+    std::uint32_t record_round_trip() {
+        Checker check{"round_trip"};
+        std::mt19937 rng(10);
+
+        const std::array<std::array<float, 3>, 8> edge_directions{{{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0.7071068f, 0, -0.7071068f}, {0, -0.7071068f, -0.7071068f}}};
+
+        double worst = 0.0;
+        for (std::uint32_t c = 0; c < 1000; ++c) {
+            dataset::ChunkRecord chunk{};
+            for (int a = 0; a < 3; ++a) {
+                chunk.bounds_min[a] = uniform(rng, -10.0f, 10.0f);
+                chunk.bounds_max[a] = chunk.bounds_min[a] + uniform(rng, 0.5f, 50.0f);
+            }
+            const auto inside = [&] { return std::array{uniform(rng, chunk.bounds_min[0], chunk.bounds_max[0]), uniform(rng, chunk.bounds_min[1], chunk.bounds_max[1]), uniform(rng, chunk.bounds_min[2], chunk.bounds_max[2])}; };
+            double diagonal2  = 0.0;
+            for (int a = 0; a < 3; ++a) diagonal2 += static_cast<double>(chunk.bounds_max[a] - chunk.bounds_min[a]) * (chunk.bounds_max[a] - chunk.bounds_min[a]);
+            const double diagonal = std::sqrt(diagonal2);
+
+            for (std::uint32_t r = 0; r < 1000; ++r) {
+                const auto start = inside();
+                auto end         = inside();
+                if (r < edge_directions.size()) {
+                    const float len = uniform(rng, 0.0f, 0.5f) * static_cast<float>(diagonal);
+                    for (int a = 0; a < 3; ++a) end[a] = start[a] + edge_directions[r][a] * len;
+                }
+                const std::uint32_t color = static_cast<std::uint32_t>(rng());
+
+                const auto decoded = dataset::decode_ray(dataset::encode_ray(start, end, color, chunk), chunk);
+                double start_error = 0.0;
+                double end_error   = 0.0;
+                for (int a = 0; a < 3; ++a) {
+                    start_error = std::max(start_error, std::abs(static_cast<double>(decoded.start[a]) - start[a]) / diagonal);
+                    end_error   = std::max(end_error, std::abs(static_cast<double>(decoded.end[a]) - end[a]) / diagonal);
+                }
+                worst = std::max({worst, start_error, end_error});
+                if (start_error > 1e-4 || end_error > 1e-4) check.fail(std::format("chunk {} ray {}: error {} / {} of the diagonal", c, r, start_error, end_error));
+                if (decoded.color != color) check.fail(std::format("chunk {} ray {}: color changed", c, r));
+            }
+        }
+        std::println("round_trip: worst error {:.2e} of the chunk diagonal", worst);
+        return check.failures;
+    }
+
+    // ========================================================================
+    // scan_chunk against matches() ray by ray, over random settings (ranges
+    // on whole values, so rays sit exactly on the bounds too) and over a
+    // file without the optional columns, whose predicates must not apply.
+    // ========================================================================
+    std::uint32_t filter_scan_matches() {
+        Checker check{"filter"};
+        std::mt19937 rng(12);
+        const auto whole = [&](const int lo, const int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); };
+
+        std::vector<dataset::Ray> rays(1'000'000);
+        for (auto& r : rays) {
+            r.origin    = {uniform(rng, -1.0f, 1.0f), uniform(rng, -1.0f, 1.0f), uniform(rng, -1.0f, 1.0f)};
+            r.direction = unit_vector(rng);
+            r.t_max     = rng() % 4 == 0 ? static_cast<float>(whole(0, 100)) : uniform(rng, 0.0f, 100.0f);
+            r.pixel     = static_cast<std::uint32_t>(whole(0, 1023)) | static_cast<std::uint32_t>(whole(0, 1023)) << 16;
+            r.camera_id = static_cast<std::uint32_t>(whole(0, 8));
+        }
+        const TempRayFile with_ids("filter", rays, 65536, dataset::required_columns | dataset::optional_columns);
+        const TempRayFile without_ids("filter-plain", std::span(rays).first(100'000), 65536);
+
+        std::vector<std::uint8_t> keep;
+        double scan_ms        = 0.0;
+        std::uint64_t scanned = 0;
+        std::uint64_t kept    = 0;
+        for (const auto& path : {with_ids.path, without_ids.path}) {
+            const dataset::RayFile file(path);
+            for (std::uint32_t q = 0; q < 64; ++q) {
+                filter::FilterSettings settings{};
+                settings.enabled    = q % 16 != 0;
+                settings.by_camera  = whole(0, 1) != 0;
+                settings.camera_min = whole(-2, 8);
+                settings.camera_max = whole(settings.camera_min, 10);
+                settings.by_pixel   = whole(0, 1) != 0;
+                settings.pixel_min  = {whole(-16, 1023), whole(-16, 1023)};
+                settings.pixel_max  = {whole(settings.pixel_min[0], 1100), whole(settings.pixel_min[1], 1100)};
+                settings.by_depth   = whole(0, 1) != 0;
+                settings.depth_min  = static_cast<float>(whole(0, 100));
+                settings.depth_max  = static_cast<float>(whole(static_cast<int>(settings.depth_min), 110));
+
+                for (std::uint32_t c = 0; c < file.chunks().size(); ++c) {
+                    const auto view = file.chunk(c);
+                    keep.assign(view.record->ray_count, 0xAA);
+
+                    const auto t0 = std::chrono::steady_clock::now();
+                    filter::scan_chunk(settings, view, keep);
+                    scan_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                    scanned += keep.size();
+
+                    for (std::uint32_t i = 0; i < view.record->ray_count; ++i) {
+                        const bool expected = filter::matches(settings, view, i);
+                        kept += expected ? 1 : 0;
+                        if (keep[i] != (expected ? 1 : 0)) check.fail(std::format("query {} chunk {} ray {}: scan {} vs matches {}", q, c, i, keep[i], expected));
+                    }
+                }
+            }
+        }
+        // Both outcomes have to occur, or the comparison proves nothing.
+        if (kept == 0 || kept == scanned) check.fail("every ray passed or every ray failed");
+        std::println("filter: {:.1f} ms per 10M rays scanned", scan_ms * 1e7 / static_cast<double>(scanned));
+        return check.failures;
+    }
+
+    // ========================================================================
+    // Input recordings: write -> read over random frames and grid edits,
+    // a hand-built version 1 file (no fade distance), and every truncation
+    // of a small file, which has to throw rather than read past the end.
+    // ========================================================================
+    std::uint32_t replay_round_trip() {
+        Checker check{"replay"};
+        std::mt19937 rng(15);
+        const auto coin = [&](const std::uint32_t one_in) { return rng() % one_in == 0; };
+
+        using Input = vk::camera::CameraInput;
+        constexpr std::array<bool Input::*, 13> buttons{&Input::lmb, &Input::mmb, &Input::rmb, &Input::shift, &Input::ctrl, &Input::alt, &Input::space, &Input::forward, &Input::backward, &Input::left, &Input::right, &Input::down, &Input::up};
+        const auto same_input = [&](const Input& a, const Input& b) {
+            return std::ranges::all_of(buttons, [&](const auto field) { return a.*field == b.*field; }) && a.mouse_dx == b.mouse_dx && a.mouse_dy == b.mouse_dy && a.scroll == b.scroll;
+        };
+
+        replay::InputRecorder recorder;
+        pngp::vis::rays::GridSettings grid{};
+        for (std::uint32_t f = 0; f < 5000; ++f) {
+            Input input{};
+            for (const auto field : buttons) input.*field = coin(4);
+            if (coin(2)) {
+                input.mouse_dx = uniform(rng, -40.0f, 40.0f);
+                input.mouse_dy = uniform(rng, -40.0f, 40.0f);
+            }
+            if (coin(5)) input.scroll = uniform(rng, -3.0f, 3.0f);
+            if (coin(50)) {
+                grid.show_grid     = coin(2);
+                grid.show_axes     = coin(2);
+                grid.show_origin   = coin(2);
+                grid.fly_mode      = coin(2);
+                grid.infinite      = coin(2);
+                grid.grid_extent   = uniform(rng, 1.0f, 500.0f);
+                grid.grid_step     = uniform(rng, 0.01f, 10.0f);
+                grid.major_every   = static_cast<int>(rng() % 20) + 1;
+                grid.axis_length   = uniform(rng, 0.0f, 50.0f);
+                grid.origin_scale  = uniform(rng, 0.0f, 2.0f);
+                grid.fade_distance = uniform(rng, 1.0f, 1000.0f);
+            }
+            recorder.record(uniform(rng, 0.001f, 0.05f), input, grid);
+        }
+
+        const TempPath temp("replay.rin");
+        const auto written = recorder.frames();
+        replay::write_recording(temp.path, written);
+        const auto read = replay::read_recording(temp.path);
+        if (read.size() != written.size()) check.fail(std::format("read {} of {} frames", read.size(), written.size()));
+        for (std::size_t f = 0; f < std::min(read.size(), written.size()); ++f) {
+            if (read[f].dt != written[f].dt || !same_input(read[f].input, written[f].input)) check.fail(std::format("frame {}: input changed", f));
+            if (read[f].grid != written[f].grid) check.fail(std::format("frame {}: grid settings changed", f));
+        }
+
+        // Version 1: magic, version, count, then a frame with grid settings
+        // (no infinite toggle, no fade distance) and an idle one.
+        std::vector<std::byte> v1;
+        const auto put = [&](const auto value) {
+            const auto bytes = std::as_bytes(std::span{&value, 1});
+            v1.insert(v1.end(), bytes.begin(), bytes.end());
+        };
+        put(replay::recording_magic);
+        put(std::uint32_t{1});
+        put(std::uint32_t{2});
+        put(std::uint16_t{0b101});
+        put(std::uint8_t{1u << 2});
+        put(0.016f);
+        put(std::uint8_t{0b1011});
+        put(12.0f);
+        put(0.5f);
+        put(std::int32_t{4});
+        put(3.0f);
+        put(0.75f);
+        put(std::uint16_t{0});
+        put(std::uint8_t{0});
+        put(0.02f);
+        {
+            std::ofstream file(temp.path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(v1.data()), static_cast<std::streamsize>(v1.size()));
+        }
+        const auto old = replay::read_recording(temp.path);
+        const pngp::vis::rays::GridSettings defaults{};
+        if (old.size() != 2 || !old[0].grid || old[1].grid) {
+            check.fail("version 1 file: wrong frames or grid payloads");
+        } else {
+            const auto& g = *old[0].grid;
+            if (!old[0].input.lmb || old[0].input.mmb || !old[0].input.rmb || old[0].dt != 0.016f || old[1].dt != 0.02f) check.fail("version 1 file: input changed");
+            if (!g.show_grid || !g.show_axes || g.show_origin || !g.fly_mode || g.infinite) check.fail("version 1 file: toggles changed");
+            if (g.grid_extent != 12.0f || g.grid_step != 0.5f || g.major_every != 4 || g.axis_length != 3.0f || g.origin_scale != 0.75f) check.fail("version 1 file: grid values changed");
+            if (g.fade_distance != defaults.fade_distance) check.fail(std::format("version 1 file: fade distance {} instead of the default {}", g.fade_distance, defaults.fade_distance));
+        }
+
+        // Every proper prefix of a short recording, down to the empty file.
+        replay::write_recording(temp.path, written.first(8));
+        std::vector<char> whole;
+        {
+            std::ifstream file(temp.path, std::ios::binary);
+            whole.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        for (std::size_t size = 0; size < whole.size(); ++size) {
+            {
+                std::ofstream file(temp.path, std::ios::binary | std::ios::trunc);
+                file.write(whole.data(), static_cast<std::streamsize>(size));
+            }
+            try {
+                (void) replay::read_recording(temp.path);
+                check.fail(std::format("{} of {} bytes read without an error", size, whole.size()));
+            } catch (const std::runtime_error&) {
+            }
+        }
+        return check.failures;
+    }
+
+    // ========================================================================
+    // Camera at eye looking down -z with a 90 degree field of view: clip w
+    // is the depth in front of the eye and clip z half of it, so the near
+    // plane sits at the eye (column-major, as vk.math stores it).
+    // ========================================================================
+    vk::math::mat4 look_down_z(const std::array<float, 3>& eye) {
+        return std::bit_cast<vk::math::mat4>(std::array{1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -0.5f, -1.0f, -eye[0], -eye[1], 0.5f * eye[2], eye[2]});
+    }
+
+    // ========================================================================
+    // Residency policy over a hand-built chunk table: project_bounds gives
+    // the footprints ray_cull.slang computes (coverage times the viewport
+    // area is its area_px), requests go largest footprint first with the
+    // outstanding ones claiming slots first, and victims are off-screen
+    // chunks least recently seen first, then on-screen ones only for a
+    // larger footprint.
+    // ========================================================================
+    std::uint32_t residency_policy() {
+        Checker check{"residency"};
+        using residency::ChunkState;
+
+        const auto box = [](const std::array<float, 3> lo, const std::array<float, 3> hi, const std::uint32_t rays = 100) { return dataset::ChunkRecord{.ray_count = rays, .bounds_min = lo, .bounds_max = hi}; };
+        const std::array chunks{
+            box({-2, -2, -6}, {2, 2, -5}),               // 0: near, coverage 0.16
+            box({-0.5f, -0.5f, -20}, {0.5f, 0.5f, -19}), // 1: far and small
+            box({-1, -1, 5}, {1, 1, 6}),                 // 2: behind the eye
+            box({50, -1, -6}, {51, 1, -5}),              // 3: off to the side
+            box({-1, -1, -10}, {1, 1, -9}),              // 4: between 1 and 7
+            box({-1, -1, -1}, {1, 1, 1}),                // 5: around the eye, coverage 1
+            box({-1, -1, -4}, {1, 1, -3}, 0),            // 6: in view but empty
+            box({-1.5f, -1.5f, -8}, {1.5f, 1.5f, -7}),   // 7: larger than 4
+        };
+        const auto front = look_down_z({0, 0, 0});
+        const auto side  = look_down_z({50.5f, 0, 0});
+
+        const auto screen = [&](const std::uint32_t i) { return residency::project_bounds(front, chunks[i].bounds_min, chunks[i].bounds_max); };
+        if (!screen(0).visible || std::abs(screen(0).coverage - 0.16f) > 1e-6f) check.fail(std::format("chunk 0: visible {} coverage {}, expected 0.16", screen(0).visible, screen(0).coverage));
+        if (!screen(5).visible || screen(5).coverage != 1.0f) check.fail(std::format("chunk 5: visible {} coverage {}, expected full", screen(5).visible, screen(5).coverage));
+        if (screen(2).visible || screen(3).visible) check.fail("chunks behind or beside the view projected as visible");
+        if (!(screen(7).coverage > screen(4).coverage && screen(4).coverage > screen(1).coverage)) check.fail("footprints not ordered by size");
+
+        const auto list = [](const std::vector<std::uint32_t>& chunk_list) {
+            std::string out;
+            for (const std::uint32_t i : chunk_list) out += std::format("{}{}", out.empty() ? "" : " ", i);
+            return std::format("[{}]", out);
+        };
+        const auto expect = [&](const std::string_view what, const std::vector<std::uint32_t>& got, const std::vector<std::uint32_t>& want) {
+            if (got != want) check.fail(std::format("{}: got {}, expected {}", what, list(got), list(want)));
+        };
+        const auto expect_victim = [&](const std::string_view what, const std::optional<std::uint32_t> got, const std::optional<std::uint32_t> want) {
+            if (got != want) check.fail(std::format("{}: got {}, expected {}", what, got ? std::format("{}", *got) : "none", want ? std::format("{}", *want) : "none"));
+        };
+
+        // Chunk 3 is seen once from the side, so it is more recent than 2.
+        residency::ResidencyTracker tracker(static_cast<std::uint32_t>(chunks.size()));
+        tracker.update(side, chunks);
+        tracker.update(front, chunks);
+
+        expect("empty pool, two free slots", tracker.take_wanted(8, 2), {5, 0});
+        expect("two requests outstanding, four free slots", tracker.take_wanted(8, 4), {7, 4});
+
+        // Everything requested arrived, 2 and 3 from earlier streaming; 7
+        // was dropped (back to absent).
+        for (const std::uint32_t i : {0u, 2u, 3u, 4u, 5u}) tracker.set_state(i, ChunkState::resident);
+        tracker.set_state(7, ChunkState::absent);
+
+        expect_victim("off-screen, never seen", tracker.pick_victim(1), 2);
+        expect_victim("incoming not in view", tracker.pick_victim(6), std::nullopt);
+        expect("pool full, off-screen victims", tracker.take_wanted(8, 0), {7, 1});
+
+        tracker.set_state(7, ChunkState::absent);
+        tracker.set_state(1, ChunkState::absent);
+        expect("at most one outstanding", tracker.take_wanted(1, 0), {7});
+
+        tracker.set_state(7, ChunkState::absent);
+        tracker.set_state(2, ChunkState::absent);
+        expect_victim("off-screen, seen once", tracker.pick_victim(1), 3);
+
+        tracker.set_state(3, ChunkState::absent);
+        expect_victim("on-screen victims, smaller incoming", tracker.pick_victim(1), std::nullopt);
+        expect_victim("on-screen victims, larger incoming", tracker.pick_victim(7), 4);
+        expect("pool full, on-screen victims", tracker.take_wanted(8, 0), {7});
+        return check.failures;
+    }
+
+    struct Case {
+        std::string_view name;
+        std::uint32_t (*run)();
+    };
+
+    constexpr std::array cases{
+        Case{"picking", &picking_matches_brute_force},
+        Case{"round_trip", &record_round_trip},
+        Case{"filter", &filter_scan_matches},
+        Case{"replay", &replay_round_trip},
+        Case{"residency", &residency_policy},
+    };
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::vector<std::string_view> args(argv + 1, argv + argc);
+    std::uint32_t failed = 0;
+    bool ran             = false;
+    for (const Case& c : cases) {
+        if (!args.empty() && !std::ranges::contains(args, c.name)) continue;
+        ran                          = true;
+        const std::uint32_t failures = c.run();
+        std::println("{}: {}", c.name, failures == 0 ? "ok" : std::format("{} failure(s)", failures));
+        failed += failures > 0 ? 1 : 0;
+    }
+    if (!ran) {
+        std::println(stderr, "usage: rays-tests [case...]");
+        return 2;
+    }
+    return failed == 0 ? 0 : 1;
+}
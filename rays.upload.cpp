@@ -0,0 +1,305 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+module pngp.vis.rays.upload;
+// ============================================================================
+// Uploader + buffer helper implementation.
+// ============================================================================
+import std;
+
+// ============================================================================
+// Translation-unit helpers.
+// ============================================================================
+namespace {
+    constexpr vk::DeviceSize copy_alignment = 16;
+
+    constexpr vk::DeviceSize align_up(const vk::DeviceSize v, const vk::DeviceSize a) {
+        return (v + a - 1) / a * a;
+    }
+} // namespace
+
+std::uint32_t pngp::vis::rays::upload::find_memory_type(const vk::raii::PhysicalDevice& physical_device, const std::uint32_t type_bits, const vk::MemoryPropertyFlags props) {
+    const auto mem = physical_device.getMemoryProperties();
+    for (std::uint32_t i = 0; i < mem.memoryTypeCount; ++i) {
+        if ((type_bits & (1u << i)) && (mem.memoryTypes[i].propertyFlags & props) == props) return i;
+    }
+    throw std::runtime_error("no suitable memory type");
+}
+
+std::uint32_t pngp::vis::rays::upload::graphics_queue_family(const vk::raii::PhysicalDevice& physical_device) {
+    const auto families = physical_device.getQueueFamilyProperties();
+    for (std::uint32_t i = 0; i < families.size(); ++i) {
+        if (families[i].queueFlags & vk::QueueFlagBits::eGraphics) return i;
+    }
+    throw std::runtime_error("no graphics queue family");
+}
+
+pngp::vis::rays::upload::LogicalDevice pngp::vis::rays::upload::create_device(const vk::raii::PhysicalDevice& physical_device, const std::uint32_t queue_family) {
+    const auto supported = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features>();
+    const auto& core12   = supported.get<vk::PhysicalDeviceVulkan12Features>();
+    const auto& core13   = supported.get<vk::PhysicalDeviceVulkan13Features>();
+    if (!core13.synchronization2 || !core13.dynamicRendering) throw std::runtime_error("device lacks synchronization2 / dynamic rendering");
+    // Frame pacing runs on a timeline semaphore.
+    if (!core12.timelineSemaphore) throw std::runtime_error("device lacks timeline semaphores");
+
+    LogicalDevice out{};
+    out.features.draw_indirect_count = core12.drawIndirectCount;
+    out.features.multi_draw_indirect = supported.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect;
+
+    const float priority = 1.0f;
+    const vk::DeviceQueueCreateInfo queue_info{
+        .queueFamilyIndex = queue_family,
+        .queueCount       = 1,
+        .pQueuePriorities = &priority,
+    };
+    vk::PhysicalDeviceVulkan12Features features12{.drawIndirectCount = out.features.draw_indirect_count, .timelineSemaphore = true};
+    vk::PhysicalDeviceVulkan13Features features13{
+        .pNext            = &features12,
+        .synchronization2 = true,
+        .dynamicRendering = true,
+    };
+    const vk::PhysicalDeviceFeatures2 features{
+        .pNext    = &features13,
+        .features = {.multiDrawIndirect = out.features.multi_draw_indirect},
+    };
+    out.device = vk::raii::Device(physical_device, vk::DeviceCreateInfo{
+                                                       .pNext                = &features,
+                                                       .queueCreateInfoCount = 1,
+                                                       .pQueueCreateInfos    = &queue_info,
+                                                   });
+    out.queue  = vk::raii::Queue(out.device, queue_family, 0);
+    return out;
+}
+
+pngp::vis::rays::upload::GpuBuffer pngp::vis::rays::upload::create_buffer(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const vk::DeviceSize size, const vk::BufferUsageFlags usage, const vk::MemoryPropertyFlags props) {
+    GpuBuffer out{};
+    out.size   = std::max<vk::DeviceSize>(size, 4);
+    out.buffer = vk::raii::Buffer(device, vk::BufferCreateInfo{
+                                              .size        = out.size,
+                                              .usage       = usage,
+                                              .sharingMode = vk::SharingMode::eExclusive,
+                                          });
+
+    const auto req = out.buffer.getMemoryRequirements();
+    out.memory     = vk::raii::DeviceMemory(device, vk::MemoryAllocateInfo{
+                                                    .allocationSize  = req.size,
+                                                    .memoryTypeIndex = find_memory_type(physical_device, req.memoryTypeBits, props),
+                                                });
+    out.buffer.bindMemory(*out.memory, 0);
+
+    if (props & vk::MemoryPropertyFlagBits::eHostVisible) out.mapped = out.memory.mapMemory(0, out.size);
+    return out;
+}
+
+pngp::vis::rays::upload::GpuImage pngp::vis::rays::upload::create_image(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const vk::Extent2D extent, const vk::Format format, const vk::ImageUsageFlags usage, const vk::ImageAspectFlags aspect) {
+    GpuImage out{};
+    out.image = vk::raii::Image(device, vk::ImageCreateInfo{
+                                            .imageType     = vk::ImageType::e2D,
+                                            .format        = format,
+                                            .extent        = {extent.width, extent.height, 1},
+                                            .mipLevels     = 1,
+                                            .arrayLayers   = 1,
+                                            .samples       = vk::SampleCountFlagBits::e1,
+                                            .tiling        = vk::ImageTiling::eOptimal,
+                                            .usage         = usage,
+                                            .sharingMode   = vk::SharingMode::eExclusive,
+                                            .initialLayout = vk::ImageLayout::eUndefined,
+                                        });
+
+    const auto req = out.image.getMemoryRequirements();
+    out.memory     = vk::raii::DeviceMemory(device, vk::MemoryAllocateInfo{
+                                                    .allocationSize  = req.size,
+                                                    .memoryTypeIndex = find_memory_type(physical_device, req.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal),
+                                                });
+    out.image.bindMemory(*out.memory, 0);
+
+    out.view = vk::raii::ImageView(device, vk::ImageViewCreateInfo{
+                                               .image            = *out.image,
+                                               .viewType         = vk::ImageViewType::e2D,
+                                               .format           = format,
+                                               .subresourceRange = {aspect, 0, 1, 0, 1},
+                                           });
+    return out;
+}
+
+// ============================================================================
+// Uploader: ring lives in host-visible coherent memory, mapped once.
+// ============================================================================
+pngp::vis::rays::upload::Uploader::Uploader(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const vk::raii::Queue& queue, const std::uint32_t queue_family, const vk::DeviceSize ring_bytes)
+    : physical_device(&physical_device), device(&device), queue(&queue) {
+    pool = vk::raii::CommandPool(device, vk::CommandPoolCreateInfo{
+                                             .flags            = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                             .queueFamilyIndex = queue_family,
+                                         });
+    ring = create_buffer(physical_device, device, align_up(ring_bytes, copy_alignment), vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+pngp::vis::rays::upload::Uploader::~Uploader() {
+    // Batches own command buffers and fences; make sure none are pending.
+    std::vector<vk::Fence> fences;
+    for (const Batch& b : in_flight) fences.push_back(*b.fence);
+    if (!fences.empty()) (void) device->waitForFences(fences, true, std::numeric_limits<std::uint64_t>::max());
+}
+
+std::optional<std::pair<vk::DeviceSize, vk::DeviceSize>> pngp::vis::rays::upload::Uploader::ring_place(const vk::DeviceSize bytes) const noexcept {
+    const vk::DeviceSize cap = ring.size;
+    if (bytes > cap) return std::nullopt;
+    if (ring_used == 0) return std::pair{vk::DeviceSize{0}, bytes};
+    if (ring_used >= cap) return std::nullopt;
+
+    if (ring_head > ring_tail) {
+        // Free space is [head, cap) and [0, tail).
+        if (cap - ring_head >= bytes) return std::pair{ring_head, bytes};
+        if (ring_tail >= bytes) return std::pair{vk::DeviceSize{0}, (cap - ring_head) + bytes};
+        return std::nullopt;
+    }
+    // Wrapped: free space is [head, tail).
+    if (ring_tail - ring_head >= bytes) return std::pair{ring_head, bytes};
+    return std::nullopt;
+}
+
+bool pngp::vis::rays::upload::Uploader::fits(const vk::DeviceSize bytes) const noexcept {
+    // Oversized uploads bypass the ring with a dedicated staging buffer.
+    return bytes > ring.size || ring_place(align_up(bytes, copy_alignment) + copy_alignment).has_value();
+}
+
+pngp::vis::rays::upload::Uploader::Batch& pngp::vis::rays::upload::Uploader::open_batch() {
+    if (recording) return *recording;
+
+    if (!free_batches.empty()) {
+        recording.emplace(std::move(free_batches.back()));
+        free_batches.pop_back();
+        recording->cmd.reset();
+        device->resetFences({*recording->fence});
+    } else {
+        Batch b{};
+        auto cmds = vk::raii::CommandBuffers(*device, vk::CommandBufferAllocateInfo{
+                                                          .commandPool        = *pool,
+                                                          .level              = vk::CommandBufferLevel::ePrimary,
+                                                          .commandBufferCount = 1,
+                                                      });
+        b.cmd   = std::move(cmds[0]);
+        b.fence = vk::raii::Fence(*device, vk::FenceCreateInfo{});
+        recording.emplace(std::move(b));
+    }
+
+    recording->ticket      = next_ticket++;
+    recording->ring_bytes  = 0;
+    recording->ring_end    = ring_head;
+    recording->waits_prior = false;
+    recording->oversized.clear();
+    recording->written.clear();
+    recording->cmd.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    return *recording;
+}
+
+std::optional<std::uint64_t> pngp::vis::rays::upload::Uploader::upload(const std::span<const BufferCopy> copies, const bool overwrites_in_use) {
+    vk::DeviceSize total = 0;
+    for (const BufferCopy& c : copies) total += align_up(c.data.size(), copy_alignment);
+    if (total == 0) return std::nullopt;
+
+    // One contiguous region per call keeps the all-or-nothing rule trivial.
+    const bool oversized = total > ring.size;
+    vk::DeviceSize base  = 0;
+    vk::Buffer src{};
+
+    if (oversized) {
+        Batch& batch = open_batch();
+        batch.oversized.push_back(create_buffer(*physical_device, *device, total, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+        src = *batch.oversized.back().buffer;
+    } else {
+        const auto place = ring_place(total);
+        if (!place) return std::nullopt;
+        Batch& batch = open_batch();
+        base         = place->first;
+        if (ring_used == 0) ring_tail = base;
+        ring_head = (base + total) % ring.size;
+        ring_used += place->second;
+        batch.ring_bytes += place->second;
+        batch.ring_end = ring_head;
+        src            = *ring.buffer;
+    }
+
+    Batch& batch = *recording;
+
+    // ========================================================================
+    // Ranges earlier frames may still read (write-after-read): wait for all
+    // prior work on the queue, earlier copies included (write-after-write),
+    // before this batch's remaining copies. Otherwise only a range this
+    // batch already wrote, e.g. an evicted slot's draw count followed by
+    // the chunk refilling the slot, needs the copies ordered.
+    // ========================================================================
+    const auto rewrites = [&batch](const BufferCopy& c) {
+        return !c.data.empty() && std::ranges::any_of(batch.written, [&](const Written& w) { return w.buffer == *c.dst->buffer && w.offset < c.dst_offset + c.data.size() && c.dst_offset < w.offset + w.size; });
+    };
+    const bool wait_prior = overwrites_in_use && !batch.waits_prior;
+    if (wait_prior || std::ranges::any_of(copies, rewrites)) {
+        const vk::MemoryBarrier2 barrier{
+            .srcStageMask  = wait_prior ? vk::PipelineStageFlagBits2::eAllCommands : vk::PipelineStageFlagBits2::eCopy,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask  = vk::PipelineStageFlagBits2::eCopy,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        };
+        batch.cmd.pipelineBarrier2(vk::DependencyInfo{
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers    = &barrier,
+        });
+        batch.waits_prior = batch.waits_prior || wait_prior;
+        batch.written.clear();
+    }
+
+    auto* dst_bytes      = static_cast<std::byte*>(oversized ? batch.oversized.back().mapped : ring.mapped);
+    vk::DeviceSize write = base;
+    for (const BufferCopy& c : copies) {
+        if (c.data.empty()) continue;
+        std::memcpy(dst_bytes + write, c.data.data(), c.data.size());
+        const vk::BufferCopy region{
+            .srcOffset = write,
+            .dstOffset = c.dst_offset,
+            .size      = c.data.size(),
+        };
+        batch.cmd.copyBuffer(src, *c.dst->buffer, region);
+        batch.written.push_back({*c.dst->buffer, c.dst_offset, c.data.size()});
+        write += align_up(c.data.size(), copy_alignment);
+    }
+    return batch.ticket;
+}
+
+void pngp::vis::rays::upload::Uploader::submit() {
+    if (!recording) return;
+
+    // Make copies visible to every later consumer on this queue.
+    const vk::MemoryBarrier2 barrier{
+        .srcStageMask  = vk::PipelineStageFlagBits2::eCopy,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask  = vk::PipelineStageFlagBits2::eAllCommands,
+        .dstAccessMask = vk::AccessFlagBits2::eMemoryRead,
+    };
+    recording->cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers    = &barrier,
+    });
+    recording->cmd.end();
+
+    const vk::CommandBufferSubmitInfo cmd_info{.commandBuffer = *recording->cmd};
+    const vk::SubmitInfo2 submit{
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos    = &cmd_info,
+    };
+    queue->submit2(submit, *recording->fence);
+
+    in_flight.push_back(std::move(*recording));
+    recording.reset();
+}
+
+void pngp::vis::rays::upload::Uploader::poll() {
+    while (!in_flight.empty() && in_flight.front().fence.getStatus() == vk::Result::eSuccess) {
+        Batch& b = in_flight.front();
+        ring_used -= b.ring_bytes;
+        ring_tail        = b.ring_end;
+        completed_ticket = b.ticket;
+        b.oversized.clear();
+        free_batches.push_back(std::move(b));
+        in_flight.pop_front();
+    }
+    if (ring_used == 0 && !recording) ring_head = ring_tail = 0;
+}
@@ -0,0 +1,208 @@
+module;
+#include <vulkan/vulkan_raii.hpp>
+export module pngp.vis.rays.upload;
+// ============================================================================
+// Non-blocking GPU uploads + frame-keyed resource retirement.
+// ============================================================================
+import vk.memory;
+import std;
+
+namespace pngp::vis::rays::upload {
+    // ========================================================================
+    // Buffer with its own allocation; mapped is non-null for host-visible use.
+    // ========================================================================
+    export struct GpuBuffer {
+        vk::raii::Buffer buffer{nullptr};
+        vk::raii::DeviceMemory memory{nullptr};
+        vk::DeviceSize size = 0;
+        void* mapped        = nullptr;
+    };
+
+    // Field names mirror vk::memory::MeshGPU so draw code reads the same.
+    export struct GpuMesh {
+        GpuBuffer vertex_buffer;
+        GpuBuffer index_buffer;
+        std::uint32_t index_count = 0;
+    };
+
+    // ========================================================================
+    // Device-local 2D image with its own allocation and a full view.
+    // ========================================================================
+    export struct GpuImage {
+        vk::raii::Image image{nullptr};
+        vk::raii::DeviceMemory memory{nullptr};
+        vk::raii::ImageView view{nullptr};
+    };
+
+    export std::uint32_t find_memory_type(const vk::raii::PhysicalDevice& physical_device, std::uint32_t type_bits, vk::MemoryPropertyFlags props);
+    export std::uint32_t graphics_queue_family(const vk::raii::PhysicalDevice& physical_device);
+    export GpuBuffer create_buffer(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags props);
+    export GpuImage create_image(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect);
+
+    // ========================================================================
+    // Optional features a device was created with; a device cannot be asked
+    // afterwards, so whoever creates it reports them.
+    // ========================================================================
+    export struct DeviceFeatures {
+        bool draw_indirect_count = false;
+        bool multi_draw_indirect = false;
+    };
+
+    export struct LogicalDevice {
+        vk::raii::Device device{nullptr};
+        vk::raii::Queue queue{nullptr};
+        DeviceFeatures features{};
+    };
+
+    // ========================================================================
+    // Device with one queue of queue_family. The features the renderer
+    // relies on (synchronization2, dynamic rendering, timeline semaphores)
+    // are required; the optional ones are enabled when the physical device
+    // supports them.
+    // ========================================================================
+    export LogicalDevice create_device(const vk::raii::PhysicalDevice& physical_device, std::uint32_t queue_family);
+
+    // ========================================================================
+    // Resources that may still be referenced by in-flight frames. Objects
+    // retired while recording frame N are destroyed the next time frame
+    // slot N is acquired, i.e. after that slot's fence or timeline value has
+    // signalled; either covers every earlier submission on the queue, so any
+    // frame that used the object has finished by then.
+    // ========================================================================
+    export class RetireQueue {
+    public:
+        template <typename T>
+        void retire(const std::uint32_t frame_index, T&& object) {
+            bins[frame_index % bins.size()].push_back(std::make_shared<std::remove_cvref_t<T>>(std::forward<T>(object)));
+        }
+        // Call right after the slot's wait (begin_frame).
+        void collect(const std::uint32_t frame_index) {
+            bins[frame_index % bins.size()].clear();
+        }
+        // Call only after device idle.
+        void clear() {
+            for (auto& bin : bins) bin.clear();
+        }
+
+        explicit RetireQueue(const std::uint32_t frames_in_flight = 2) : bins(std::max(1u, frames_in_flight)) {}
+
+    private:
+        std::vector<std::vector<std::shared_ptr<void>>> bins;
+    };
+
+    // ========================================================================
+    // One destination range filled from CPU memory.
+    // ========================================================================
+    export struct BufferCopy {
+        const GpuBuffer* dst = nullptr;
+        std::span<const std::byte> data;
+        vk::DeviceSize dst_offset = 0;
+    };
+
+    export struct MeshUpload {
+        GpuMesh mesh;
+        std::uint64_t ticket = 0;
+    };
+
+    // ========================================================================
+    // Staging ring + batched async copies on a queue.
+    // CPU data is memcpy'd into a persistently mapped ring; copies recorded
+    // during a frame go out in one submit with their own fence. Callers
+    // poll tickets instead of waiting, and the ring tail only advances when
+    // a batch's fence has signalled. A full ring makes uploads fail softly
+    // so callers retry next frame instead of stalling.
+    // ========================================================================
+    export class Uploader {
+    public:
+        // ====================================================================
+        // All-or-nothing; returns the ticket of the batch holding the copies.
+        // overwrites_in_use: destinations may still be read by submitted
+        // frames, so the copies wait for prior queue work first. Copies to
+        // a range the open batch already wrote are ordered after it.
+        // ====================================================================
+        [[nodiscard]] std::optional<std::uint64_t> upload(std::span<const BufferCopy> copies, bool overwrites_in_use = false);
+
+        template <typename V>
+        [[nodiscard]] std::optional<MeshUpload> upload_mesh(const vk::memory::MeshCPU<V>& mesh) {
+            if (mesh.vertices.empty() || mesh.indices.empty()) return std::nullopt;
+            const auto vbytes = std::as_bytes(std::span{mesh.vertices});
+            const auto ibytes = std::as_bytes(std::span{mesh.indices});
+            if (!fits(vbytes.size() + ibytes.size())) return std::nullopt;
+
+            MeshUpload out{};
+            out.mesh.vertex_buffer = create_buffer(*physical_device, *device, vbytes.size(), vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            out.mesh.index_buffer  = create_buffer(*physical_device, *device, ibytes.size(), vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            out.mesh.index_count   = static_cast<std::uint32_t>(mesh.indices.size());
+
+            const std::array copies{
+                BufferCopy{&out.mesh.vertex_buffer, vbytes, 0},
+                BufferCopy{&out.mesh.index_buffer, ibytes, 0},
+            };
+            const auto ticket = upload(copies);
+            if (!ticket) return std::nullopt;
+            out.ticket = *ticket;
+            return out;
+        }
+
+        // Submit copies recorded since the last call (no-op when empty).
+        void submit();
+        // Retire batches whose fences signalled; never blocks.
+        void poll();
+        [[nodiscard]] bool complete(const std::uint64_t ticket) const noexcept {
+            return ticket <= completed_ticket;
+        }
+        [[nodiscard]] vk::DeviceSize ring_capacity() const noexcept {
+            return ring.size;
+        }
+        [[nodiscard]] vk::DeviceSize ring_in_use() const noexcept {
+            return ring_used;
+        }
+
+        Uploader(const vk::raii::PhysicalDevice& physical_device, const vk::raii::Device& device, const vk::raii::Queue& queue, std::uint32_t queue_family, vk::DeviceSize ring_bytes = 64ull << 20);
+        ~Uploader();
+        Uploader(const Uploader&)            = delete;
+        Uploader& operator=(const Uploader&) = delete;
+        Uploader(Uploader&&)                 = delete;
+        Uploader& operator=(Uploader&&)      = delete;
+
+    private:
+        struct Written {
+            vk::Buffer buffer{};
+            vk::DeviceSize offset = 0;
+            vk::DeviceSize size   = 0;
+        };
+
+        struct Batch {
+            vk::raii::CommandBuffer cmd{nullptr};
+            vk::raii::Fence fence{nullptr};
+            std::uint64_t ticket      = 0;
+            vk::DeviceSize ring_end   = 0;
+            vk::DeviceSize ring_bytes = 0;
+            bool waits_prior          = false;
+            std::vector<GpuBuffer> oversized;
+            // Destination ranges copied since the batch's last barrier.
+            std::vector<Written> written;
+        };
+
+        // Offset + bytes consumed (including wrap padding) for a placement.
+        [[nodiscard]] std::optional<std::pair<vk::DeviceSize, vk::DeviceSize>> ring_place(vk::DeviceSize bytes) const noexcept;
+        [[nodiscard]] bool fits(vk::DeviceSize bytes) const noexcept;
+        Batch& open_batch();
+
+        const vk::raii::PhysicalDevice* physical_device = nullptr;
+        const vk::raii::Device* device                  = nullptr;
+        const vk::raii::Queue* queue                    = nullptr;
+
+        vk::raii::CommandPool pool{nullptr};
+        GpuBuffer ring;
+        vk::DeviceSize ring_head = 0;
+        vk::DeviceSize ring_tail = 0;
+        vk::DeviceSize ring_used = 0;
+
+        std::optional<Batch> recording;
+        std::deque<Batch> in_flight;
+        std::vector<Batch> free_batches;
+        std::uint64_t next_ticket      = 1;
+        std::uint64_t completed_ticket = 0;
+    };
+} // namespace pngp::vis::rays::upload